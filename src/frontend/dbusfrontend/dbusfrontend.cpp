@@ -19,22 +19,48 @@
 
 #include "dbusfrontend.h"
 #include "dbus_public.h"
+#include "fcitx-config/iniparser.h"
 #include "fcitx-utils/dbus/message.h"
 #include "fcitx-utils/dbus/objectvtable.h"
 #include "fcitx-utils/dbus/servicewatcher.h"
 #include "fcitx-utils/log.h"
 #include "fcitx-utils/metastring.h"
+#include "fcitx-utils/standardpath.h"
+#include "fcitx-utils/stringutils.h"
 #include "fcitx/inputcontext.h"
+#include "fcitx/inputcontextmanager.h"
 #include "fcitx/inputmethodentry.h"
 #include "fcitx/inputmethodmanager.h"
 #include "fcitx/instance.h"
 #include "fcitx/misc_p.h"
+#include <algorithm>
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+#include <unordered_set>
 
 #define FCITX_INPUTMETHOD_DBUS_INTERFACE "org.fcitx.Fcitx.InputMethod1"
 #define FCITX_INPUTCONTEXT_DBUS_INTERFACE "org.fcitx.Fcitx.InputContext1"
 
 namespace fcitx {
 
+namespace {
+
+// The peer to peer server socket and the file advertising its address, both
+// in the runtime directory and named after the display like the ibus one.
+std::string peerName() {
+    std::string display = "0";
+    if (auto env = getenv("DISPLAY")) {
+        display = env;
+    }
+    std::replace(display.begin(), display.end(), '/', '_');
+    return stringutils::concat("fcitx5-dbus-", display);
+}
+
+} // namespace
+
+class DBusInputContext1;
+
 class InputMethod1 : public dbus::ObjectVTable<InputMethod1> {
 public:
     InputMethod1(DBusFrontendModule *module, dbus::Bus *bus)
@@ -44,22 +70,53 @@ public:
                               FCITX_INPUTMETHOD_DBUS_INTERFACE, *this);
     }
 
+    ~InputMethod1();
+
     std::tuple<dbus::ObjectPath, std::vector<uint8_t>> createInputContext(
         const std::vector<dbus::DBusStruct<std::string, std::string>> &args);
 
-    dbus::ServiceWatcher &serviceWatcher() { return *watcher_; }
     dbus::Bus *bus() { return bus_; }
     Instance *instance() { return module_->instance(); }
 
+    void removeInputContext(DBusInputContext1 *ic);
+
 private:
     FCITX_OBJECT_VTABLE_METHOD(createInputContext, "CreateInputContext",
                                "a(ss)", "oay");
 
+    // Input contexts of one client, they share a single watch on the client
+    // name and are destroyed together once it goes away.
+    struct Client {
+        std::unique_ptr<HandlerTableEntry<dbus::ServiceWatcherCallback>>
+            watch_;
+        std::unordered_set<DBusInputContext1 *> ics_;
+    };
+
+    void addInputContext(DBusInputContext1 *ic);
+    void removeClient(const std::string &name);
+
     DBusFrontendModule *module_;
     Instance *instance_;
-    int icIdx = 0;
     dbus::Bus *bus_;
     std::unique_ptr<dbus::ServiceWatcher> watcher_;
+    std::unordered_map<std::string, Client> clients_;
+    // Never reused, so a client can't reach another client's input context
+    // through a stale object path.
+    int icIdx = 0;
+};
+
+struct PendingKeyEvent {
+    PendingKeyEvent(Key key, bool isRelease, uint32_t time)
+        : key_(key), isRelease_(isRelease), time_(time) {}
+
+    Key key_;
+    bool isRelease_;
+    uint32_t time_;
+    bool done_ = false;
+    bool accepted_ = false;
+    // Set once keyEvent() returns without finishing the key.
+    bool deferred_ = false;
+    std::unique_ptr<dbus::Message> call_;
 };
 
 class DBusInputContext1 : public InputContext,
@@ -69,22 +126,28 @@ public:
                       const std::string &sender, const std::string &program)
         : InputContext(icManager, program),
           path_("/org/freedesktop/portal/inputcontext/" + std::to_string(id)),
-          im_(im), handler_(im_->serviceWatcher().watchService(
-                       sender,
-                       [this](const std::string &, const std::string &,
-                              const std::string &newName) {
-                           if (newName.empty()) {
-                               delete this;
-                           }
-                       })),
-          name_(sender) {
+          im_(im), name_(sender) {
         created();
     }
 
-    ~DBusInputContext1() { InputContext::destroy(); }
+    ~DBusInputContext1() {
+        // Keys that never get processed are not accepted. The one being
+        // deferred may still be finished later, but has nobody to reply to.
+        for (auto &pending : pendingKeys_) {
+            if (pending->call_) {
+                replyKeyEvent(*pending->call_, false);
+                pending->call_.reset();
+            }
+        }
+        pendingKeys_.clear();
+        im_->removeInputContext(this);
+        InputContext::destroy();
+    }
 
     const char *frontend() const override { return "dbus"; }
 
+    const std::string &name() const { return name_; }
+
     const dbus::ObjectPath path() const { return path_; }
 
     void updateIM(const InputMethodEntry *entry) {
@@ -167,18 +230,69 @@ public:
     bool processKeyEvent(uint32_t keyval, uint32_t keycode, uint32_t state,
                          bool isRelease, uint32_t time) {
         CHECK_SENDER_OR_RETURN false;
-        KeyEvent event(
-            this, Key(static_cast<KeySym>(keyval), KeyStates(state), keycode),
+        auto pending = std::make_shared<PendingKeyEvent>(
+            Key(static_cast<KeySym>(keyval), KeyStates(state), keycode),
             isRelease, time);
+        pendingKeys_.push_back(pending);
+        // Keys behind a deferred one wait for it, so commits stay in order.
+        if (pendingKeys_.size() == 1) {
+            dispatchKeyEvent(pending);
+            if (pending->done_) {
+                pendingKeys_.pop_front();
+                return pending->accepted_;
+            }
+        }
+        // An engine may finish the key later, reply to the call only then so
+        // the main loop can process other clients meanwhile.
+        pending->call_ = std::make_unique<dbus::Message>(delayReply());
+        return false;
+    }
+
+private:
+    static void replyKeyEvent(dbus::Message &call, bool accepted) {
+        auto reply = call.createReply();
+        reply << accepted;
+        reply.send();
+    }
+
+    void dispatchKeyEvent(const std::shared_ptr<PendingKeyEvent> &pending) {
+        KeyEvent event(this, pending->key_, pending->isRelease_,
+                       pending->time_);
         // Force focus if there's keyevent.
         if (!hasFocus()) {
             focusIn();
         }
 
-        return keyEvent(event);
+        keyEvent(event, [ref = InputContext::watch(), pending](bool accepted) {
+            pending->accepted_ = accepted;
+            pending->done_ = true;
+            if (pending->call_) {
+                replyKeyEvent(*pending->call_, accepted);
+                pending->call_.reset();
+            }
+            // Finished synchronously, the caller moves on by itself.
+            if (!pending->deferred_) {
+                return;
+            }
+            if (auto ic = ref.get()) {
+                static_cast<DBusInputContext1 *>(ic)->processQueuedKeyEvents();
+            }
+        });
+        if (!pending->done_) {
+            pending->deferred_ = true;
+        }
+    }
+
+    // Called once the first key is finished after being deferred.
+    void processQueuedKeyEvents() {
+        while (!pendingKeys_.empty() && pendingKeys_.front()->done_) {
+            pendingKeys_.pop_front();
+            if (!pendingKeys_.empty()) {
+                dispatchKeyEvent(pendingKeys_.front());
+            }
+        }
     }
 
-private:
     FCITX_OBJECT_VTABLE_METHOD(focusInDBus, "FocusIn", "", "");
     FCITX_OBJECT_VTABLE_METHOD(focusOutDBus, "FocusOut", "", "");
     FCITX_OBJECT_VTABLE_METHOD(resetDBus, "Reset", "", "");
@@ -202,8 +316,66 @@ private:
 
     dbus::ObjectPath path_;
     InputMethod1 *im_;
-    std::unique_ptr<HandlerTableEntry<dbus::ServiceWatcherCallback>> handler_;
     std::string name_;
+    // Keys not finished yet, only the first one is passed to keyEvent().
+    std::deque<std::shared_ptr<PendingKeyEvent>> pendingKeys_;
+};
+
+InputMethod1::~InputMethod1() {
+    while (!clients_.empty()) {
+        auto name = clients_.begin()->first;
+        removeClient(name);
+    }
+}
+
+void InputMethod1::addInputContext(DBusInputContext1 *ic) {
+    auto &client = clients_[ic->name()];
+    // Messages from a peer to peer connection have no sender, the input
+    // contexts go away together with the connection instead.
+    if (!client.watch_ && !ic->name().empty()) {
+        client.watch_ = watcher_->watchService(
+            ic->name(), [this](const std::string &name, const std::string &,
+                               const std::string &newName) {
+                if (newName.empty()) {
+                    removeClient(name);
+                }
+            });
+    }
+    client.ics_.insert(ic);
+}
+
+void InputMethod1::removeInputContext(DBusInputContext1 *ic) {
+    auto iter = clients_.find(ic->name());
+    if (iter == clients_.end()) {
+        return;
+    }
+    iter->second.ics_.erase(ic);
+    if (iter->second.ics_.empty()) {
+        clients_.erase(iter);
+    }
+}
+
+void InputMethod1::removeClient(const std::string &name) {
+    auto iter = clients_.find(name);
+    if (iter == clients_.end()) {
+        return;
+    }
+    auto ics = std::move(iter->second.ics_);
+    clients_.erase(iter);
+    for (auto ic : ics) {
+        delete ic;
+    }
+}
+
+// A client connected to the peer to peer server.
+class DBusPeer {
+public:
+    DBusPeer(DBusFrontendModule *module, std::unique_ptr<dbus::Bus> bus)
+        : bus_(std::move(bus)), inputMethod1_(module, bus_.get()) {}
+
+    std::unique_ptr<dbus::Bus> bus_;
+    InputMethod1 inputMethod1_;
+    std::unique_ptr<dbus::Slot> disconnected_;
 };
 
 std::tuple<dbus::ObjectPath, std::vector<uint8_t>>
@@ -225,6 +397,7 @@ InputMethod1::createInputContext(
     auto sender = currentMessage()->sender();
     auto ic = new DBusInputContext1(icIdx++, instance_->inputContextManager(),
                                     this, sender, program);
+    addInputContext(ic);
     ic->setFocusGroup(instance_->defaultFocusGroup(display ? *display : ""));
 
     bus_->addObjectVTable(ic->path().path(), FCITX_INPUTCONTEXT_DBUS_INTERFACE,
@@ -250,6 +423,8 @@ DBusFrontendModule::DBusFrontendModule(Instance *instance)
         FCITX_LOG(Warn) << "Can not get portal dbus name right now.";
     }
 
+    listenPeers();
+
     event_ = instance_->watchEvent(
         EventType::InputContextInputMethodActivated, EventWatcherPhase::Default,
         [this](Event &event) {
@@ -266,12 +441,90 @@ DBusFrontendModule::DBusFrontendModule(Instance *instance)
 
 DBusFrontendModule::~DBusFrontendModule() {
     portalBus_->releaseName(FCITX_PORTAL_DBUS_SERVICE);
+
+    peers_.clear();
+    if (server_) {
+        RawConfig config;
+        auto file = StandardPath::global().open(StandardPath::Type::Runtime,
+                                                addressFile_, O_RDONLY);
+        if (file.fd() >= 0) {
+            readFromIni(config, file.fd());
+        }
+        auto pid = config.valueByPath("FCITX_DAEMON_PID");
+        if (pid && *pid == std::to_string(getpid())) {
+            unlink(stringutils::joinPath(StandardPath::global().userDirectory(
+                                             StandardPath::Type::Runtime),
+                                         addressFile_)
+                       .c_str());
+        }
+    }
 }
 
 dbus::Bus *DBusFrontendModule::bus() {
     return dbus()->call<IDBusModule::bus>();
 }
 
+void DBusFrontendModule::listenPeers() {
+    auto runtime =
+        StandardPath::global().userDirectory(StandardPath::Type::Runtime);
+    if (runtime.empty()) {
+        return;
+    }
+    auto name = peerName();
+    auto server =
+        std::make_unique<dbus::Server>(stringutils::joinPath(runtime, name));
+    if (!server->isOpen()) {
+        FCITX_LOG(Warn) << "Failed to listen on " << name;
+        return;
+    }
+    server->setSenderName(FCITX_PORTAL_DBUS_SERVICE);
+    server->setNewConnectionCallback(
+        [this](std::unique_ptr<dbus::Bus> bus) { addPeer(std::move(bus)); });
+    server->attachEventLoop(&instance_->eventLoop());
+
+    RawConfig config;
+    config.setValueByPath("FCITX_ADDRESS", server->address());
+    config.setValueByPath("FCITX_DAEMON_PID", std::to_string(getpid()));
+    addressFile_ = stringutils::concat(name, ".address");
+    if (!StandardPath::global().safeSave(
+            StandardPath::Type::Runtime, addressFile_,
+            [&config](int fd) { return writeAsIni(config, fd); })) {
+        return;
+    }
+    server_ = std::move(server);
+}
+
+void DBusFrontendModule::addPeer(std::unique_ptr<dbus::Bus> bus) {
+    auto busPtr = bus.get();
+    auto peer = std::make_unique<DBusPeer>(this, std::move(bus));
+    // The bus can't be destroyed while it is dispatching the signal.
+    peer->disconnected_ = busPtr->addMatch(
+        dbus::MatchRule("", "/org/freedesktop/DBus/Local",
+                        "org.freedesktop.DBus.Local", "Disconnected"),
+        [this, busPtr](dbus::Message &) {
+            if (!peers_.count(busPtr)) {
+                return true;
+            }
+            closedPeers_.insert(busPtr);
+            if (!closePeersEvent_) {
+                // Owned by the module rather than the peer, so it is never
+                // freed from its own callback.
+                closePeersEvent_ = instance_->eventLoop().addDeferEvent(
+                    [this](EventSource *) {
+                        auto closedPeers = std::move(closedPeers_);
+                        closedPeers_.clear();
+                        for (auto *bus : closedPeers) {
+                            peers_.erase(bus);
+                        }
+                        return true;
+                    });
+            }
+            closePeersEvent_->setOneShot();
+            return true;
+        });
+    peers_.emplace(busPtr, std::move(peer));
+}
+
 class DBusFrontendModuleFactory : public AddonFactory {
 public:
     AddonInstance *create(AddonManager *manager) override {
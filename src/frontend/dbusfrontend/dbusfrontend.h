@@ -19,6 +19,7 @@
 #ifndef _FCITX_FRONTEND_DBUSFRONTEND_DBUSFRONTEND_H_
 #define _FCITX_FRONTEND_DBUSFRONTEND_DBUSFRONTEND_H_
 
+#include "fcitx-utils/dbus/bus.h"
 #include "fcitx-utils/dbus/servicewatcher.h"
 #include "fcitx-utils/event.h"
 #include "fcitx/addonfactory.h"
@@ -26,12 +27,15 @@
 #include "fcitx/addonmanager.h"
 #include "fcitx/focusgroup.h"
 #include "fcitx/instance.h"
+#include <unordered_map>
+#include <unordered_set>
 
 namespace fcitx {
 
 class AddonInstance;
 class Instance;
 class InputMethod1;
+class DBusPeer;
 
 class DBusFrontendModule : public AddonInstance {
 public:
@@ -44,11 +48,21 @@ public:
 private:
     FCITX_ADDON_DEPENDENCY_LOADER(dbus, instance_->addonManager());
 
+    void listenPeers();
+    void addPeer(std::unique_ptr<dbus::Bus> bus);
+
     Instance *instance_;
     std::unique_ptr<dbus::Bus> portalBus_;
     std::unique_ptr<InputMethod1> inputMethod1_;
     std::unique_ptr<InputMethod1> portalInputMethod1_;
     std::unique_ptr<HandlerTableEntry<EventHandler>> event_;
+    std::unique_ptr<dbus::Server> server_;
+    std::unordered_map<dbus::Bus *, std::unique_ptr<DBusPeer>> peers_;
+    // Disconnected peers, freed from closePeersEvent_ once the bus is no
+    // longer dispatching.
+    std::unordered_set<dbus::Bus *> closedPeers_;
+    std::unique_ptr<EventSource> closePeersEvent_;
+    std::string addressFile_;
 };
 } // namespace fcitx
 
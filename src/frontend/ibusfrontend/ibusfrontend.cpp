@@ -30,6 +30,7 @@
 #include "fcitx-utils/stringutils.h"
 #include "fcitx-utils/utf8.h"
 #include "fcitx/inputcontext.h"
+#include "fcitx/inputcontextmanager.h"
 #include "fcitx/instance.h"
 #include "fcitx/misc_p.h"
 #include <fcntl.h>
@@ -38,6 +39,7 @@
 #include <signal.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <unordered_map>
 
 #define IBUS_INPUTMETHOD_DBUS_INTERFACE "org.freedesktop.IBus"
 #define IBUS_INPUTCONTEXT_DBUS_INTERFACE "org.freedesktop.IBus.InputContext"
@@ -120,6 +122,19 @@ std::string getFullSocketPath(void) {
         getSocketPath());
 }
 
+// The unix socket of the peer to peer server, named after the address file.
+std::string getPeerSocketPath() {
+    auto runtime =
+        StandardPath::global().userDirectory(StandardPath::Type::Runtime);
+    if (runtime.empty()) {
+        return {};
+    }
+    auto socketPath = getSocketPath();
+    auto name = socketPath.substr(socketPath.rfind('/') + 1);
+    return stringutils::joinPath(runtime,
+                                 stringutils::concat("fcitx5-ibus-", name));
+}
+
 std::pair<std::string, pid_t> getAddress(const std::string &socketPath) {
     pid_t pid = -1;
 
@@ -190,6 +205,8 @@ public:
         bus_->addObjectVTable("/org/freedesktop/IBus", interface, *this);
     }
 
+    ~IBusFrontend();
+
     dbus::ObjectPath createInputContext(const std::string &args);
 
     dbus::ServiceWatcher &serviceWatcher() { return *watcher_; }
@@ -226,11 +243,34 @@ IBusAttrList makeIBusAttrList() {
     return attrList;
 }
 
-IBusText makeSimpleIBusText(const std::string &str) {
+// Variant data is shared between copies, so the common attribute lists are
+// only built once.
+const dbus::Variant &emptyIBusAttrList() {
+    static const dbus::Variant attrList(makeIBusAttrList());
+    return attrList;
+}
+
+constexpr size_t maxCachedIBusAttrLists = 64;
+
+const dbus::Variant &underlineIBusAttrList(uint32_t length) {
+    static std::unordered_map<uint32_t, dbus::Variant> cache;
+    auto iter = cache.find(length);
+    if (iter == cache.end()) {
+        if (cache.size() >= maxCachedIBusAttrLists) {
+            cache.clear();
+        }
+        IBusAttrList attrList = makeIBusAttrList();
+        std::get<2>(attrList).emplace_back(makeIBusAttr(1, 1, 0, length));
+        iter = cache.emplace(length, dbus::Variant(std::move(attrList))).first;
+    }
+    return iter->second;
+}
+
+IBusText makeSimpleIBusText(std::string str) {
     IBusText text;
     std::get<0>(text) = "IBusText";
-    std::get<2>(text) = str;
-    std::get<3>(text).setData(makeIBusAttrList());
+    std::get<2>(text) = std::move(str);
+    std::get<3>(text) = emptyIBusAttrList();
     return text;
 }
 
@@ -253,54 +293,101 @@ public:
                      const std::string &sender, const std::string &program)
         : InputContext(icManager, program),
           path_("/org/freedesktop/IBus/InputContext_" + std::to_string(id)),
-          im_(im), handler_(im_->serviceWatcher().watchService(
-                       sender,
-                       [this](const std::string &, const std::string &,
-                              const std::string &newName) {
-                           if (newName.empty()) {
-                               delete this;
-                           }
-                       })),
-          name_(sender) {
+          im_(im), name_(sender) {
+        // Messages from a peer to peer connection have no sender, the input
+        // context goes away together with the connection instead.
+        if (!sender.empty()) {
+            handler_ = im_->serviceWatcher().watchService(
+                sender, [this](const std::string &, const std::string &,
+                               const std::string &newName) {
+                    if (newName.empty()) {
+                        delete this;
+                    }
+                });
+        }
 
         im->bus()->addObjectVTable(path().path(),
                                    IBUS_INPUTCONTEXT_DBUS_INTERFACE, *this);
         im->bus()->addObjectVTable(path().path(), IBUS_SERVICE_DBUS_INTERFACE,
                                    service_);
+        flushEvent_ =
+            im->instance()->eventLoop().addDeferEvent([this](EventSource *) {
+                flush();
+                return true;
+            });
+        flushEvent_->setEnabled(false);
         created();
     }
 
-    ~IBusInputContext() { InputContext::destroy(); }
+    ~IBusInputContext() {
+        InputContext::destroy();
+        // Destroying may still commit, e.g. on focus out. Send whatever is
+        // held, as long as the client is still reachable.
+        if (bus()) {
+            flush();
+        }
+    }
 
     const char *frontend() const override { return "ibus"; }
 
+    IBusFrontend *im() const { return im_; }
     const std::string &name() const { return name_; }
 
     const dbus::ObjectPath path() const { return path_; }
 
+    // Commit and preedit updates are held until the end of the current event
+    // loop iteration, or the end of ProcessKeyEvent, so only the final
+    // preedit is sent. Anything else that goes to the client flushes them
+    // first to keep the order.
     void commitStringImpl(const std::string &str) override {
-        IBusText text = makeSimpleIBusText(str);
-        commitTextTo(name_, dbus::Variant(std::move(text)));
+        if (pendingPreedit_) {
+            flush();
+        }
+        pendingCommit_ += str;
+        hasPendingCommit_ = true;
+        flushEvent_->setOneShot();
     }
 
     void updatePreeditImpl() override {
+        pendingPreedit_ = true;
+        flushEvent_->setOneShot();
+    }
+
+    void flush() {
+        flushEvent_->setEnabled(false);
+        if (hasPendingCommit_) {
+            hasPendingCommit_ = false;
+            IBusText text = makeSimpleIBusText(std::move(pendingCommit_));
+            pendingCommit_.clear();
+            commitTextTo(name_, dbus::Variant(std::move(text)));
+        }
+        if (pendingPreedit_) {
+            pendingPreedit_ = false;
+            sendPreedit();
+        }
+    }
+
+    void sendPreedit() {
         auto preedit =
             im_->instance()->outputFilter(this, inputPanel().clientPreedit());
         // variant : -> s, a{sv} sv
         // v -> s a? av
-        dbus::Variant v;
         IBusText text = makeSimpleIBusText(preedit.toString());
 
         IBusAttrList attrList = makeIBusAttrList();
 
         size_t offset = 0;
+        bool underlineOnly = true;
         for (int i = 0, e = preedit.size(); i < e; i++) {
             auto len = utf8::length(preedit.stringAt(i));
             if (preedit.formatAt(i) & TextFormatFlag::Underline) {
                 std::get<2>(attrList).emplace_back(
                     makeIBusAttr(1, 1, offset, offset + len));
+            } else {
+                underlineOnly = false;
             }
             if (preedit.formatAt(i) & TextFormatFlag::HighLight) {
+                underlineOnly = false;
                 std::get<2>(attrList).emplace_back(
                     makeIBusAttr(2, 16777215, offset, offset + len));
                 std::get<2>(attrList).emplace_back(
@@ -310,9 +397,16 @@ public:
             offset += len;
         }
 
-        std::get<3>(text).setData(std::move(attrList));
+        if (std::get<2>(attrList).empty()) {
+            // Already set by makeSimpleIBusText.
+        } else if (underlineOnly) {
+            // Whole text is underlined, which is the most common case.
+            std::get<3>(text) = underlineIBusAttrList(offset);
+        } else {
+            std::get<3>(text).setData(std::move(attrList));
+        }
 
-        v.setData(std::move(text));
+        dbus::Variant v(std::move(text));
         uint32_t cursor = preedit.cursor() >= 0 ? preedit.cursor() : 0;
         if (clientCommitPreedit_) {
             updatePreeditTextWithModeTo(name_, v, cursor, offset ? true : false,
@@ -323,10 +417,12 @@ public:
     }
 
     void deleteSurroundingTextImpl(int offset, unsigned int size) override {
+        flush();
         deleteSurroundingTextDBusTo(name_, offset, size);
     }
 
     void forwardKeyImpl(const ForwardKeyEvent &key) override {
+        flush();
         uint32_t state = static_cast<uint32_t>(key.rawKey().states());
         if (key.isRelease()) {
             state |= releaseMask;
@@ -415,7 +511,10 @@ public:
             focusIn();
         }
 
-        return keyEvent(event);
+        auto result = keyEvent(event);
+        // Client should see the result before the reply.
+        flush();
+        return result;
     }
 
     void enable() {}
@@ -602,6 +701,10 @@ private:
     std::unique_ptr<HandlerTableEntry<dbus::ServiceWatcherCallback>> handler_;
     std::string name_;
     bool clientCommitPreedit_ = false;
+    std::unique_ptr<EventSource> flushEvent_;
+    bool pendingPreedit_ = false;
+    bool hasPendingCommit_ = false;
+    std::string pendingCommit_;
 
     IBusService service_{this};
 };
@@ -613,6 +716,34 @@ void IBusService::destroyDBus() {
     delete ic_;
 }
 
+IBusFrontend::~IBusFrontend() {
+    std::vector<IBusInputContext *> ics;
+    instance_->inputContextManager().foreach([this, &ics](InputContext *ic) {
+        if (strcmp(ic->frontend(), "ibus") == 0) {
+            auto ibusIC = static_cast<IBusInputContext *>(ic);
+            if (ibusIC->im() == this) {
+                ics.push_back(ibusIC);
+            }
+        }
+        return true;
+    });
+    for (auto ic : ics) {
+        delete ic;
+    }
+}
+
+// A client connected to the peer to peer server.
+class IBusPeer {
+public:
+    IBusPeer(IBusFrontendModule *module, std::unique_ptr<dbus::Bus> bus)
+        : bus_(std::move(bus)),
+          frontend_(module, bus_.get(), IBUS_INPUTMETHOD_DBUS_INTERFACE) {}
+
+    std::unique_ptr<dbus::Bus> bus_;
+    IBusFrontend frontend_;
+    std::unique_ptr<dbus::Slot> disconnected_;
+};
+
 dbus::ObjectPath
 IBusFrontend::createInputContext(const std::string & /* unused */) {
     auto sender = currentMessage()->sender();
@@ -634,6 +765,8 @@ IBusFrontendModule::IBusFrontendModule(Instance *instance)
 }
 
 IBusFrontendModule::~IBusFrontendModule() {
+    peers_.clear();
+
     if (portalBus_) {
         portalBus_->releaseName(IBUS_PORTAL_DBUS_SERVICE);
     }
@@ -650,6 +783,54 @@ dbus::Bus *IBusFrontendModule::bus() {
     return dbus()->call<IDBusModule::bus>();
 }
 
+void IBusFrontendModule::listenPeers() {
+    auto path = getPeerSocketPath();
+    if (path.empty()) {
+        return;
+    }
+    server_ = std::make_unique<dbus::Server>(path);
+    if (!server_->isOpen()) {
+        FCITX_LOG(Warn) << "Failed to listen on " << path;
+        server_.reset();
+        return;
+    }
+    server_->setSenderName("org.freedesktop.IBus");
+    server_->setNewConnectionCallback(
+        [this](std::unique_ptr<dbus::Bus> bus) { addPeer(std::move(bus)); });
+    server_->attachEventLoop(&instance()->eventLoop());
+}
+
+void IBusFrontendModule::addPeer(std::unique_ptr<dbus::Bus> bus) {
+    auto busPtr = bus.get();
+    auto peer = std::make_unique<IBusPeer>(this, std::move(bus));
+    // The bus can't be destroyed while it is dispatching the signal.
+    peer->disconnected_ = busPtr->addMatch(
+        dbus::MatchRule("", "/org/freedesktop/DBus/Local",
+                        "org.freedesktop.DBus.Local", "Disconnected"),
+        [this, busPtr](dbus::Message &) {
+            if (!peers_.count(busPtr)) {
+                return true;
+            }
+            closedPeers_.insert(busPtr);
+            if (!closePeersEvent_) {
+                // Owned by the module rather than the peer, so it is never
+                // freed from its own callback.
+                closePeersEvent_ = instance()->eventLoop().addDeferEvent(
+                    [this](EventSource *) {
+                        auto closedPeers = std::move(closedPeers_);
+                        closedPeers_.clear();
+                        for (auto *bus : closedPeers) {
+                            peers_.erase(bus);
+                        }
+                        return true;
+                    });
+            }
+            closePeersEvent_->setOneShot();
+            return true;
+        });
+    peers_.emplace(busPtr, std::move(peer));
+}
+
 void IBusFrontendModule::replaceIBus() {
     auto address = getAddress(socketPath_);
     oldAddress_ = address.first;
@@ -711,16 +892,24 @@ void IBusFrontendModule::becomeIBus() {
 
     inputMethod1_ = std::make_unique<IBusFrontend>(
         this, bus(), IBUS_INPUTMETHOD_DBUS_INTERFACE);
+    listenPeers();
     RawConfig config;
-    auto address = bus()->address();
-    // This is a small hack to make ibus think that address is changed.
-    // Otherwise it won't retry connection since we always use session bus
-    // instead of start our own one.
-    // https://dbus.freedesktop.org/doc/dbus-specification.html#addresses
-    // DBus address may use ; to add multiple fallback addresses.
-    // Adding a semicolon at the end of the address won't change the behavior.
-    if (oldAddress_.find(';') == std::string::npos) {
-        address += ";";
+    std::string address;
+    if (server_) {
+        // Clients talk to us directly instead of through the bus daemon.
+        address = server_->address();
+    } else {
+        address = bus()->address();
+        // This is a small hack to make ibus think that address is changed.
+        // Otherwise it won't retry connection since we always use session
+        // bus instead of start our own one.
+        // https://dbus.freedesktop.org/doc/dbus-specification.html#addresses
+        // DBus address may use ; to add multiple fallback addresses.
+        // Adding a semicolon at the end of the address won't change the
+        // behavior.
+        if (oldAddress_.find(';') == std::string::npos) {
+            address += ";";
+        }
     }
     config.setValueByPath("IBUS_ADDRESS", address);
     config.setValueByPath("IBUS_DAEMON_PID", std::to_string(getpid()));
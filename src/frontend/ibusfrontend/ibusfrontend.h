@@ -19,6 +19,7 @@
 #ifndef _FCITX_FRONTEND_IBUSFRONTEND_IBUSFRONTEND_H_
 #define _FCITX_FRONTEND_IBUSFRONTEND_IBUSFRONTEND_H_
 
+#include "fcitx-utils/dbus/bus.h"
 #include "fcitx-utils/dbus/servicewatcher.h"
 #include "fcitx-utils/event.h"
 #include "fcitx/addonfactory.h"
@@ -27,12 +28,15 @@
 #include "fcitx/focusgroup.h"
 #include "fcitx/instance.h"
 #include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace fcitx {
 
 class AddonInstance;
 class Instance;
 class IBusFrontend;
+class IBusPeer;
 
 class IBusFrontendModule : public AddonInstance {
 public:
@@ -47,6 +51,8 @@ private:
 
     void replaceIBus();
     void becomeIBus();
+    void listenPeers();
+    void addPeer(std::unique_ptr<dbus::Bus> bus);
 
     Instance *instance_;
     std::string oldAddress_;
@@ -54,6 +60,12 @@ private:
     std::unique_ptr<IBusFrontend> inputMethod1_;
     std::unique_ptr<IBusFrontend> portalIBusFrontend_;
     std::unique_ptr<EventSourceTime> timeEvent_;
+    std::unique_ptr<dbus::Server> server_;
+    std::unordered_map<dbus::Bus *, std::unique_ptr<IBusPeer>> peers_;
+    // Disconnected peers, freed from closePeersEvent_ once the bus is no
+    // longer dispatching.
+    std::unordered_set<dbus::Bus *> closedPeers_;
+    std::unique_ptr<EventSource> closePeersEvent_;
 
     std::string socketPath_;
     std::string addressWrote_;
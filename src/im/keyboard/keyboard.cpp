@@ -24,16 +24,19 @@
 #include "fcitx-config/iniparser.h"
 #include "fcitx-utils/charutils.h"
 #include "fcitx-utils/cutf8.h"
+#include "fcitx-utils/fs.h"
 #include "fcitx-utils/i18n.h"
 #include "fcitx-utils/log.h"
 #include "fcitx-utils/standardpath.h"
 #include "fcitx-utils/stringutils.h"
 #include "fcitx-utils/utf8.h"
+#include "fcitx/binarycache_p.h"
 #include "fcitx/inputcontext.h"
 #include "fcitx/inputcontextmanager.h"
 #include "fcitx/inputcontextproperty.h"
 #include "fcitx/inputpanel.h"
 #include "fcitx/instance.h"
+#include "isocodes.h"
 #include "notifications_public.h"
 #include "spell_public.h"
 #include "xcb_public.h"
@@ -41,6 +44,8 @@
 #include <fcntl.h>
 #include <fmt/format.h>
 #include <libintl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 const char imNamePrefix[] = "keyboard-";
 #define FCITX_KEYBOARD_MAX_BUFFER 20
@@ -159,11 +164,37 @@ static std::string findBestLanguage(const IsoCodes &isocodes,
     }
     return {};
 }
+
+constexpr char rulesIndexMagic[] = "FCITXKBI";
+// Bump this if the format or the language guessing changes.
+constexpr uint32_t rulesIndexVersion = 1;
+
+std::string rulesIndexFile(const std::string &file) {
+    return stringutils::concat("fcitx5/xkbrules_", fs::baseName(file),
+                               ".cache");
+}
+
+// Every file that the parsed result depends on, missing files are recorded
+// as well so that creating one invalidates the index.
+std::vector<FileStamp> rulesStamps(const std::string &file) {
+    std::vector<std::string> files{file};
+    if (stringutils::endsWith(file, ".xml")) {
+        files.push_back(file.substr(0, file.size() - 3) + "extras.xml");
+    }
+    files.push_back(ISOCODES_ISO639_JSON);
+    files.push_back(ISOCODES_ISO3166_JSON);
+    std::vector<FileStamp> stamps;
+    for (const auto &path : files) {
+        stamps.emplace_back();
+        readFileStamp(path, stamps.back());
+    }
+    return stamps;
+}
+
 } // namespace
 
 KeyboardEngine::KeyboardEngine(Instance *instance) : instance_(instance) {
     registerDomain("xkeyboard-config", XKEYBOARDCONFIG_DATADIR "/locale");
-    isoCodes_.read(ISOCODES_ISO639_JSON, ISOCODES_ISO3166_JSON);
     auto xcb = instance_->addonManager().addon("xcb");
     std::string rule;
     if (xcb) {
@@ -177,9 +208,9 @@ KeyboardEngine::KeyboardEngine(Instance *instance) : instance_(instance) {
             ruleName_ = rule;
         }
     }
-    if (rule.empty() || !xkbRules_.read(rule)) {
+    if (rule.empty() || !loadRules(rule)) {
         rule = XKEYBOARDCONFIG_XKBBASE "/rules/" DEFAULT_XKB_RULES ".xml";
-        xkbRules_.read(rule);
+        loadRules(rule);
         ruleName_ = DEFAULT_XKB_RULES;
     }
 
@@ -190,38 +221,133 @@ KeyboardEngine::KeyboardEngine(Instance *instance) : instance_(instance) {
 
 KeyboardEngine::~KeyboardEngine() {}
 
+bool KeyboardEngine::loadRules(const std::string &file) {
+    auto stamps = rulesStamps(file);
+    if (readRulesIndex(file, stamps)) {
+        return true;
+    }
+
+    languages_.clear();
+    if (!xkbRules_.read(file)) {
+        return false;
+    }
+    // Iso codes are only needed to guess the languages, which are saved
+    // in the index together with the layouts.
+    IsoCodes isoCodes;
+    isoCodes.read(ISOCODES_ISO639_JSON, ISOCODES_ISO3166_JSON);
+    for (auto &p : xkbRules_.layoutInfos()) {
+        auto &layoutInfo = p.second;
+        languages_[imNamePrefix + layoutInfo.name] = findBestLanguage(
+            isoCodes, layoutInfo.description, layoutInfo.languages);
+        for (auto &variantInfo : layoutInfo.variantInfos) {
+            languages_[stringutils::concat(imNamePrefix, layoutInfo.name, "-",
+                                           variantInfo.name)] =
+                findBestLanguage(isoCodes, variantInfo.description,
+                                 variantInfo.languages.size()
+                                     ? variantInfo.languages
+                                     : layoutInfo.languages);
+        }
+    }
+    writeRulesIndex(file, stamps);
+    layoutsChanged_ = true;
+    return true;
+}
+
+bool KeyboardEngine::readRulesIndex(const std::string &file,
+                                    const std::vector<FileStamp> &stamps) {
+    auto fd = StandardPath::global().openUser(
+        StandardPath::Type::Cache, rulesIndexFile(file), O_RDONLY);
+    struct stat stat;
+    if (fd.fd() < 0 || fstat(fd.fd(), &stat) != 0 || stat.st_size <= 0) {
+        return false;
+    }
+    auto size = static_cast<size_t>(stat.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.fd(), 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    BinaryCacheReader reader(static_cast<const char *>(data), size);
+    uint32_t version, count = 0;
+    std::vector<FileStamp> cachedStamps;
+    bool success = reader.expectBytes(rulesIndexMagic,
+                                      sizeof(rulesIndexMagic)) &&
+                   reader.readInt(version) && version == rulesIndexVersion &&
+                   reader.readStamps(cachedStamps) && cachedStamps == stamps &&
+                   xkbRules_.readLayouts(reader) && reader.readInt(count);
+    languages_.clear();
+    for (uint32_t i = 0; success && i < count; i++) {
+        std::string name, language;
+        success = reader.readString(name) && reader.readString(language);
+        languages_.emplace(std::move(name), std::move(language));
+    }
+    success = success && reader.atEnd();
+    munmap(data, size);
+
+    if (!success) {
+        xkbRules_.clear();
+        languages_.clear();
+    }
+    return success;
+}
+
+void KeyboardEngine::writeRulesIndex(const std::string &file,
+                                     const std::vector<FileStamp> &stamps) {
+    BinaryCacheWriter writer;
+    writer.writeBytes(rulesIndexMagic, sizeof(rulesIndexMagic));
+    writer.writeInt(rulesIndexVersion);
+    writer.writeStamps(stamps);
+    xkbRules_.writeLayouts(writer);
+    writer.writeInt<uint32_t>(languages_.size());
+    for (const auto &item : languages_) {
+        writer.writeString(item.first);
+        writer.writeString(item.second);
+    }
+    const auto &buffer = writer.buffer();
+    StandardPath::global().safeSave(
+        StandardPath::Type::Cache, rulesIndexFile(file), [&buffer](int fd) {
+            return fs::safeWrite(fd, buffer.data(), buffer.size()) ==
+                   static_cast<ssize_t>(buffer.size());
+        });
+}
+
 std::vector<InputMethodEntry> KeyboardEngine::listInputMethods() {
     std::vector<InputMethodEntry> result;
     bool usExists = false;
     for (auto &p : xkbRules_.layoutInfos()) {
         auto &layoutInfo = p.second;
-        auto language = findBestLanguage(isoCodes_, layoutInfo.description,
-                                         layoutInfo.languages);
-        auto description =
-            fmt::format(_("Keyboard - {0}"),
-                        D_("xkeyboard-config", layoutInfo.description));
         auto uniqueName = imNamePrefix + layoutInfo.name;
+        auto language = findValue(languages_, uniqueName);
         if (uniqueName == "keyboard-us") {
             usExists = true;
         }
+        // Only a few layouts are ever displayed, so translate the names on
+        // demand.
         result.push_back(std::move(
-            InputMethodEntry(uniqueName, description, language, "keyboard")
+            InputMethodEntry(uniqueName, "", language ? *language : "",
+                             "keyboard")
+                .setNameResolver([description = layoutInfo.description]() {
+                    return fmt::format(_("Keyboard - {0}"),
+                                       D_("xkeyboard-config", description));
+                })
                 .setLabel(layoutInfo.name)
                 .setIcon("input-keyboard")
                 .setConfigurable(true)));
         for (auto &variantInfo : layoutInfo.variantInfos) {
-            auto language = findBestLanguage(isoCodes_, variantInfo.description,
-                                             variantInfo.languages.size()
-                                                 ? variantInfo.languages
-                                                 : layoutInfo.languages);
-            auto description =
-                fmt::format(_("Keyboard - {0} - {1}"),
-                            D_("xkeyboard-config", layoutInfo.description),
-                            D_("xkeyboard-config", variantInfo.description));
             auto uniqueName = stringutils::concat(imNamePrefix, layoutInfo.name,
                                                   "-", variantInfo.name);
+            auto language = findValue(languages_, uniqueName);
             result.push_back(std::move(
-                InputMethodEntry(uniqueName, description, language, "keyboard")
+                InputMethodEntry(uniqueName, "", language ? *language : "",
+                                 "keyboard")
+                    .setNameResolver(
+                        [layoutDescription = layoutInfo.description,
+                         variantDescription = variantInfo.description]() {
+                            return fmt::format(
+                                _("Keyboard - {0} - {1}"),
+                                D_("xkeyboard-config", layoutDescription),
+                                D_("xkeyboard-config", variantDescription));
+                        })
                     .setLabel(layoutInfo.name)
                     .setIcon("input-keyboard")));
         }
@@ -251,19 +377,7 @@ std::vector<InputMethodEntry> KeyboardEngine::listInputMethods() {
             }
         }
     } else {
-        RawConfig config;
-        for (auto &item : result) {
-            config.setValueByPath(
-                stringutils::joinPath(item.uniqueName(), "Description"),
-                item.name());
-            config.setValueByPath(
-                stringutils::joinPath(item.uniqueName(), "Language"),
-                item.languageCode());
-            config.setValueByPath(
-                stringutils::joinPath(item.uniqueName(), "Label"),
-                item.label());
-        }
-        safeSaveAsIni(config, "conf/cached_layouts");
+        saveCachedLayouts(result);
     }
     if (!usExists) {
         result.push_back(std::move(
@@ -275,8 +389,44 @@ std::vector<InputMethodEntry> KeyboardEngine::listInputMethods() {
     return result;
 }
 
+void KeyboardEngine::saveCachedLayouts(
+    const std::vector<InputMethodEntry> &entries) {
+    // Saving resolves every name, only do it when the layouts or the
+    // language of their names changed.
+    auto locale = messagesLocale();
+    if (!layoutsChanged_ && cachedLayoutsLocale_.empty()) {
+        RawConfig saved;
+        readAsIni(saved, "conf/cached_layouts");
+        if (auto value = saved.valueByPath("Locale")) {
+            cachedLayoutsLocale_ = *value;
+        }
+    }
+    if (!layoutsChanged_ && cachedLayoutsLocale_ == locale) {
+        return;
+    }
+    layoutsChanged_ = false;
+    cachedLayoutsLocale_ = locale;
+    RawConfig config;
+    config.setValueByPath("Locale", locale);
+    for (auto &item : entries) {
+        config.setValueByPath(
+            stringutils::joinPath(item.uniqueName(), "Description"),
+            item.name());
+        config.setValueByPath(
+            stringutils::joinPath(item.uniqueName(), "Language"),
+            item.languageCode());
+        config.setValueByPath(stringutils::joinPath(item.uniqueName(), "Label"),
+                              item.label());
+    }
+    safeSaveAsIni(config, "conf/cached_layouts");
+}
+
 void KeyboardEngine::reloadConfig() {
-    readAsIni(config_, "conf/keyboard.conf");
+    auto changed = reloadAsIni(config_, "conf/keyboard.conf");
+    if (std::find(changed.begin(), changed.end(),
+                  config_.chooseModifier.path()) == changed.end()) {
+        return;
+    }
     selectionKeys_.clear();
     KeySym syms[] = {
         FcitxKey_1, FcitxKey_2, FcitxKey_3, FcitxKey_4, FcitxKey_5,
@@ -28,7 +28,6 @@
 #include "fcitx/inputcontextproperty.h"
 #include "fcitx/inputmethodengine.h"
 #include "fcitx/instance.h"
-#include "isocodes.h"
 #include "keyboard_public.h"
 #include "xkbrules.h"
 #include <xkbcommon/xkbcommon-compose.h>
@@ -36,6 +35,8 @@
 
 namespace fcitx {
 
+struct FileStamp;
+
 class Instance;
 
 FCITX_CONFIG_ENUM(ChooseModifier, None, Alt, Control, Super);
@@ -128,13 +129,24 @@ private:
     void commitBuffer(InputContext *inputContext);
     void updateUI(InputContext *inputContext);
 
+    bool loadRules(const std::string &file);
+    void saveCachedLayouts(const std::vector<InputMethodEntry> &entries);
+    bool readRulesIndex(const std::string &file,
+                        const std::vector<FileStamp> &stamps);
+    void writeRulesIndex(const std::string &file,
+                         const std::vector<FileStamp> &stamps);
+
     Instance *instance_;
     AddonInstance *spell_ = nullptr;
     AddonInstance *notifications_ = nullptr;
     KeyboardEngineConfig config_;
-    IsoCodes isoCodes_;
     XkbRules xkbRules_;
+    // Best language of each layout and variant, keyed by unique name.
+    std::unordered_map<std::string, std::string> languages_;
     std::string ruleName_;
+    bool layoutsChanged_ = false;
+    // Locale of the names in conf/cached_layouts, empty if not known yet.
+    std::string cachedLayoutsLocale_;
     KeyList selectionKeys_;
 
     FactoryFor<KeyboardEngineState> factory_{
@@ -19,6 +19,7 @@
 
 #include "xkbrules.h"
 #include "fcitx-utils/stringutils.h"
+#include "fcitx/binarycache_p.h"
 #include "xmlparser.h"
 #include <cstring>
 #include <list>
@@ -180,6 +181,53 @@ bool XkbRules::read(const std::string &fileName) {
     return true;
 }
 
+void XkbRules::writeLayouts(BinaryCacheWriter &writer) const {
+    writer.writeInt<uint32_t>(layoutInfos_.size());
+    for (const auto &p : layoutInfos_) {
+        const auto &layoutInfo = p.second;
+        writer.writeString(layoutInfo.name);
+        writer.writeString(layoutInfo.description);
+        writer.writeStrings(layoutInfo.languages);
+        writer.writeInt<uint32_t>(layoutInfo.variantInfos.size());
+        for (const auto &variantInfo : layoutInfo.variantInfos) {
+            writer.writeString(variantInfo.name);
+            writer.writeString(variantInfo.description);
+            writer.writeStrings(variantInfo.languages);
+        }
+    }
+}
+
+bool XkbRules::readLayouts(BinaryCacheReader &reader) {
+    clear();
+    uint32_t count;
+    if (!reader.readInt(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        XkbLayoutInfo layoutInfo;
+        uint32_t variantCount;
+        if (!reader.readString(layoutInfo.name) ||
+            !reader.readString(layoutInfo.description) ||
+            !reader.readStrings(layoutInfo.languages) ||
+            !reader.readInt(variantCount)) {
+            clear();
+            return false;
+        }
+        for (uint32_t j = 0; j < variantCount; j++) {
+            auto &variantInfo = layoutInfo.variantInfos.emplace_back();
+            if (!reader.readString(variantInfo.name) ||
+                !reader.readString(variantInfo.description) ||
+                !reader.readStrings(variantInfo.languages)) {
+                clear();
+                return false;
+            }
+        }
+        std::string name = layoutInfo.name;
+        layoutInfos_.emplace(std::move(name), std::move(layoutInfo));
+    }
+    return true;
+}
+
 #ifdef _TEST_XKBRULES
 void XkbRules::dump() {
     std::cout << "Version: " << version_ << std::endl;
@@ -57,11 +57,18 @@ struct XkbOptionGroupInfo {
     bool exclusive;
 };
 
+class BinaryCacheReader;
+class BinaryCacheWriter;
 struct XkbRulesParseState;
 class XkbRules {
 public:
     friend struct XkbRulesParseState;
     bool read(const std::string &fileName);
+
+    // Serialize only the layouts, which is all the keyboard engine needs at
+    // startup. Models and options are left empty by readLayouts.
+    void writeLayouts(BinaryCacheWriter &writer) const;
+    bool readLayouts(BinaryCacheReader &reader);
 #ifdef _TEST_XKBRULES
     void dump();
 #endif
@@ -31,6 +31,9 @@ class ConfigurationPrivate {
 public:
     std::list<std::string> optionsOrder_;
     std::unordered_map<std::string, OptionBase *> options_;
+    // Identity of the file last read by reloadAsIni, cleared by any other
+    // load since the values may not match the file anymore.
+    std::string sourceStamp_;
 };
 
 Configuration::Configuration()
@@ -90,6 +93,7 @@ void Configuration::copyHelper(const Configuration &other) {
 
 void Configuration::load(const RawConfig &config, bool partial) {
     FCITX_D();
+    d->sourceStamp_.clear();
     for (const auto &path : d->optionsOrder_) {
         auto subConfigPtr = config.get(path);
         auto option = d->options_[path];
@@ -105,6 +109,31 @@ void Configuration::load(const RawConfig &config, bool partial) {
     }
 }
 
+std::vector<std::string> Configuration::reload(const RawConfig &config) {
+    return reloadWith([this, &config]() { load(config); });
+}
+
+std::vector<std::string>
+Configuration::reloadWith(const std::function<void()> &loader) {
+    FCITX_D();
+    std::vector<RawConfig> oldValues(d->optionsOrder_.size());
+    size_t i = 0;
+    for (const auto &path : d->optionsOrder_) {
+        d->options_[path]->marshall(oldValues[i++]);
+    }
+    loader();
+    std::vector<std::string> changed;
+    i = 0;
+    for (const auto &path : d->optionsOrder_) {
+        RawConfig newValue;
+        d->options_[path]->marshall(newValue);
+        if (newValue != oldValues[i++]) {
+            changed.push_back(path);
+        }
+    }
+    return changed;
+}
+
 void Configuration::save(RawConfig &config) const {
     FCITX_D();
     for (const auto &path : d->optionsOrder_) {
@@ -119,6 +148,27 @@ void Configuration::save(RawConfig &config) const {
     }
 }
 
+OptionBase *Configuration::findOption(const std::string &path) const {
+    FCITX_D();
+    auto iter = d->options_.find(path);
+    return iter != d->options_.end() ? iter->second : nullptr;
+}
+
+std::vector<std::string> Configuration::optionPaths() const {
+    FCITX_D();
+    return {d->optionsOrder_.begin(), d->optionsOrder_.end()};
+}
+
+const std::string &Configuration::sourceStamp() const {
+    FCITX_D();
+    return d->sourceStamp_;
+}
+
+void Configuration::setSourceStamp(std::string stamp) {
+    FCITX_D();
+    d->sourceStamp_ = std::move(stamp);
+}
+
 void Configuration::addOption(OptionBase *option) {
     FCITX_D();
     if (d->options_.count(option->path())) {
@@ -23,7 +23,10 @@
 #include <fcitx-config/option.h>
 #include <fcitx-utils/macros.h>
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 #define FCITX_CONFIGURATION(NAME, ...)                                         \
     class NAME;                                                                \
@@ -56,9 +59,17 @@
 namespace fcitx {
 
 class ConfigurationPrivate;
+class Configuration;
+
+FCITXCONFIG_EXPORT std::vector<std::string>
+reloadAsIni(Configuration &configuration, const std::string &path);
+FCITXCONFIG_EXPORT void readFromIni(Configuration &configuration, int fd);
 
 class FCITXCONFIG_EXPORT Configuration {
     friend class OptionBase;
+    friend std::vector<std::string> reloadAsIni(Configuration &,
+                                                const std::string &);
+    friend void readFromIni(Configuration &, int);
 
 public:
     Configuration();
@@ -67,6 +78,9 @@ public:
     /// Load configuration from RawConfig. If partial is true, non-exist option
     /// will be reset to default value, otherwise it will be untouched.
     void load(const RawConfig &config, bool partial = false);
+    /// Load configuration from RawConfig like load(config), and return the
+    /// paths of the options whose value is changed by it.
+    std::vector<std::string> reload(const RawConfig &config);
     void save(RawConfig &config) const;
     void dumpDescription(RawConfig &config) const;
     virtual const char *typeName() const = 0;
@@ -77,6 +91,11 @@ protected:
 
 private:
     void addOption(fcitx::OptionBase *option);
+    OptionBase *findOption(const std::string &path) const;
+    std::vector<std::string> optionPaths() const;
+    std::vector<std::string> reloadWith(const std::function<void()> &loader);
+    const std::string &sourceStamp() const;
+    void setSourceStamp(std::string stamp);
 
     FCITX_DECLARE_PRIVATE(Configuration);
     std::unique_ptr<ConfigurationPrivate> d_ptr;
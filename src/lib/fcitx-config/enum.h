@@ -41,17 +41,21 @@
         config =                                                               \
             _##TYPE##_Names[static_cast<std::underlying_type_t<TYPE>>(value)]; \
     }                                                                          \
-    static inline bool unmarshallOption(                                       \
-        TYPE &value, const fcitx::RawConfig &config, bool) {                   \
+    static inline bool unmarshallOption(TYPE &value,                           \
+                                        const std::string &str) {              \
         auto size = FCITX_ARRAY_SIZE(_##TYPE##_Names);                         \
         for (decltype(size) i = 0; i < size; i++) {                            \
-            if (config.value() == _##TYPE##_Names[i]) {                        \
+            if (str == _##TYPE##_Names[i]) {                                   \
                 value = static_cast<TYPE>(i);                                  \
                 return true;                                                   \
             }                                                                  \
         }                                                                      \
         return false;                                                          \
     }                                                                          \
+    static inline bool unmarshallOption(                                       \
+        TYPE &value, const fcitx::RawConfig &config, bool) {                   \
+        return unmarshallOption(value, config.value());                        \
+    }                                                                          \
     _FCITX_UNUSED_                                                             \
     static void dumpDescriptionHelper(fcitx::RawConfig &config, TYPE *) {      \
         auto size = FCITX_ARRAY_SIZE(_##TYPE##_Names);                         \
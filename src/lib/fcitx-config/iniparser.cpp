@@ -20,70 +20,217 @@
 #include "config.h"
 
 #include "configuration.h"
+#include "fcitx-utils/charutils.h"
+#include "fcitx-utils/fs.h"
 #include "fcitx-utils/standardpath.h"
 #include "fcitx-utils/stringutils.h"
 #include "fcitx-utils/unixfd.h"
 #include "iniparser.h"
 #include <cstdio>
+#include <cstring>
 #include <fcntl.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <unordered_set>
 
 namespace fcitx {
-enum class UnescapeState { NORMAL, ESCAPE };
 
-bool _unescape_string(std::string &str, bool unescapeQuote) {
-    if (str.empty()) {
+namespace {
+
+std::string_view trimView(std::string_view str) {
+    auto start = str.find_first_not_of(FCITX_WHITESPACE);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    auto end = str.size();
+    while (end > start && charutils::isspace(str[end - 1])) {
+        --end;
+    }
+    return str.substr(start, end - start);
+}
+
+bool unescapeValue(std::string_view str, bool unescapeQuote,
+                   std::string &result) {
+    result.clear();
+    // Most values have nothing to unescape.
+    if (str.find('\\') == std::string_view::npos) {
+        result.append(str.data(), str.size());
         return true;
     }
 
-    size_t i = 0;
-    size_t j = 0;
-    UnescapeState state = UnescapeState::NORMAL;
-    do {
-        switch (state) {
-        case UnescapeState::NORMAL:
-            if (str[i] == '\\') {
-                state = UnescapeState::ESCAPE;
+    bool escape = false;
+    for (auto c : str) {
+        if (!escape) {
+            if (c == '\\') {
+                escape = true;
             } else {
-                str[j] = str[i];
-                j++;
+                result.push_back(c);
             }
-            break;
-        case UnescapeState::ESCAPE:
-            if (str[i] == '\\') {
-                str[j] = '\\';
-                j++;
-            } else if (str[i] == 'n') {
-                str[j] = '\n';
-                j++;
-            } else if (str[i] == '\"' && unescapeQuote) {
-                str[j] = '\"';
-                j++;
-            } else {
-                return false;
+            continue;
+        }
+        if (c == '\\') {
+            result.push_back('\\');
+        } else if (c == 'n') {
+            result.push_back('\n');
+        } else if (c == '\"' && unescapeQuote) {
+            result.push_back('\"');
+        } else {
+            return false;
+        }
+        escape = false;
+    }
+    return !escape;
+}
+
+// Parse the whole file from a single buffer, lines are only views into it.
+// groupCallback(line, group) is called for every group header, and
+// valueCallback(line, name, value) for every key in the current group.
+template <typename GroupCallback, typename ValueCallback>
+void parseIniBuffer(std::string_view buffer, GroupCallback groupCallback,
+                    ValueCallback valueCallback) {
+    std::string value;
+    unsigned int line = 0;
+    for (size_t pos = 0; pos < buffer.size();) {
+        auto lineEnd = buffer.find('\n', pos);
+        if (lineEnd == std::string_view::npos) {
+            lineEnd = buffer.size();
+        }
+        auto lineBuf = buffer.substr(pos, lineEnd - pos);
+        pos = lineEnd + 1;
+        line++;
+        // A NUL ends the line, like it does for C strings.
+        lineBuf = trimView(lineBuf.substr(0, lineBuf.find('\0')));
+        if (lineBuf.empty() || lineBuf.front() == '#') {
+            continue;
+        }
+
+        std::string_view::size_type equalPos;
+
+        if (lineBuf.front() == '[' && lineBuf.back() == ']') {
+            groupCallback(line, lineBuf.substr(1, lineBuf.size() - 2));
+        } else if ((equalPos = lineBuf.find('=')) != std::string::npos) {
+            auto name = lineBuf.substr(0, equalPos);
+            auto rawValue = lineBuf.substr(equalPos + 1);
+
+            bool unescapeQuote = false;
+            // having quote at beginning and end, escape
+            if (rawValue.size() >= 2 && rawValue.front() == '"' &&
+                rawValue.back() == '"') {
+                rawValue = rawValue.substr(1, rawValue.size() - 2);
+                unescapeQuote = true;
+            }
+
+            if (!unescapeValue(rawValue, unescapeQuote, value)) {
+                continue;
             }
-            state = UnescapeState::NORMAL;
-            break;
+
+            valueCallback(line, name, value);
         }
-    } while (str[i++]);
-    str.resize(j - 1);
-    return true;
+    }
+}
+
+void readFromIniBuffer(RawConfig &config, std::string_view buffer) {
+    std::string currentGroup;
+    // Keys are added to the current group directly instead of looking up
+    // the group path again for every key.
+    RawConfigPtr groupConfig;
+    RawConfig *group = &config;
+    parseIniBuffer(
+        buffer,
+        [&](unsigned int line, std::string_view name) {
+            currentGroup.assign(name.data(), name.size());
+            config.visitItemsOnPath(
+                [line](RawConfig &config, const std::string &) {
+                    if (!config.lineNumber()) {
+                        config.setLineNumber(line);
+                    }
+                },
+                currentGroup);
+            if (currentGroup.empty()) {
+                groupConfig.reset();
+                group = &config;
+            } else {
+                groupConfig = config.get(currentGroup, true);
+                group = groupConfig.get();
+            }
+        },
+        [&group](unsigned int line, std::string_view name,
+                 const std::string &value) {
+            auto subConfig =
+                group->get(std::string(name.data(), name.size()), true);
+            subConfig->setValue(value);
+            subConfig->setLineNumber(line);
+        });
+}
+
+std::string readFileBuffer(int fd) {
+    std::string buffer;
+    if (fd < 0) {
+        return buffer;
+    }
+    struct stat stat;
+    if (fstat(fd, &stat) == 0 && S_ISREG(stat.st_mode)) {
+        buffer.reserve(stat.st_size);
+    }
+    char chunk[4096];
+    ssize_t bytes;
+    while ((bytes = fs::safeRead(fd, chunk, sizeof(chunk))) > 0) {
+        buffer.append(chunk, bytes);
+    }
+    return buffer;
 }
 
+} // namespace
+
 typedef std::unique_ptr<FILE, decltype(&fclose)> ScopedFILE;
 
 void readFromIni(RawConfig &config, int fd) {
     if (fd < 0) {
         return;
     }
-    // dup it
-    UnixFD unixFD(fd);
-    FILE *f = fdopen(unixFD.fd(), "rb");
-    if (!f) {
-        return;
+    readFromIniBuffer(config, readFileBuffer(fd));
+}
+
+void readFromIni(Configuration &configuration, int fd) {
+    auto buffer = readFileBuffer(fd);
+    // Options holding a single value are parsed from the buffer in place,
+    // only the keys of other options need to be put into RawConfig.
+    RawConfig config;
+    std::unordered_set<OptionBase *> loaded;
+    std::string currentGroup, path;
+    parseIniBuffer(
+        buffer,
+        [&currentGroup](unsigned int, std::string_view name) {
+            currentGroup.assign(name.data(), name.size());
+        },
+        [&](unsigned int, std::string_view name, const std::string &value) {
+            path = currentGroup;
+            if (!path.empty()) {
+                path.push_back('/');
+            }
+            path.append(name.data(), name.size());
+            auto *option = configuration.findOption(path);
+            if (!option || !option->isValueOption()) {
+                config.setValueByPath(path, value);
+                return;
+            }
+            if (!option->unmarshallValue(value)) {
+                option->reset();
+            }
+            loaded.insert(option);
+        });
+
+    configuration.setSourceStamp({});
+    for (const auto &path : configuration.optionPaths()) {
+        auto *option = configuration.findOption(path);
+        if (loaded.count(option)) {
+            continue;
+        }
+        auto subConfigPtr = config.get(path);
+        if (!subConfigPtr || !option->unmarshall(*subConfigPtr, false)) {
+            option->reset();
+        }
     }
-    ScopedFILE fp{f, fclose};
-    unixFD.release();
-    readFromIni(config, fp.get());
 }
 
 bool writeAsIni(const RawConfig &config, int fd) {
@@ -101,69 +248,13 @@ bool writeAsIni(const RawConfig &config, int fd) {
 }
 
 void readFromIni(RawConfig &config, FILE *fin) {
-    std::string lineBuf, currentGroup;
-
-    char *clineBuf = nullptr;
-    size_t bufSize = 0;
-    unsigned int line = 0;
-    while (getline(&clineBuf, &bufSize, fin) >= 0) {
-        line++;
-        lineBuf = clineBuf;
-        auto pair = stringutils::trimInplace(lineBuf);
-        std::string::size_type start = pair.first, end = pair.second;
-        if (start == end || lineBuf[start] == '#') {
-            continue;
-        }
-
-        lineBuf.resize(end);
-
-        std::string::size_type equalPos;
-
-        if (lineBuf[start] == '[' && lineBuf[end - 1] == ']') {
-            currentGroup = lineBuf.substr(start + 1, end - start - 2);
-            config.visitItemsOnPath(
-                [line](RawConfig &config, const std::string &) {
-                    if (!config.lineNumber()) {
-                        config.setLineNumber(line);
-                    }
-                },
-                currentGroup);
-        } else if ((equalPos = lineBuf.find_first_of('=', start)) !=
-                   std::string::npos) {
-            auto name = lineBuf.substr(start, equalPos - start);
-            auto valueStart = equalPos + 1;
-            auto valueEnd = lineBuf.size();
-
-            bool unescapeQuote = false;
-            ;
-            // having quote at beginning and end, escape
-            if (valueEnd - valueStart >= 2 && lineBuf[valueStart] == '"' &&
-                lineBuf[valueEnd - 1] == '"') {
-                lineBuf.resize(valueEnd - 1);
-                valueStart++;
-                unescapeQuote = true;
-            }
-
-            auto value = lineBuf.substr(valueStart);
-            if (!_unescape_string(value, unescapeQuote)) {
-                continue;
-            }
-
-            RawConfigPtr subConfig;
-            if (!currentGroup.empty()) {
-                std::string s = currentGroup;
-                s += "/";
-                s += name;
-                subConfig = config.get(s, true);
-            } else {
-                subConfig = config.get(name, true);
-            }
-            subConfig->setValue(value);
-            subConfig->setLineNumber(line);
-        }
+    std::string buffer;
+    char chunk[4096];
+    size_t bytes;
+    while ((bytes = fread(chunk, 1, sizeof(chunk), fin)) > 0) {
+        buffer.append(chunk, bytes);
     }
-
-    free(clineBuf);
+    readFromIniBuffer(config, buffer);
 }
 
 bool writeAsIni(const RawConfig &root, FILE *fout) {
@@ -236,10 +327,40 @@ void readAsIni(RawConfig &rawConfig, const std::string &path) {
 }
 
 void readAsIni(Configuration &configuration, const std::string &path) {
-    RawConfig config;
-    readAsIni(config, path);
+    auto &standardPath = StandardPath::global();
+    auto file =
+        standardPath.open(StandardPath::Type::PkgConfig, path, O_RDONLY);
+    readFromIni(configuration, file.fd());
+}
 
-    configuration.load(config);
+std::vector<std::string> reloadAsIni(Configuration &configuration,
+                                     const std::string &path) {
+    auto &standardPath = StandardPath::global();
+    auto file =
+        standardPath.open(StandardPath::Type::PkgConfig, path, O_RDONLY);
+    struct stat stat;
+    if (file.fd() < 0 || fstat(file.fd(), &stat) != 0) {
+        memset(&stat, 0, sizeof(stat));
+    }
+    auto stamp = stringutils::concat(
+        file.path(), ":", stat.st_dev, ":", stat.st_ino, ":",
+        stat.st_mtim.tv_sec, ".", stat.st_mtim.tv_nsec, ":", stat.st_size);
+    if (stamp == configuration.sourceStamp()) {
+        return {};
+    }
+
+    std::vector<std::string> changed;
+    if (configuration.sourceStamp().empty()) {
+        // Not read by us before, callers may not have applied any option.
+        readFromIni(configuration, file.fd());
+        changed = configuration.optionPaths();
+    } else {
+        changed = configuration.reloadWith([&configuration, &file]() {
+            readFromIni(configuration, file.fd());
+        });
+    }
+    configuration.setSourceStamp(std::move(stamp));
+    return changed;
 }
 
 bool safeSaveAsIni(const RawConfig &config, const std::string &path) {
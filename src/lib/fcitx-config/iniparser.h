@@ -21,15 +21,27 @@
 
 #include "fcitxconfig_export.h"
 #include <fcitx-config/rawconfig.h>
+#include <string>
+#include <vector>
 
 namespace fcitx {
 class Configuration;
 FCITXCONFIG_EXPORT void readFromIni(RawConfig &config, int fd);
 FCITXCONFIG_EXPORT bool writeAsIni(const RawConfig &config, int fd);
 FCITXCONFIG_EXPORT void readFromIni(RawConfig &config, FILE *fin);
+/// Load configuration from INI file like Configuration::load, options that
+/// hold a single value are parsed from the file directly.
+FCITXCONFIG_EXPORT void readFromIni(Configuration &configuration, int fd);
 FCITXCONFIG_EXPORT bool writeAsIni(const RawConfig &config, FILE *fout);
 FCITXCONFIG_EXPORT void readAsIni(Configuration &, const std::string &name);
 FCITXCONFIG_EXPORT void readAsIni(RawConfig &, const std::string &name);
+/// Read configuration like readAsIni, unless the file is the same one that
+/// is last read into it by this function. Return the paths of the options
+/// whose value changed, so callers can skip updating anything else. All
+/// options are returned if configuration is not read by this function
+/// before, or loaded by other means since.
+FCITXCONFIG_EXPORT std::vector<std::string>
+reloadAsIni(Configuration &configuration, const std::string &name);
 FCITXCONFIG_EXPORT bool safeSaveAsIni(const Configuration &,
                                       const std::string &name);
 FCITXCONFIG_EXPORT bool safeSaveAsIni(const RawConfig &,
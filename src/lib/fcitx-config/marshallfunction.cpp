@@ -27,8 +27,12 @@ void marshallOption(RawConfig &config, const bool value) {
 }
 
 bool unmarshallOption(bool &value, const RawConfig &config, bool) {
-    if (config.value() == "True" || config.value() == "False") {
-        value = config.value() == "True";
+    return unmarshallOption(value, config.value());
+}
+
+bool unmarshallOption(bool &value, const std::string &str) {
+    if (str == "True" || str == "False") {
+        value = str == "True";
         return true;
     }
 
@@ -39,8 +43,12 @@ void marshallOption(RawConfig &config, const int value) {
 }
 
 bool unmarshallOption(int &value, const RawConfig &config, bool) {
+    return unmarshallOption(value, config.value());
+}
+
+bool unmarshallOption(int &value, const std::string &str) {
     try {
-        value = std::stoi(config.value());
+        value = std::stoi(str);
     } catch (const std::exception &) {
         return false;
     }
@@ -53,7 +61,11 @@ void marshallOption(RawConfig &config, const std::string &value) {
 }
 
 bool unmarshallOption(std::string &value, const RawConfig &config, bool) {
-    value = config.value();
+    return unmarshallOption(value, config.value());
+}
+
+bool unmarshallOption(std::string &value, const std::string &str) {
+    value = str;
     return true;
 }
 
@@ -62,7 +74,11 @@ void marshallOption(RawConfig &config, const Key &value) {
 }
 
 bool unmarshallOption(Key &value, const RawConfig &config, bool) {
-    value = Key(config.value());
+    return unmarshallOption(value, config.value());
+}
+
+bool unmarshallOption(Key &value, const std::string &str) {
+    value = Key(str);
     return true;
 }
 
@@ -71,8 +87,12 @@ void marshallOption(RawConfig &config, const Color &value) {
 }
 
 bool unmarshallOption(Color &value, const RawConfig &config, bool) {
+    return unmarshallOption(value, config.value());
+}
+
+bool unmarshallOption(Color &value, const std::string &str) {
     try {
-        value = Color(config.value());
+        value = Color(str);
     } catch (const ColorParseException &) {
         return false;
     }
@@ -30,26 +30,35 @@ namespace fcitx {
 
 class Configuration;
 
+// Types that are stored as a single value also provide unmarshallOption from
+// the value string, so they can be loaded without building RawConfig.
+
 FCITXCONFIG_EXPORT void marshallOption(RawConfig &config, const bool value);
 FCITXCONFIG_EXPORT bool unmarshallOption(bool &value, const RawConfig &config,
                                          bool partial);
+FCITXCONFIG_EXPORT bool unmarshallOption(bool &value, const std::string &str);
 
 FCITXCONFIG_EXPORT void marshallOption(RawConfig &config, const int value);
 FCITXCONFIG_EXPORT bool unmarshallOption(int &value, const RawConfig &config,
                                          bool partial);
+FCITXCONFIG_EXPORT bool unmarshallOption(int &value, const std::string &str);
 
 FCITXCONFIG_EXPORT void marshallOption(RawConfig &config,
                                        const std::string &value);
 FCITXCONFIG_EXPORT bool unmarshallOption(std::string &value,
                                          const RawConfig &config, bool partial);
+FCITXCONFIG_EXPORT bool unmarshallOption(std::string &value,
+                                         const std::string &str);
 
 FCITXCONFIG_EXPORT void marshallOption(RawConfig &config, const Key &value);
 FCITXCONFIG_EXPORT bool unmarshallOption(Key &value, const RawConfig &config,
                                          bool partial);
+FCITXCONFIG_EXPORT bool unmarshallOption(Key &value, const std::string &str);
 
 FCITXCONFIG_EXPORT void marshallOption(RawConfig &config, const Color &value);
 FCITXCONFIG_EXPORT bool unmarshallOption(Color &value, const RawConfig &config,
                                          bool partial);
+FCITXCONFIG_EXPORT bool unmarshallOption(Color &value, const std::string &str);
 
 FCITXCONFIG_EXPORT void marshallOption(RawConfig &config,
                                        const I18NString &value);
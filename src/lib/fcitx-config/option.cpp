@@ -38,6 +38,23 @@ OptionBase::~OptionBase() {}
 
 bool OptionBase::isDefault() const { return false; }
 
+bool OptionBase::isValueOption() const {
+    return valueUnmarshaller_ != nullptr;
+}
+
+bool OptionBase::unmarshallValue(const std::string &value) {
+    if (valueUnmarshaller_) {
+        return valueUnmarshaller_(*this, value);
+    }
+    RawConfig config;
+    config.setValue(value);
+    return unmarshall(config, false);
+}
+
+void OptionBase::setValueUnmarshaller(ValueUnmarshaller unmarshaller) {
+    valueUnmarshaller_ = unmarshaller;
+}
+
 const std::string &OptionBase::path() const { return path_; }
 
 const std::string &OptionBase::description() const { return description_; }
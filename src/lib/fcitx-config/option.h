@@ -61,10 +61,23 @@ public:
     virtual bool skipSave() const = 0;
     virtual void dumpDescription(RawConfig &config) const;
 
+    /// Whether the option is stored as a single value without sub items,
+    /// which can be loaded by unmarshallValue.
+    bool isValueOption() const;
+    /// Same as unmarshall with a RawConfig that only holds value.
+    bool unmarshallValue(const std::string &value);
+
+protected:
+    typedef bool (*ValueUnmarshaller)(OptionBase &option,
+                                      const std::string &value);
+    /// Set by options that can parse a single value without RawConfig.
+    void setValueUnmarshaller(ValueUnmarshaller unmarshaller);
+
 private:
     Configuration *parent_;
     std::string path_;
     std::string description_;
+    ValueUnmarshaller valueUnmarshaller_ = nullptr;
 };
 
 class FCITXCONFIG_EXPORT ExternalOption : public OptionBase {
@@ -216,6 +229,15 @@ struct RemoveVector<std::vector<T>> {
     typedef typename RemoveVector<T>::type type;
 };
 
+template <typename T, typename = void>
+struct HasValueUnmarshaller : std::false_type {};
+
+template <typename T>
+struct HasValueUnmarshaller<
+    T, std::void_t<decltype(unmarshallOption(
+           std::declval<T &>(), std::declval<const std::string &>()))>>
+    : std::true_type {};
+
 template <typename T, typename = void>
 struct ExtractSubConfig {
     static std::unique_ptr<Configuration> get() { return nullptr; }
@@ -292,6 +314,9 @@ public:
             throw std::invalid_argument(
                 "defaultValue doesn't satisfy constrain");
         }
+        if constexpr (isValueType) {
+            setValueUnmarshaller(&Option::unmarshallValueImpl);
+        }
     }
 
     std::string typeString() const override { return OptionTypeName<T>::get(); }
@@ -374,6 +399,20 @@ public:
     bool skipSave() const override { return annotation_.skipSave(); }
 
 private:
+    // Custom marshaller may store the value differently.
+    static constexpr bool isValueType =
+        std::is_same<Marshaller, DefaultMarshaller<T>>::value &&
+        HasValueUnmarshaller<T>::value;
+
+    static bool unmarshallValueImpl(OptionBase &option,
+                                    const std::string &value) {
+        T tempValue{};
+        if (!unmarshallOption(tempValue, value)) {
+            return false;
+        }
+        return static_cast<Option &>(option).setValue(tempValue);
+    }
+
     T defaultValue_;
     T value_;
     Marshaller marshaller_;
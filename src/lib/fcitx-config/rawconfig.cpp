@@ -18,227 +18,128 @@
 //
 #include "rawconfig.h"
 #include "fcitx-utils/stringutils.h"
-#include <list>
-#include <unordered_map>
+#include <string_view>
 
 namespace fcitx {
 
-template <typename K, typename V, class Hash = std::hash<K>,
-          class Pred = std::equal_to<K>>
-class OrderedMap {
-private:
-    std::list<std::pair<const K, V>> order_;
-    std::unordered_map<K, typename decltype(order_)::iterator, Hash, Pred> map_;
-
+class RawConfigPrivate {
 public:
-    typedef decltype(map_) map_type;
-    typedef decltype(order_) list_type;
-    typedef typename map_type::key_type key_type;
-    typedef typename list_type::value_type value_type;
-    typedef typename value_type::second_type mapped_type;
-
-    typedef typename list_type::pointer pointer;
-    typedef typename list_type::const_pointer const_pointer;
-    typedef typename list_type::reference reference;
-    typedef typename list_type::const_reference const_reference;
-    typedef typename list_type::iterator iterator;
-    typedef typename list_type::const_iterator const_iterator;
-    typedef typename list_type::size_type size_type;
-    typedef typename list_type::difference_type difference_type;
-
-    OrderedMap() = default;
-    OrderedMap(const OrderedMap &other) : order_(other.order_) { fillMap(); }
-
-    /// Move constructor.
-    OrderedMap(OrderedMap &&other) { operator=(std::move(other)); }
-
-    OrderedMap(std::initializer_list<value_type> l) : order_(l) { fillMap(); }
-
-    template <typename InputIterator>
-    OrderedMap(InputIterator first, InputIterator last) : order_(first, last) {
-        fillMap();
-    }
-
-    /// Copy assignment operator.
-    OrderedMap &operator=(const OrderedMap &other) {
-        order_ = list_type(other.order_.begin(), other.order_.end());
-        fillMap();
-        return *this;
+    RawConfigPrivate(std::string _name)
+        : name_(std::move(_name)), lineNumber_(0) {}
+    RawConfigPrivate(const RawConfigPrivate &other)
+        : name_(other.name_), value_(other.value_), comment_(other.comment_),
+          lineNumber_(other.lineNumber_) {
+        copySubItems(other);
     }
 
-    /// Move assignment operator.
-    OrderedMap &operator=(OrderedMap &&other) {
-        using std::swap;
-        swap(order_, other.order_);
-        swap(map_, other.map_);
-        other.order_.clear();
-        other.map_.clear();
+    RawConfigPrivate &operator=(const RawConfigPrivate &other) {
+        name_ = other.name_;
+        value_ = other.value_;
+        comment_ = other.comment_;
+        lineNumber_ = other.lineNumber_;
+        copySubItems(other);
         return *this;
     }
 
-    bool empty() const noexcept { return order_.empty(); }
-
-    size_type size() const noexcept { return order_.size(); }
-
-    iterator begin() noexcept { return order_.begin(); }
-
-    const_iterator begin() const noexcept { return order_.begin(); }
-
-    const_iterator cbegin() const noexcept { return order_.begin(); }
-
-    iterator end() noexcept { return order_.end(); }
-
-    const_iterator end() const noexcept { return order_.end(); }
-
-    const_iterator cend() const noexcept { return order_.end(); }
-
-    template <typename... _Args>
-    std::pair<iterator, bool> emplace(_Args &&... __args) {
-        order_.emplace_back(std::forward<_Args>(__args)...);
-        auto iter = std::prev(order_.end());
-        auto mapResult = map_.emplace(iter->first, iter);
-        if (mapResult.second) {
-            return {iter, true};
-        } else {
-            order_.erase(iter);
-            iter = mapResult.first->second;
-            return {iter, false};
-        }
-    }
-
-    std::pair<iterator, bool> insert(const value_type &v) { return emplace(v); }
-
-    iterator erase(const_iterator position) {
-        map_.erase(position->first);
-        return order_.erase(position);
-    }
-
-    iterator erase(iterator position) {
-        map_.erase(position->first);
-        return order_.erase(position);
-    }
-
-    size_type erase(const key_type &k) {
-        auto iter = map_.find(k);
-        if (iter != map_.end()) {
-            order_.erase(iter->second);
-            map_.erase(iter);
-            return 1;
-        }
-        return 0;
-    }
-
-    void clear() noexcept {
-        order_.clear();
-        map_.clear();
-    }
-
-    iterator find(const key_type &k) {
-        auto iter = map_.find(k);
-        if (iter != map_.end()) {
-            return iter->second;
-        }
-        return order_.end();
-    }
-
-    const_iterator find(const key_type &k) const {
-        auto iter = map_.find(k);
-        if (iter != map_.end()) {
-            return iter->second;
+    void copySubItems(const RawConfigPrivate &other) {
+        for (const auto &item : other.subItems_) {
+            auto copy = std::make_shared<RawConfig>(*item);
+            auto iter = lowerBound(item->name());
+            if (iter != index_.end() &&
+                subItems_[*iter]->name() == item->name()) {
+                subItems_[*iter] = std::move(copy);
+            } else {
+                index_.insert(iter, subItems_.size());
+                subItems_.push_back(std::move(copy));
+            }
         }
-        return order_.end();
     }
 
-    size_type count(const key_type &k) const { return map_.count(k); }
-
-    mapped_type &operator[](const key_type &k) {
-        auto iter = find(k);
-        if (iter != end()) {
-            return iter->second;
-        } else {
-            auto result = emplace(k, mapped_type());
-            return result.first->second;
-        }
+    std::vector<uint32_t>::const_iterator
+    lowerBound(std::string_view key) const {
+        return std::lower_bound(
+            index_.begin(), index_.end(), key,
+            [this](uint32_t index, std::string_view key) {
+                return std::string_view(subItems_[index]->name()) < key;
+            });
     }
 
-    mapped_type &operator[](key_type &&k) {
-        auto iter = find(k);
-        if (iter != end()) {
-            return iter->second;
-        } else {
-            auto result = emplace(std::move(k), value_type());
-            return result.first->second;
+    const std::shared_ptr<RawConfig> *findSubItem(std::string_view key) const {
+        auto iter = lowerBound(key);
+        if (iter == index_.end() || subItems_[*iter]->name() != key) {
+            return nullptr;
         }
+        return &subItems_[*iter];
     }
 
-private:
-    void fillMap() {
-        for (auto iter = order_.begin(), end = order_.end(); iter != end;
-             iter++) {
-            map_[iter->first] = iter;
+    bool eraseSubItem(std::string_view key) {
+        auto iter = lowerBound(key);
+        if (iter == index_.end() || subItems_[*iter]->name() != key) {
+            return false;
         }
-    }
-};
-
-class RawConfigPrivate {
-public:
-    RawConfigPrivate(std::string _name) : name_(_name), lineNumber_(0) {}
-    RawConfigPrivate(const RawConfigPrivate &other)
-        : name_(other.name_), value_(other.value_), comment_(other.comment_),
-          lineNumber_(other.lineNumber_) {
-        for (const auto &item : other.subItems_) {
-            subItems_[item.first] = std::make_shared<RawConfig>(*item.second);
+        auto pos = *iter;
+        index_.erase(iter);
+        for (auto &index : index_) {
+            if (index > pos) {
+                index--;
+            }
         }
+        subItems_[pos]->d_func()->parent_ = nullptr;
+        subItems_.erase(subItems_.begin() + pos);
+        return true;
     }
 
-    RawConfigPrivate &operator=(const RawConfigPrivate &other) {
-        name_ = other.name_;
-        value_ = other.value_;
-        comment_ = other.comment_;
-        lineNumber_ = other.lineNumber_;
-        for (const auto &item : other.subItems_) {
-            subItems_[item.first] = std::make_shared<RawConfig>(*item.second);
+    void clearSubItems() {
+        for (const auto &item : subItems_) {
+            item->d_func()->parent_ = nullptr;
         }
-        return *this;
+        subItems_.clear();
+        index_.clear();
     }
 
-    std::shared_ptr<RawConfig> getNonexistentRawConfig(RawConfig *q,
-                                                       const std::string &key) {
-        auto result = subItems_[key] = std::make_shared<RawConfig>(key);
+    const std::shared_ptr<RawConfig> *
+    getNonexistentRawConfig(RawConfig *q, std::string_view key) {
+        index_.insert(lowerBound(key), subItems_.size());
+        auto &result = subItems_.emplace_back(
+            std::make_shared<RawConfig>(std::string(key)));
         result->d_func()->parent_ = q;
-        return result;
+        return &result;
     }
 
-    std::shared_ptr<const RawConfig>
-    getNonexistentRawConfig(const RawConfig *, const std::string &) const {
+    const std::shared_ptr<RawConfig> *
+    getNonexistentRawConfig(const RawConfig *, std::string_view) const {
         return nullptr;
     }
 
     template <typename T, typename U>
-    static std::shared_ptr<T> getRawConfigHelper(T &that, std::string path,
-                                                 U callback) {
+    static std::shared_ptr<T>
+    getRawConfigHelper(T &that, const std::string &path, U callback) {
         auto cur = &that;
-        std::shared_ptr<T> result;
+        const std::shared_ptr<RawConfig> *result = nullptr;
+        std::string_view pathView(path);
         for (std::string::size_type pos = 0, new_pos = path.find('/', pos);
              pos != std::string::npos && cur;
              pos = ((std::string::npos == new_pos) ? new_pos : (new_pos + 1)),
                                     new_pos = path.find('/', pos)) {
-            auto key = path.substr(pos, (std::string::npos == new_pos)
-                                            ? new_pos
-                                            : (new_pos - pos));
-            auto iter = cur->d_func()->subItems_.find(key);
-            if (iter == cur->d_func()->subItems_.end()) {
+            auto key = pathView.substr(pos, (std::string::npos == new_pos)
+                                                ? new_pos
+                                                : (new_pos - pos));
+            result = cur->d_func()->findSubItem(key);
+            if (!result) {
                 result = cur->d_func()->getNonexistentRawConfig(cur, key);
-            } else {
-                result = iter->second;
             }
-            cur = result.get();
+            cur = result ? result->get() : nullptr;
 
-            if (cur) {
-                callback(*cur, path.substr(0, new_pos));
+            if constexpr (!std::is_same<U, std::nullptr_t>::value) {
+                if (cur) {
+                    callback(*cur, path.substr(0, new_pos));
+                }
             }
         }
-        return result;
+        if (!result) {
+            return nullptr;
+        }
+        return *result;
     }
 
     template <typename T>
@@ -247,8 +148,10 @@ public:
                 std::function<bool(T &, const std::string &path)> callback,
                 bool recursive, const std::string &pathPrefix) {
         auto d = that.d_func();
-        for (const auto pair : d->subItems_) {
-            std::shared_ptr<T> item = pair.second;
+        // Callback may add or remove items, so hold a reference and do not
+        // use iterators.
+        for (size_t i = 0; i < d->subItems_.size(); i++) {
+            std::shared_ptr<T> item = d->subItems_[i];
             auto newPathPrefix = pathPrefix.empty()
                                      ? item->name()
                                      : pathPrefix + "/" + item->name();
@@ -268,7 +171,11 @@ public:
     std::string name_;
     std::string value_;
     std::string comment_;
-    OrderedMap<std::string, std::shared_ptr<RawConfig>> subItems_;
+    // Sub items in insertion order, index_ holds their positions sorted by
+    // name for lookup. Configs are small, so this is cheaper than a list
+    // plus a hash map.
+    std::vector<std::shared_ptr<RawConfig>> subItems_;
+    std::vector<uint32_t> index_;
     unsigned int lineNumber_;
 };
 
@@ -279,8 +186,9 @@ RawConfig::RawConfig(std::string name, std::string value)
 
 RawConfig::~RawConfig() {
     FCITX_D();
-    for (const auto pair : d->subItems_) {
-        pair.second->d_func()->parent_ = nullptr;
+    // d_ptr is null if this config is moved from.
+    if (d) {
+        d->clearSubItems();
     }
 }
 
@@ -288,19 +196,17 @@ FCITX_DEFINE_DPTR_COPY_AND_DEFAULT_MOVE(RawConfig)
 
 std::shared_ptr<RawConfig> RawConfig::get(const std::string &path,
                                           bool create) {
-    auto dummy = [](const RawConfig &, const std::string &) {};
     if (create) {
-        return RawConfigPrivate::getRawConfigHelper(*this, path, dummy);
+        return RawConfigPrivate::getRawConfigHelper(*this, path, nullptr);
     } else {
         return std::const_pointer_cast<RawConfig>(
             RawConfigPrivate::getRawConfigHelper<const RawConfig>(*this, path,
-                                                                  dummy));
+                                                                  nullptr));
     }
 }
 
 std::shared_ptr<const RawConfig> RawConfig::get(const std::string &path) const {
-    auto dummy = [](const RawConfig &, const std::string &) {};
-    return RawConfigPrivate::getRawConfigHelper(*this, path, dummy);
+    return RawConfigPrivate::getRawConfigHelper(*this, path, nullptr);
 }
 
 bool RawConfig::remove(const std::string &path) {
@@ -310,25 +216,31 @@ bool RawConfig::remove(const std::string &path) {
         return false;
     }
 
+    std::shared_ptr<RawConfig> parent;
     if (pos != std::string::npos) {
-        root = get(path.substr(0, pos)).get();
+        parent = get(path.substr(0, pos));
+        root = parent.get();
+        if (!root) {
+            return false;
+        }
     }
-    return root->d_func()->subItems_.erase(path.substr(pos + 1)) > 0;
+    return root->d_func()->eraseSubItem(
+        std::string_view(path).substr(pos + 1));
 }
 
 void RawConfig::removeAll() {
     FCITX_D();
-    d->subItems_.clear();
+    d->clearSubItems();
 }
 
 void RawConfig::setValue(std::string value) {
     FCITX_D();
-    d->value_ = value;
+    d->value_ = std::move(value);
 }
 
 void RawConfig::setComment(std::string comment) {
     FCITX_D();
-    d->comment_ = comment;
+    d->comment_ = std::move(comment);
 }
 
 void RawConfig::setLineNumber(unsigned int lineNumber) {
@@ -370,8 +282,8 @@ std::vector<std::string> RawConfig::subItems() const {
     FCITX_D();
     std::vector<std::string> result;
     result.reserve(d->subItems_.size());
-    for (auto &pair : d->subItems_) {
-        result.push_back(pair.first);
+    for (const auto &item : d->subItems_) {
+        result.push_back(item->name());
     }
     return result;
 }
@@ -386,9 +298,13 @@ std::shared_ptr<RawConfig> RawConfig::detach() {
     if (!d->parent_) {
         return {};
     }
-    auto ref = d->parent_->get(d->name_);
-    d->parent_->d_func()->subItems_.erase(d->name_);
-    d->parent_ = nullptr;
+    auto parent = d->parent_->d_func();
+    auto item = parent->findSubItem(d->name_);
+    if (!item) {
+        return {};
+    }
+    auto ref = *item;
+    parent->eraseSubItem(d->name_);
     return ref;
 }
 
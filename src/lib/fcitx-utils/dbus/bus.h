@@ -23,6 +23,8 @@
 #include <fcitx-utils/dbus/message.h>
 #include <fcitx-utils/dbus/objectvtable.h>
 #include <fcitx-utils/event.h>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -43,6 +45,7 @@ enum class RequestNameFlag {
 };
 
 class BusPrivate;
+class ServerPrivate;
 
 class FCITXUTILS_EXPORT Bus {
 public:
@@ -84,9 +87,50 @@ public:
     void flush();
 
 private:
+    friend class ServerPrivate;
+    // Takes over a connection accepted by a Server.
+    Bus(ServerPrivate *server, void *connection);
+
     std::unique_ptr<BusPrivate> d_ptr;
     FCITX_DECLARE_PRIVATE(Bus);
 };
+
+typedef std::function<void(std::unique_ptr<Bus>)> NewConnectionCallback;
+
+/**
+ * A peer to peer DBus server listening on a unix socket.
+ *
+ * Every accepted connection is handed out as a Bus talking directly to the
+ * client, only clients of the same user are accepted. Each of them also
+ * answers a minimal set of org.freedesktop.DBus methods, so clients that
+ * expect a message bus at the address can use it as well.
+ */
+class FCITXUTILS_EXPORT Server {
+public:
+    Server(const std::string &path);
+    virtual ~Server();
+    Server(const Server &other) = delete;
+
+    bool isOpen() const;
+    std::string address() const;
+
+    void attachEventLoop(EventLoop *loop);
+    void detachEventLoop();
+
+    void setNewConnectionCallback(NewConnectionCallback callback);
+
+    /**
+     * Set the sender of signals sent to the peers.
+     *
+     * Message bus clients may only accept signals coming from the owner of a
+     * well known name, which is the name itself on a peer connection.
+     */
+    void setSenderName(const std::string &name);
+
+private:
+    std::unique_ptr<ServerPrivate> d_ptr;
+    FCITX_DECLARE_PRIVATE(Server);
+};
 } // namespace dbus
 } // namespace fcitx
 
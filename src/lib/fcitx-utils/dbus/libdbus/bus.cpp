@@ -17,14 +17,17 @@
 // see <http://www.gnu.org/licenses/>.
 //
 
-#include "../../charutils.h"
 #include "../../log.h"
 #include "../../stringutils.h"
+#include "../peerbus_p.h"
+#include "../utils_p.h"
 #include "bus_p.h"
 #include "config.h"
 #include "message_p.h"
 #include "objectvtable_p_libdbus.h"
+#include <algorithm>
 #include <unistd.h>
+#include <unordered_set>
 
 namespace fcitx {
 namespace dbus {
@@ -49,20 +52,8 @@ DBusHandlerResult DBusMessageCallback(DBusConnection *, DBusMessage *message,
 
         if (msg.type() == MessageType::Signal) {
             if (auto bus = ref.get()) {
-                for (auto &pair : bus->matchHandlers_.view()) {
-                    auto bus = ref.get();
-                    std::string alterName;
-                    if (bus && bus->nameCache_ &&
-                        !pair.first.service().empty()) {
-                        alterName =
-                            bus->nameCache_->owner(pair.first.service());
-                    }
-                    if (pair.first.check(msg, alterName)) {
-                        if (pair.second && pair.second(msg)) {
-                            return DBUS_HANDLER_RESULT_HANDLED;
-                        }
-                    }
-                    msg.rewind();
+                if (bus->dispatchSignal(msg)) {
+                    return DBUS_HANDLER_RESULT_HANDLED;
                 }
             }
         }
@@ -121,6 +112,120 @@ std::string DBusObjectVTableSlot::getXml() {
     return xml;
 }
 
+std::string BusPrivate::matchIndexKey(unsigned int shape,
+                                      const std::string &interface,
+                                      const std::string &member,
+                                      const std::string &path,
+                                      const std::string &arg0) {
+    // Shape goes first so different combinations never collide, '\n' can't
+    // appear in any of the fields except arg0, which is always the last one.
+    std::string key(1, static_cast<char>(shape));
+    if (shape & MatchIndexInterface) {
+        key += stringutils::concat("\n", interface);
+    }
+    if (shape & MatchIndexMember) {
+        key += stringutils::concat("\n", member);
+    }
+    if (shape & MatchIndexPath) {
+        key += stringutils::concat("\n", path);
+    }
+    if (shape & MatchIndexArg0) {
+        key += stringutils::concat("\n", arg0);
+    }
+    return key;
+}
+
+std::string BusPrivate::matchIndexKey(const MatchRule &rule) {
+    unsigned int shape = 0;
+    if (!rule.interface().empty()) {
+        shape |= MatchIndexInterface;
+    }
+    if (!rule.name().empty()) {
+        shape |= MatchIndexMember;
+    }
+    if (!rule.path().empty()) {
+        shape |= MatchIndexPath;
+    }
+    const auto &args = rule.argumentMatch();
+    if (!args.empty() && args[0] != MatchRule::nullArg) {
+        shape |= MatchIndexArg0;
+    }
+    return matchIndexKey(shape, rule.interface(), rule.name(), rule.path(),
+                         shape & MatchIndexArg0 ? args[0] : "");
+}
+
+bool BusPrivate::dispatchSignal(Message &message) {
+    const auto interface = message.interface();
+    const auto member = message.member();
+    const auto path = message.path();
+    std::string arg0;
+    bool needArg0 = false;
+    for (unsigned int shape = 0; shape < MatchIndexShapes; shape++) {
+        if ((shape & MatchIndexArg0) && matchIndexShapes_[shape]) {
+            needArg0 = true;
+            break;
+        }
+    }
+    bool hasArg0 = false;
+    if (needArg0 && stringutils::startsWith(message.signature(), 's')) {
+        hasArg0 = static_cast<bool>(message >> arg0);
+        message.rewind();
+    }
+
+    // Collect the handlers whose indexed fields match, the rest of the rule is
+    // checked afterwards.
+    std::vector<std::pair<uint64_t, std::weak_ptr<DBusMatchHandler>>>
+        candidates;
+    for (unsigned int shape = 0; shape < MatchIndexShapes; shape++) {
+        if (!matchIndexShapes_[shape] ||
+            ((shape & MatchIndexArg0) && !hasArg0)) {
+            continue;
+        }
+        auto key = matchIndexKey(shape, interface, member, path, arg0);
+        for (auto &handler : matchHandlers_.view(key)) {
+            candidates.emplace_back(handler->order_, handler);
+        }
+    }
+    if (candidates.empty()) {
+        return false;
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto &lhs, const auto &rhs) {
+                  return lhs.first < rhs.first;
+              });
+
+    // Resolve the well-known names owned by sender only once.
+    const auto sender = message.sender();
+    const std::unordered_set<std::string> *ownedNames = nullptr;
+    if (nameCache_) {
+        ownedNames = nameCache_->ownedNames(sender);
+    }
+    auto ref = watch();
+    for (auto &candidate : candidates) {
+        auto handler = candidate.second.lock();
+        if (!handler) {
+            continue;
+        }
+        const auto &service = handler->rule_.service();
+        const bool ownedBySender =
+            ownedNames && !service.empty() && ownedNames->count(service);
+        if (handler->rule_.check(message, ownedBySender ? sender : "")) {
+            if (handler->callback_ && handler->callback_(message)) {
+                return true;
+            }
+        }
+        message.rewind();
+        // Callback may destroy the bus.
+        if (!ref.isValid()) {
+            break;
+        }
+        if (nameCache_) {
+            ownedNames = nameCache_->ownedNames(sender);
+        }
+    }
+    return false;
+}
+
 DBusObjectVTableSlot *BusPrivate::findSlot(const std::string &path,
                                            const std::string interface) {
     // Check if interface exists.
@@ -246,24 +351,6 @@ bool BusPrivate::objectVTableCallback(Message &message) {
     return false;
 }
 
-std::string escapePath(const std::string &path) {
-    std::string newPath;
-    newPath.reserve(path.size() * 3);
-    for (auto c : path) {
-        if (charutils::islower(c) || charutils::isupper(c) ||
-            charutils::isdigit(c) || c == '_' || c == '-' || c == '/' ||
-            c == '.') {
-            newPath.push_back(c);
-        } else {
-            newPath.push_back('%');
-            newPath.push_back(charutils::toHex(c >> 4));
-            newPath.push_back(charutils::toHex(c & 0xf));
-        }
-    }
-
-    return newPath;
-}
-
 std::string sessionBusAddress() {
     auto e = getenv("DBUS_SESSION_BUS_ADDRESS");
     if (e) {
@@ -342,6 +429,20 @@ fail:
     d->conn_ = nullptr;
 }
 
+Bus::Bus(ServerPrivate *server, void *connection)
+    : d_ptr(std::make_unique<BusPrivate>(this)) {
+    FCITX_D();
+    d->peer_ = true;
+    d->address_ = server->address_;
+    d->conn_ = static_cast<DBusConnection *>(connection);
+    if (!dbus_connection_add_filter(d->conn_, DBusMessageCallback, d,
+                                    nullptr)) {
+        dbus_connection_close(d->conn_);
+        dbus_connection_unref(d->conn_);
+        d->conn_ = nullptr;
+    }
+}
+
 Bus::~Bus() {
     FCITX_D();
     if (d->attached_) {
@@ -374,11 +475,15 @@ Message Bus::createSignal(const char *path, const char *interface,
     if (!dmsg) {
         return {};
     }
+    if (!d->peerSender_.empty()) {
+        dbus_message_set_sender(dmsg, d->peerSender_.c_str());
+    }
     return MessagePrivate::fromDBusMessage(d->watch(), dmsg, true, false);
 }
 
+template <typename T>
 void DBusToggleWatch(DBusWatch *watch, void *data) {
-    auto bus = static_cast<BusPrivate *>(data);
+    auto bus = static_cast<T *>(data);
     auto iter = bus->ioWatchers_.find(watch);
     if (iter != bus->ioWatchers_.end()) {
         iter->second->setEnabled(dbus_watch_get_enabled(watch));
@@ -395,8 +500,9 @@ void DBusToggleWatch(DBusWatch *watch, void *data) {
     }
 }
 
+template <typename T>
 dbus_bool_t DBusAddWatch(DBusWatch *watch, void *data) {
-    auto bus = static_cast<BusPrivate *>(data);
+    auto bus = static_cast<T *>(data);
     int dflags = dbus_watch_get_flags(watch);
     int fd = dbus_watch_get_unix_fd(watch);
     IOEventFlags flags;
@@ -439,17 +545,19 @@ dbus_bool_t DBusAddWatch(DBusWatch *watch, void *data) {
     } catch (const EventLoopException &e) {
         return false;
     }
-    DBusToggleWatch(watch, data);
+    DBusToggleWatch<T>(watch, data);
     return true;
 }
 
+template <typename T>
 void DBusRemoveWatch(DBusWatch *watch, void *data) {
-    auto bus = static_cast<BusPrivate *>(data);
+    auto bus = static_cast<T *>(data);
     bus->ioWatchers_.erase(watch);
 }
 
+template <typename T>
 dbus_bool_t DBusAddTimeout(DBusTimeout *timeout, void *data) {
-    auto bus = static_cast<BusPrivate *>(data);
+    auto bus = static_cast<T *>(data);
     if (!dbus_timeout_get_enabled(timeout)) {
         return false;
     }
@@ -480,14 +588,17 @@ dbus_bool_t DBusAddTimeout(DBusTimeout *timeout, void *data) {
     }
     return true;
 }
+
+template <typename T>
 void DBusRemoveTimeout(DBusTimeout *timeout, void *data) {
-    auto bus = static_cast<BusPrivate *>(data);
+    auto bus = static_cast<T *>(data);
     bus->timeWatchers_.erase(timeout);
 }
 
+template <typename T>
 void DBusToggleTimeout(DBusTimeout *timeout, void *data) {
-    DBusRemoveTimeout(timeout, data);
-    DBusAddTimeout(timeout, data);
+    DBusRemoveTimeout<T>(timeout, data);
+    DBusAddTimeout<T>(timeout, data);
 }
 
 void DBusDispatchStatusCallback(DBusConnection *, DBusDispatchStatus status,
@@ -505,14 +616,15 @@ void Bus::attachEventLoop(EventLoop *loop) {
     }
     d->loop_ = loop;
     do {
-        if (!dbus_connection_set_watch_functions(d->conn_, DBusAddWatch,
-                                                 DBusRemoveWatch,
-                                                 DBusToggleWatch, d, nullptr)) {
+        if (!dbus_connection_set_watch_functions(
+                d->conn_, DBusAddWatch<BusPrivate>, DBusRemoveWatch<BusPrivate>,
+                DBusToggleWatch<BusPrivate>, d, nullptr)) {
             break;
         }
         if (!dbus_connection_set_timeout_functions(
-                d->conn_, DBusAddTimeout, DBusRemoveTimeout, DBusToggleTimeout,
-                d, nullptr)) {
+                d->conn_, DBusAddTimeout<BusPrivate>,
+                DBusRemoveTimeout<BusPrivate>, DBusToggleTimeout<BusPrivate>, d,
+                nullptr)) {
             break;
         }
         if (!d->deferEvent_) {
@@ -556,8 +668,10 @@ std::unique_ptr<Slot> Bus::addMatch(MatchRule rule, MessageCallback callback) {
     if (!slot->ruleRef_) {
         return nullptr;
     }
-    slot->handler_ =
-        d->matchHandlers_.add(std::move(rule), std::move(callback));
+    auto key = BusPrivate::matchIndexKey(rule);
+    slot->handler_ = d->matchHandlers_.add(
+        key, std::make_shared<DBusMatchHandler>(
+                 std::move(rule), std::move(callback), d->matchOrder_++));
 
     return slot;
 }
@@ -592,8 +706,8 @@ std::unique_ptr<Slot> Bus::addObject(const std::string &path,
     DBusObjectPathVTable vtable;
     memset(&vtable, 0, sizeof(vtable));
     vtable.message_function = DBusObjectPathMessageCallback;
-    if (dbus_connection_register_object_path(d->conn_, path.c_str(), &vtable,
-                                             slot.get())) {
+    if (!dbus_connection_register_object_path(d->conn_, path.c_str(), &vtable,
+                                              slot.get())) {
         return nullptr;
     }
 
@@ -707,5 +821,117 @@ void Bus::flush() {
     FCITX_D();
     dbus_connection_flush(d->conn_);
 }
+void DBusNewConnection(DBusServer *, DBusConnection *conn, void *data) {
+    auto server = static_cast<ServerPrivate *>(data);
+    // The connection is released when the Bus wrapping it goes away.
+    dbus_connection_ref(conn);
+    server->newConnection(conn);
+}
+
+void ServerPrivate::newConnection(DBusConnection *conn) {
+    std::unique_ptr<Bus> bus(new Bus(this, conn));
+    if (!bus->isOpen()) {
+        return;
+    }
+    auto d = bus->d_func();
+    d->peerSender_ = senderName_;
+    d->peerBusSlot_ = addPeerBusObject(
+        *bus, stringutils::concat(":1.", ++peerIdx_), guid_);
+    bus->attachEventLoop(loop_);
+    if (callback_) {
+        callback_(std::move(bus));
+    }
+}
+
+Server::Server(const std::string &path)
+    : d_ptr(std::make_unique<ServerPrivate>()) {
+    FCITX_D();
+    auto address = stringutils::concat("unix:path=", escapePath(path));
+    ScopedDBusError error;
+    d->server_ = dbus_server_listen(address.c_str(), &error.error());
+    if (!d->server_) {
+        FCITX_LIBDBUS_DEBUG() << "Failed to listen on " << address << ": "
+                              << error.error().message;
+        return;
+    }
+    // Only uid based authentication makes sense for a local socket.
+    const char *mechanisms[] = {"EXTERNAL", nullptr};
+    dbus_server_set_auth_mechanisms(d->server_, mechanisms);
+    dbus_server_set_new_connection_function(d->server_, DBusNewConnection, d,
+                                            nullptr);
+    if (auto serverAddress = dbus_server_get_address(d->server_)) {
+        d->address_ = serverAddress;
+        dbus_free(serverAddress);
+    }
+    if (auto guid = dbus_server_get_id(d->server_)) {
+        d->guid_ = guid;
+        dbus_free(guid);
+    }
+}
+
+Server::~Server() {
+    FCITX_D();
+    if (d->attached_) {
+        detachEventLoop();
+    }
+}
+
+bool Server::isOpen() const {
+    FCITX_D();
+    return d->server_ && dbus_server_get_is_connected(d->server_);
+}
+
+std::string Server::address() const {
+    FCITX_D();
+    return d->address_;
+}
+
+void Server::attachEventLoop(EventLoop *loop) {
+    FCITX_D();
+    if (d->attached_ || !d->server_) {
+        return;
+    }
+    d->loop_ = loop;
+    do {
+        if (!dbus_server_set_watch_functions(
+                d->server_, DBusAddWatch<ServerPrivate>,
+                DBusRemoveWatch<ServerPrivate>, DBusToggleWatch<ServerPrivate>,
+                d, nullptr)) {
+            break;
+        }
+        if (!dbus_server_set_timeout_functions(
+                d->server_, DBusAddTimeout<ServerPrivate>,
+                DBusRemoveTimeout<ServerPrivate>,
+                DBusToggleTimeout<ServerPrivate>, d, nullptr)) {
+            break;
+        }
+        d->attached_ = true;
+        return;
+    } while (0);
+
+    detachEventLoop();
+}
+
+void Server::detachEventLoop() {
+    FCITX_D();
+    if (d->server_) {
+        dbus_server_set_watch_functions(d->server_, nullptr, nullptr, nullptr,
+                                        nullptr, nullptr);
+        dbus_server_set_timeout_functions(d->server_, nullptr, nullptr,
+                                          nullptr, nullptr, nullptr);
+    }
+    d->loop_ = nullptr;
+    d->attached_ = false;
+}
+
+void Server::setNewConnectionCallback(NewConnectionCallback callback) {
+    FCITX_D();
+    d->callback_ = std::move(callback);
+}
+
+void Server::setSenderName(const std::string &name) {
+    FCITX_D();
+    d->senderName_ = name;
+}
 } // namespace dbus
 } // namespace fcitx
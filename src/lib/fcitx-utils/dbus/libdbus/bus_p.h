@@ -22,6 +22,7 @@
 #include "../../log.h"
 #include "../bus.h"
 #include "servicenamecache.h"
+#include <array>
 #include <dbus/dbus.h>
 
 namespace fcitx {
@@ -69,6 +70,26 @@ public:
     std::string xml_;
 };
 
+// Signal handlers are indexed by the fields of their match rule that are set.
+enum MatchIndexField : unsigned int {
+    MatchIndexInterface = 1,
+    MatchIndexMember = 1 << 1,
+    MatchIndexPath = 1 << 2,
+    MatchIndexArg0 = 1 << 3,
+    MatchIndexShapes = 1 << 4,
+};
+
+struct DBusMatchHandler {
+    DBusMatchHandler(MatchRule rule, MessageCallback callback, uint64_t order)
+        : rule_(std::move(rule)), callback_(std::move(callback)),
+          order_(order) {}
+
+    MatchRule rule_;
+    MessageCallback callback_;
+    // Handlers are called in the order they are added.
+    uint64_t order_;
+};
+
 class BusPrivate : public TrackableObject<BusPrivate> {
 public:
     BusPrivate(Bus *bus)
@@ -78,6 +99,10 @@ public:
                   if (!conn_) {
                       return false;
                   }
+                  // There is no bus daemon to filter messages for us.
+                  if (peer_) {
+                      return true;
+                  }
                   ScopedDBusError error;
                   if (needWatchService(rule)) {
                       nameCache()->addWatch(rule.service());
@@ -92,7 +117,7 @@ public:
                   return false;
               },
               [this](const MatchRule &rule) {
-                  if (!conn_) {
+                  if (!conn_ || peer_) {
                       return;
                   }
                   if (needWatchService(rule)) {
@@ -101,6 +126,14 @@ public:
                   FCITX_LIBDBUS_DEBUG() << "Remove dbus match: " << rule.rule();
                   dbus_bus_remove_match(conn_, rule.rule().c_str(), nullptr);
               }),
+          matchHandlers_(
+              [this](const std::string &key) {
+                  ++matchIndexShapes_[matchIndexShape(key)];
+                  return true;
+              },
+              [this](const std::string &key) {
+                  --matchIndexShapes_[matchIndexShape(key)];
+              }),
           objectRegistration_(
               [this](const std::string &path) {
                   if (!conn_) {
@@ -125,6 +158,7 @@ public:
               }) {}
 
     ~BusPrivate() {
+        peerBusSlot_.reset();
         if (conn_) {
             dbus_connection_flush(conn_);
             dbus_connection_close(conn_);
@@ -156,6 +190,17 @@ public:
         return nameCache_.get();
     }
 
+    static unsigned int matchIndexShape(const std::string &key) {
+        return static_cast<unsigned char>(key[0]);
+    }
+    static std::string matchIndexKey(unsigned int shape,
+                                     const std::string &interface,
+                                     const std::string &member,
+                                     const std::string &path,
+                                     const std::string &arg0);
+    static std::string matchIndexKey(const MatchRule &rule);
+    bool dispatchSignal(Message &message);
+
     DBusObjectVTableSlot *findSlot(const std::string &path,
                                    const std::string interface);
     bool objectVTableCallback(Message &message);
@@ -164,7 +209,11 @@ public:
     std::string address_;
     DBusConnection *conn_;
     MultiHandlerTable<MatchRule, int> matchRuleSet_;
-    HandlerTable<std::pair<MatchRule, MessageCallback>> matchHandlers_;
+    MultiHandlerTable<std::string, std::shared_ptr<DBusMatchHandler>>
+        matchHandlers_;
+    // Number of index keys in use for each combination of MatchIndexField.
+    std::array<size_t, MatchIndexShapes> matchIndexShapes_{};
+    uint64_t matchOrder_ = 0;
     HandlerTable<MessageCallback> filterHandlers_;
     bool attached_ = false;
     EventLoop *loop_ = nullptr;
@@ -176,6 +225,40 @@ public:
         objectRegistration_;
     std::unique_ptr<EventSource> deferEvent_;
     std::unique_ptr<ServiceNameCache> nameCache_;
+    // Set for connections accepted by a Server.
+    bool peer_ = false;
+    std::string peerSender_;
+    std::unique_ptr<Slot> peerBusSlot_;
+};
+
+class ServerPrivate : public TrackableObject<ServerPrivate> {
+public:
+    ServerPrivate() = default;
+
+    ~ServerPrivate() {
+        if (server_) {
+            dbus_server_disconnect(server_);
+            dbus_server_unref(server_);
+        }
+        server_ = nullptr;
+    }
+
+    // Used by the shared watch callbacks, nothing is queued on a server.
+    void dispatch() {}
+
+    void newConnection(DBusConnection *conn);
+
+    DBusServer *server_ = nullptr;
+    std::string address_;
+    std::string guid_;
+    uint64_t peerIdx_ = 0;
+    std::string senderName_;
+    NewConnectionCallback callback_;
+    bool attached_ = false;
+    EventLoop *loop_ = nullptr;
+    std::unordered_map<DBusWatch *, std::unique_ptr<EventSourceIO>> ioWatchers_;
+    std::unordered_map<DBusTimeout *, std::unique_ptr<EventSourceTime>>
+        timeWatchers_;
 };
 
 class DBusObjectSlot : public Slot {
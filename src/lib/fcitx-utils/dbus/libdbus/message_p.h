@@ -21,6 +21,7 @@
 
 #include "../message.h"
 #include <dbus/dbus.h>
+#include <deque>
 
 namespace fcitx {
 namespace dbus {
@@ -130,7 +131,9 @@ public:
     MessageType type_;
     TrackableObjectReference<BusPrivate> bus_;
     bool write_ = false;
-    mutable std::list<DBusMessageIter> iterators_;
+    // Deque keeps pointers to parent iterators valid, without allocating
+    // a node for every container.
+    mutable std::deque<DBusMessageIter> iterators_;
     std::string error_;
     std::string message_;
     int lastError_ = 0;
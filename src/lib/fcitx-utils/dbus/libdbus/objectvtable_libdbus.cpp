@@ -22,6 +22,7 @@
 #include "../objectvtable.h"
 #include "../utils_p.h"
 #include "bus_p.h"
+#include "message_p.h"
 #include "objectvtable_p_libdbus.h"
 #include <unordered_set>
 
@@ -157,6 +158,14 @@ void ObjectVTableBase::setCurrentMessage(Message *msg) {
     d->msg_ = msg;
 }
 
+Message ObjectVTableBase::delayReply() {
+    FCITX_D();
+    // Leave an empty message behind, so the method handler does not reply.
+    auto call = std::move(*d->msg_);
+    *d->msg_ = Message();
+    return call;
+}
+
 std::shared_ptr<ObjectVTablePrivate> ObjectVTableBase::newSharedPrivateData() {
     return std::make_shared<ObjectVTablePrivate>();
 }
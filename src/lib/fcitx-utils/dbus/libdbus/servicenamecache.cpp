@@ -33,6 +33,34 @@ std::string fcitx::dbus::ServiceNameCache::owner(const std::string &query) {
     return iter->second;
 }
 
+const std::unordered_set<std::string> *
+fcitx::dbus::ServiceNameCache::ownedNames(const std::string &owner) const {
+    auto iter = ownerMap_.find(owner);
+    if (iter == ownerMap_.end()) {
+        return nullptr;
+    }
+    return &iter->second;
+}
+
+void fcitx::dbus::ServiceNameCache::setOwner(const std::string &name,
+                                             const std::string &owner) {
+    auto iter = nameMap_.find(name);
+    if (iter != nameMap_.end()) {
+        auto ownerIter = ownerMap_.find(iter->second);
+        if (ownerIter != ownerMap_.end()) {
+            ownerIter->second.erase(name);
+            if (ownerIter->second.empty()) {
+                ownerMap_.erase(ownerIter);
+            }
+        }
+        nameMap_.erase(iter);
+    }
+    if (!owner.empty()) {
+        nameMap_[name] = owner;
+        ownerMap_[owner].insert(name);
+    }
+}
+
 void fcitx::dbus::ServiceNameCache::addWatch(const std::string &name) {
     auto iter = watcherMap_.find(name);
     if (watcherMap_.find(name) != watcherMap_.end()) {
@@ -45,11 +73,7 @@ void fcitx::dbus::ServiceNameCache::addWatch(const std::string &name) {
                                     name, [this](const std::string &service,
                                                  const std::string &,
                                                  const std::string &newName) {
-                                        if (newName.empty()) {
-                                            nameMap_.erase(newName);
-                                        } else {
-                                            nameMap_[service] = newName;
-                                        }
+                                        setOwner(service, newName);
                                     })));
     assert(result.second);
     FCITX_LIBDBUS_DEBUG() << "add Service name cache for " << name;
@@ -62,6 +86,7 @@ void fcitx::dbus::ServiceNameCache::removeWatch(const std::string &name) {
         --iter->second.first;
         if (iter->second.first == 0) {
             watcherMap_.erase(iter);
+            setOwner(name, "");
             FCITX_LIBDBUS_DEBUG() << "remove service name cache for " << name;
         }
     }
@@ -23,6 +23,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace fcitx {
 namespace dbus {
@@ -35,12 +36,19 @@ public:
     ServiceNameCache(Bus &bus);
     ~ServiceNameCache();
     std::string owner(const std::string &query);
+    // Return the watched names currently owned by the given unique name.
+    const std::unordered_set<std::string> *
+    ownedNames(const std::string &owner) const;
     void addWatch(const std::string &name);
     void removeWatch(const std::string &name);
 
 private:
     std::unique_ptr<ServiceWatcher> watcher_;
+    void setOwner(const std::string &name, const std::string &owner);
+
     std::unordered_map<std::string, std::string> nameMap_;
+    std::unordered_map<std::string, std::unordered_set<std::string>>
+        ownerMap_;
     std::unordered_map<std::string,
                        std::pair<int, std::unique_ptr<HandlerTableEntryBase>>>
         watcherMap_;
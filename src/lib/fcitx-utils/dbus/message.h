@@ -423,7 +423,7 @@ public:
             ;
             T temp;
             while (!end() && *this >> temp) {
-                t.push_back(temp);
+                t.push_back(std::move(temp));
             }
             *this >> ContainerEnd();
         }
@@ -27,7 +27,9 @@
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace fcitx {
 namespace dbus {
@@ -96,6 +98,38 @@ struct ReturnValueHelper<void> {
     }
 };
 
+// Write signal arguments as the types declared in the signature. Arguments
+// that already have the right type are written directly instead of being
+// copied into a tuple first.
+template <typename Expected, typename Arg>
+void marshallAs(Message &msg, Arg &&arg) {
+    if constexpr (std::is_same<std::decay_t<Arg>, Expected>::value) {
+        msg << arg;
+    } else {
+        msg << Expected(std::forward<Arg>(arg));
+    }
+}
+
+template <typename Tuple, size_t... I, typename... Args>
+void marshallTupleElements(Message &msg, std::index_sequence<I...>,
+                           Args &&... args) {
+    (marshallAs<std::tuple_element_t<I, Tuple>>(msg,
+                                                std::forward<Args>(args)),
+     ...);
+}
+
+template <typename Tuple, typename... Args>
+void marshallAsTuple(Message &msg, Args &&... args) {
+    if constexpr (sizeof...(Args) == std::tuple_size<Tuple>::value) {
+        marshallTupleElements<Tuple>(
+            msg, std::make_index_sequence<sizeof...(Args)>(),
+            std::forward<Args>(args)...);
+    } else {
+        Tuple tupleArg{std::forward<Args>(args)...};
+        msg << tupleArg;
+    }
+}
+
 #define FCITX_OBJECT_VTABLE_METHOD(FUNCTION, FUNCTION_NAME, SIGNATURE, RET)    \
     ::fcitx::dbus::ObjectVTableMethod FUNCTION##Method {                       \
         this, FUNCTION_NAME, SIGNATURE, RET,                                   \
@@ -118,15 +152,22 @@ struct ReturnValueHelper<void> {
                 };                                                             \
                 try {                                                          \
                     helper.call(functor);                                      \
-                    auto reply = msg.createReply();                            \
                     static_assert(std::is_same<FCITX_STRING_TO_DBUS_TYPE(RET), \
                                                ReturnType>::value,             \
                                   "Return type does not match: " RET);         \
-                    reply << helper.ret;                                       \
-                    reply.send();                                              \
+                    if (msg.type() ==                                          \
+                        ::fcitx::dbus::MessageType::MethodCall) {              \
+                        auto reply = msg.createReply();                        \
+                        reply << helper.ret;                                   \
+                        reply.send();                                          \
+                    }                                                          \
                 } catch (const ::fcitx::dbus::MethodCallError &error) {        \
-                    auto reply = msg.createError(error.name(), error.what());  \
-                    reply.send();                                              \
+                    if (msg.type() ==                                          \
+                        ::fcitx::dbus::MessageType::MethodCall) {              \
+                        auto reply =                                           \
+                            msg.createError(error.name(), error.what());       \
+                        reply.send();                                          \
+                    }                                                          \
                 }                                                              \
                 if (watcher.isValid()) {                                       \
                     watcher.get()->setCurrentMessage(nullptr);                 \
@@ -142,16 +183,16 @@ struct ReturnValueHelper<void> {
     template <typename... Args>                                                \
     void SIGNAL(Args &&... args) {                                             \
         auto msg = SIGNAL##Signal.createSignal();                              \
-        SIGNAL##ArgType tupleArg{std::forward<Args>(args)...};                 \
-        msg << tupleArg;                                                       \
+        ::fcitx::dbus::marshallAsTuple<SIGNAL##ArgType>(                       \
+            msg, std::forward<Args>(args)...);                                 \
         msg.send();                                                            \
     }                                                                          \
     template <typename... Args>                                                \
     void SIGNAL##To(const std::string &dest, Args &&... args) {                \
         auto msg = SIGNAL##Signal.createSignal();                              \
         msg.setDestination(dest);                                              \
-        SIGNAL##ArgType tupleArg{std::forward<Args>(args)...};                 \
-        msg << tupleArg;                                                       \
+        ::fcitx::dbus::marshallAsTuple<SIGNAL##ArgType>(                       \
+            msg, std::forward<Args>(args)...);                                 \
         msg.send();                                                            \
     }
 
@@ -270,6 +311,16 @@ public:
 
     void setCurrentMessage(Message *message);
 
+    /**
+     * Take over the reply to the method call being handled.
+     *
+     * The call is moved out of currentMessage(), which becomes empty, so
+     * nothing is sent when the method returns, even if the object is
+     * destroyed meanwhile. The returned message must be answered later with
+     * createReply() or createError() instead.
+     */
+    Message delayReply();
+
     ObjectVTableMethod *findMethod(const std::string &name);
     ObjectVTableProperty *findProperty(const std::string &name);
 
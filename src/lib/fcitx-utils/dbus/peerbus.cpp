@@ -0,0 +1,73 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "peerbus_p.h"
+
+namespace fcitx {
+namespace dbus {
+
+namespace {
+
+constexpr char peerBusName[] = "org.freedesktop.DBus";
+constexpr char peerBusPath[] = "/org/freedesktop/DBus";
+// Reply of RequestName and ReleaseName.
+constexpr uint32_t primaryOwner = 1;
+constexpr uint32_t released = 1;
+
+} // namespace
+
+std::unique_ptr<Slot> addPeerBusObject(Bus &bus, const std::string &uniqueName,
+                                       const std::string &guid) {
+    return bus.addObject(peerBusPath, [uniqueName, guid](Message &message) {
+        if (message.type() != MessageType::MethodCall ||
+            message.interface() != peerBusName) {
+            return false;
+        }
+        auto member = message.member();
+        auto reply = message.createReply();
+        if (member == "Hello") {
+            reply << uniqueName;
+        } else if (member == "GetId") {
+            reply << guid;
+        } else if (member == "AddMatch" || member == "RemoveMatch") {
+            // Every signal is sent to the only peer anyway.
+        } else if (member == "RequestName") {
+            reply << primaryOwner;
+        } else if (member == "ReleaseName") {
+            reply << released;
+        } else if (member == "GetNameOwner") {
+            std::string name;
+            message >> name;
+            reply << name;
+        } else if (member == "NameHasOwner") {
+            reply << true;
+        } else if (member == "ListNames") {
+            reply << std::vector<std::string>{peerBusName, uniqueName};
+        } else {
+            reply = message.createError("org.freedesktop.DBus.Error."
+                                        "UnknownMethod",
+                                        "Unsupported on a peer connection.");
+        }
+        reply.send();
+        return true;
+    });
+}
+
+} // namespace dbus
+} // namespace fcitx
@@ -0,0 +1,36 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#ifndef _FCITX_UTILS_DBUS_PEERBUS_P_H_
+#define _FCITX_UTILS_DBUS_PEERBUS_P_H_
+
+#include "bus.h"
+
+namespace fcitx {
+namespace dbus {
+
+// Answers org.freedesktop.DBus methods on a peer to peer connection, so a
+// client that connects to the address as a message bus gets uniqueName as
+// its name and sees every other name as owned by the server.
+std::unique_ptr<Slot> addPeerBusObject(Bus &bus, const std::string &uniqueName,
+                                       const std::string &guid);
+
+} // namespace dbus
+} // namespace fcitx
+
+#endif // _FCITX_UTILS_DBUS_PEERBUS_P_H_
@@ -18,10 +18,17 @@
 //
 
 #include "../../log.h"
+#include "../../stringutils.h"
+#include "../peerbus_p.h"
+#include "../utils_p.h"
 #include "bus_p.h"
 #include "message_p.h"
 #include "objectvtable_p_sdbus.h"
 #include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 namespace fcitx {
 
@@ -33,10 +40,41 @@ class BusPrivate {
 public:
     BusPrivate() : bus_(nullptr) {}
 
-    ~BusPrivate() { sd_bus_flush_close_unref(bus_); }
+    ~BusPrivate() {
+        peerBusSlot_.reset();
+        sd_bus_flush_close_unref(bus_);
+    }
 
     sd_bus *bus_;
     bool attached_ = false;
+    // Set for connections accepted by a Server.
+    std::string peerSender_;
+    std::unique_ptr<Slot> peerBusSlot_;
+};
+
+class ServerPrivate {
+public:
+    ServerPrivate() = default;
+
+    ~ServerPrivate() {
+        if (fd_ >= 0) {
+            close(fd_);
+            unlink(path_.c_str());
+        }
+    }
+
+    void accept();
+    void newConnection(int fd);
+
+    int fd_ = -1;
+    std::string path_;
+    std::string address_;
+    sd_id128_t id_;
+    uint64_t peerIdx_ = 0;
+    std::string senderName_;
+    NewConnectionCallback callback_;
+    EventLoop *loop_ = nullptr;
+    std::unique_ptr<EventSourceIO> ioEvent_;
 };
 
 Bus::Bus(BusType type) : d_ptr(std::make_unique<BusPrivate>()) {
@@ -78,6 +116,12 @@ fail:
     d_ptr->bus_ = nullptr;
 }
 
+Bus::Bus(ServerPrivate *, void *connection)
+    : d_ptr(std::make_unique<BusPrivate>()) {
+    FCITX_D();
+    d->bus_ = static_cast<sd_bus *>(connection);
+}
+
 Bus::~Bus() {
     FCITX_D();
     if (d->attached_) {
@@ -117,6 +161,9 @@ Message Bus::createSignal(const char *path, const char *interface,
         msgD->type_ = MessageType::Invalid;
     } else {
         msgD->type_ = MessageType::Signal;
+        if (!d->peerSender_.empty()) {
+            sd_bus_message_set_sender(msgD->msg_, d->peerSender_.c_str());
+        }
     }
     return msg;
 }
@@ -283,5 +330,124 @@ void Bus::flush() {
     FCITX_D();
     sd_bus_flush(d->bus_);
 }
+void ServerPrivate::accept() {
+    int fd;
+    while ((fd = accept4(fd_, nullptr, nullptr,
+                         SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+        newConnection(fd);
+    }
+}
+
+void ServerPrivate::newConnection(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+        cred.uid != getuid()) {
+        close(fd);
+        return;
+    }
+
+    sd_bus *sdbus = nullptr;
+    if (sd_bus_new(&sdbus) < 0) {
+        close(fd);
+        return;
+    }
+    if (sd_bus_set_fd(sdbus, fd, fd) < 0) {
+        sd_bus_unref(sdbus);
+        close(fd);
+        return;
+    }
+    // The bus owns fd from now on.
+    if (sd_bus_set_server(sdbus, 1, id_) < 0 || sd_bus_start(sdbus) < 0) {
+        sd_bus_unref(sdbus);
+        return;
+    }
+
+    std::unique_ptr<Bus> bus(new Bus(this, sdbus));
+    char id[SD_ID128_STRING_MAX];
+    auto d = bus->d_func();
+    d->peerSender_ = senderName_;
+    d->peerBusSlot_ =
+        addPeerBusObject(*bus, stringutils::concat(":1.", ++peerIdx_),
+                         sd_id128_to_string(id_, id));
+    bus->attachEventLoop(loop_);
+    if (callback_) {
+        callback_(std::move(bus));
+    }
+}
+
+Server::Server(const std::string &path)
+    : d_ptr(std::make_unique<ServerPrivate>()) {
+    FCITX_D();
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return;
+    }
+    // Replace the socket left behind by a previous instance.
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+            0 ||
+        listen(fd, SOMAXCONN) < 0 || sd_id128_randomize(&d->id_) < 0) {
+        close(fd);
+        return;
+    }
+    d->fd_ = fd;
+    d->path_ = path;
+    char id[SD_ID128_STRING_MAX];
+    d->address_ = stringutils::concat("unix:path=", escapePath(path),
+                                      ",guid=", sd_id128_to_string(d->id_, id));
+}
+
+Server::~Server() {}
+
+bool Server::isOpen() const {
+    FCITX_D();
+    return d->fd_ >= 0;
+}
+
+std::string Server::address() const {
+    FCITX_D();
+    return d->address_;
+}
+
+void Server::attachEventLoop(EventLoop *loop) {
+    FCITX_D();
+    if (d->ioEvent_ || d->fd_ < 0) {
+        return;
+    }
+    d->loop_ = loop;
+    d->ioEvent_ = loop->addIOEvent(d->fd_, IOEventFlag::In,
+                                   [d](EventSourceIO *, int, IOEventFlags) {
+                                       d->accept();
+                                       return true;
+                                   });
+}
+
+void Server::detachEventLoop() {
+    FCITX_D();
+    d->ioEvent_.reset();
+    d->loop_ = nullptr;
+}
+
+void Server::setNewConnectionCallback(NewConnectionCallback callback) {
+    FCITX_D();
+    d->callback_ = std::move(callback);
+}
+
+void Server::setSenderName(const std::string &name) {
+    FCITX_D();
+    d->senderName_ = name;
+}
 } // namespace dbus
 } // namespace fcitx
@@ -21,6 +21,7 @@
 #include "../../misc_p.h"
 #include "../../unixfd.h"
 #include "../variant.h"
+#include "../variant_p.h"
 #include "bus_p.h"
 #include "message_p.h"
 #include <atomic>
@@ -90,7 +91,7 @@ MessageType Message::type() const {
 
 void Message::setDestination(const std::string &dest) {
     FCITX_D();
-    if (d->msg_) {
+    if (d->msg_ && !dest.empty()) {
         sd_bus_message_set_destination(d->msg_, dest.c_str());
     }
 }
@@ -451,15 +452,14 @@ Message &Message::operator>>(Variant &variant) {
     FCITX_D();
     auto type = peekType();
     if (type.first == 'v') {
-        auto helper =
-            VariantTypeRegistry::defaultRegistry().lookupType(type.second);
-        if (helper) {
+        auto variantType =
+            VariantTypeRegistryPrivate::defaultRegistry().lookupTypeInfo(
+                type.second);
+        if (variantType) {
             if (*this >>
                 Container(Container::Type::Variant, Signature(type.second))) {
-                auto data = helper->copy(nullptr);
-                helper->deserialize(*this, data.get());
+                variant.readFromMessage(*this, *variantType);
                 if (*this) {
-                    variant.setRawData(data, helper);
                     *this >> ContainerEnd();
                 }
             }
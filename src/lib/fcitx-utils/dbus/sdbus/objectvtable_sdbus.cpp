@@ -20,6 +20,7 @@
 #include "../../log.h"
 #include "../objectvtable.h"
 #include "bus_p.h"
+#include "message_p.h"
 #include "objectvtable_p_sdbus.h"
 #include <unordered_set>
 
@@ -229,6 +230,14 @@ void ObjectVTableBase::setCurrentMessage(Message *msg) {
     d->msg_ = msg;
 }
 
+Message ObjectVTableBase::delayReply() {
+    FCITX_D();
+    // Leave an empty message behind, so the method handler does not reply.
+    auto call = std::move(*d->msg_);
+    *d->msg_ = Message();
+    return call;
+}
+
 std::shared_ptr<ObjectVTablePrivate> ObjectVTableBase::newSharedPrivateData() {
     return std::make_shared<ObjectVTablePrivate>();
 }
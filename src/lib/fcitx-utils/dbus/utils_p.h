@@ -19,6 +19,7 @@
 #ifndef _FCITX_UTILS_DBUS_UTILS_P_H_
 #define _FCITX_UTILS_DBUS_UTILS_P_H_
 
+#include "../charutils.h"
 #include <string>
 #include <vector>
 
@@ -68,6 +69,24 @@ splitDBusSignature(const std::string &s) {
     return result;
 }
 
+static inline std::string escapePath(const std::string &path) {
+    std::string newPath;
+    newPath.reserve(path.size() * 3);
+    for (auto c : path) {
+        if (charutils::islower(c) || charutils::isupper(c) ||
+            charutils::isdigit(c) || c == '_' || c == '-' || c == '/' ||
+            c == '.') {
+            newPath.push_back(c);
+        } else {
+            newPath.push_back('%');
+            newPath.push_back(charutils::toHex(c >> 4));
+            newPath.push_back(charutils::toHex(c & 0xf));
+        }
+    }
+
+    return newPath;
+}
+
 } // namespace dbus
 } // namespace fcitx
 
@@ -18,17 +18,84 @@
 //
 #include "variant.h"
 #include "fcitx-utils/misc_p.h"
-#include <shared_mutex>
+#include "variant_p.h"
+#include <array>
+#include <typeinfo>
 
 namespace fcitx {
 namespace dbus {
 
-class VariantTypeRegistryPrivate {
-public:
-    std::unordered_map<std::string, std::shared_ptr<VariantHelperBase>> types_;
-    mutable std::shared_timed_mutex mutex_;
+namespace {
+
+// Decoding usually sees the same few signatures again and again.
+struct RecentVariantTypes {
+    std::array<const VariantTypeInfo *, 4> types_{};
+    size_t next_ = 0;
 };
 
+} // namespace
+
+const VariantTypeInfo *VariantTypeRegistryPrivate::registerType(
+    const std::string &signature, std::shared_ptr<VariantHelperBase> helper,
+    bool storesInline, bool listed) {
+    std::lock_guard<std::shared_timed_mutex> lock(mutex_);
+    if (!listed) {
+        auto &type = unlistedTypes_[std::type_index(typeid(*helper))];
+        if (!type) {
+            type = std::make_unique<VariantTypeInfo>(
+                VariantTypeInfo{0, signature, std::move(helper), storesInline});
+        }
+        return type.get();
+    }
+    if (auto id = findValue(ids_, signature)) {
+        return types_[*id - 1].get();
+    }
+    uint32_t id = types_.size() + 1;
+    types_.push_back(std::make_unique<VariantTypeInfo>(
+        VariantTypeInfo{id, signature, std::move(helper), storesInline}));
+    ids_.emplace(signature, id);
+    return types_.back().get();
+}
+
+const VariantTypeInfo *
+VariantTypeRegistryPrivate::lookupTypeInfo(const std::string &signature) const {
+    // Only the default registry can exist, so the cache does not need to
+    // remember which registry an entry belongs to.
+    thread_local RecentVariantTypes recent;
+    for (auto type : recent.types_) {
+        if (type && type->signature == signature) {
+            return type;
+        }
+    }
+
+    const VariantTypeInfo *type = nullptr;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+        auto id = findValue(ids_, signature);
+        if (!id) {
+            return nullptr;
+        }
+        type = types_[*id - 1].get();
+    }
+    recent.types_[recent.next_] = type;
+    recent.next_ = (recent.next_ + 1) % recent.types_.size();
+    return type;
+}
+
+uint32_t
+VariantTypeRegistryPrivate::lookupTypeId(const std::string &signature) const {
+    auto type = lookupTypeInfo(signature);
+    return type ? type->id : 0;
+}
+
+const VariantTypeInfo *VariantTypeRegistryPrivate::typeInfo(uint32_t id) const {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    if (id == 0 || id > types_.size()) {
+        return nullptr;
+    }
+    return types_[id - 1].get();
+}
+
 VariantTypeRegistry::VariantTypeRegistry()
     : d_ptr(std::make_unique<VariantTypeRegistryPrivate>()) {
     registerType<std::string>();
@@ -47,22 +114,18 @@ VariantTypeRegistry::VariantTypeRegistry()
     registerType<Variant>();
 }
 
-void VariantTypeRegistry::registerTypeImpl(
-    const std::string &signature, std::shared_ptr<VariantHelperBase> helper) {
+const VariantTypeInfo *VariantTypeRegistry::registerTypeImpl(
+    const std::string &signature, std::shared_ptr<VariantHelperBase> helper,
+    bool storesInline, bool listed) {
     FCITX_D();
-    std::lock_guard<std::shared_timed_mutex> lock(d->mutex_);
-    if (d->types_.count(signature)) {
-        return;
-    }
-    d->types_.emplace(signature, helper);
+    return d->registerType(signature, std::move(helper), storesInline, listed);
 }
 
 std::shared_ptr<VariantHelperBase>
 VariantTypeRegistry::lookupType(const std::string &signature) const {
     FCITX_D();
-    std::shared_lock<std::shared_timed_mutex> lock(d->mutex_);
-    auto v = findValue(d->types_, signature);
-    return v ? *v : nullptr;
+    auto type = d->lookupTypeInfo(signature);
+    return type ? type->helper : nullptr;
 }
 
 VariantTypeRegistry &VariantTypeRegistry::defaultRegistry() {
@@ -70,8 +133,59 @@ VariantTypeRegistry &VariantTypeRegistry::defaultRegistry() {
     return registry;
 }
 
+const std::string &Variant::signature() const {
+    static const std::string empty;
+    return type_ ? type_->signature : empty;
+}
+
+void Variant::printData(LogMessageBuilder &builder) const {
+    if (type_) {
+        type_->helper->print(builder, rawData());
+    }
+}
+
+void Variant::setRawData(std::shared_ptr<void> data,
+                         std::shared_ptr<VariantHelperBase> helper) {
+    if (!helper) {
+        type_ = nullptr;
+        data_ = std::move(data);
+        return;
+    }
+    auto &registry = VariantTypeRegistryPrivate::defaultRegistry();
+    const auto *type = registry.lookupTypeInfo(helper->signature());
+    if (!type) {
+        type = registry.registerType(helper->signature(), helper, false, true);
+    }
+    // Data is kept out of line even if the type is usually stored inline,
+    // rawData() prefers data_.
+    type_ = type;
+    data_ = std::move(data);
+}
+
+void Variant::readFromMessage(dbus::Message &msg,
+                              const VariantTypeInfo &type) {
+    const auto *helper = type.helper.get();
+    if (type.storesInline) {
+        InlineStorage value{};
+        helper->deserialize(msg, &value);
+        if (!msg) {
+            return;
+        }
+        data_.reset();
+        inlineData_ = value;
+    } else {
+        auto data = helper->copy(nullptr);
+        helper->deserialize(msg, data.get());
+        if (!msg) {
+            return;
+        }
+        data_ = std::move(data);
+    }
+    type_ = &type;
+}
+
 void Variant::writeToMessage(dbus::Message &msg) const {
-    helper_->serialize(msg, data_.get());
+    type_->helper->serialize(msg, rawData());
 }
 
 } // namespace dbus
@@ -21,13 +21,23 @@
 
 #include "fcitxutils_export.h"
 #include "message.h"
+#include <algorithm>
 #include <memory>
+#include <new>
 #include <string>
+#include <type_traits>
 
 namespace fcitx {
 namespace dbus {
 
 class VariantTypeRegistryPrivate;
+struct VariantTypeInfo;
+
+/// Scalars are stored inside Variant, instead of a shared allocation.
+template <typename T>
+struct VariantStoresInline
+    : std::integral_constant<bool, std::is_arithmetic<T>::value &&
+                                       sizeof(T) <= sizeof(uint64_t)> {};
 
 /// We need to "predefine some of the variant type that we want to handle".
 class FCITXUTILS_EXPORT VariantTypeRegistry {
@@ -42,15 +52,34 @@ public:
             std::is_same<TypeName, PureType>::value,
             "Type is not pure enough, remove the redundant tuple from it");
         registerTypeImpl(DBusSignatureTraits<TypeName>::signature::data(),
-                         std::make_shared<VariantHelper<TypeName>>());
+                         std::make_shared<VariantHelper<TypeName>>(),
+                         VariantStoresInline<TypeName>::value);
     }
 
     std::shared_ptr<VariantHelperBase>
     lookupType(const std::string &signature) const;
 
 private:
-    void registerTypeImpl(const std::string &signature,
-                          std::shared_ptr<VariantHelperBase>);
+    friend class Variant;
+
+    // Types that are not pure, e.g. a tuple of one element, can still be set
+    // to a variant, but they are kept out of the lookup, so reading from a
+    // message always creates the pure type.
+    template <typename TypeName>
+    const VariantTypeInfo *typeForValue() {
+        using SignatureType = typename DBusSignatureTraits<TypeName>::signature;
+        using PureType = FCITX_STRING_TO_DBUS_TYPE(SignatureType::str());
+        return registerTypeImpl(
+            DBusSignatureTraits<TypeName>::signature::data(),
+            std::make_shared<VariantHelper<TypeName>>(),
+            VariantStoresInline<TypeName>::value,
+            std::is_same<TypeName, PureType>::value);
+    }
+
+    const VariantTypeInfo *
+    registerTypeImpl(const std::string &signature,
+                     std::shared_ptr<VariantHelperBase>, bool storesInline,
+                     bool listed = true);
     VariantTypeRegistry();
     std::unique_ptr<VariantTypeRegistryPrivate> d_ptr;
     FCITX_DECLARE_PRIVATE(VariantTypeRegistry);
@@ -64,21 +93,11 @@ public:
         setData(std::forward<Value>(value));
     }
 
-    Variant(const Variant &v) : signature_(v.signature_), helper_(v.helper_) {
-        if (helper_) {
-            data_ = helper_->copy(v.data_.get());
-        }
-    }
-
+    // Data is never modified once it is set, so copies can share it. Scalars
+    // are stored inline and simply copied.
+    Variant(const Variant &v) = default;
     Variant(Variant &&v) = default;
-    Variant &operator=(const Variant &v) {
-        signature_ = v.signature_;
-        helper_ = v.helper_;
-        if (helper_) {
-            data_ = helper_->copy(v.data_.get());
-        }
-        return *this;
-    }
+    Variant &operator=(const Variant &v) = default;
     Variant &operator=(Variant &&v) = default;
 
     template <typename Value,
@@ -93,43 +112,60 @@ public:
 
     void setData(const char *str) { setData(std::string(str)); }
 
-    void setRawData(std::shared_ptr<void> data,
-                    std::shared_ptr<VariantHelperBase> helper) {
-        data_ = data;
-        helper_ = helper;
-        if (helper_) {
-            signature_ = helper->signature();
-        }
-    }
+    /// Kept for compatibility, data must be created by helper. Type of the
+    /// signature of helper is registered if it is not known yet.
+    FCITXUTILS_DEPRECATED void
+    setRawData(std::shared_ptr<void> data,
+               std::shared_ptr<VariantHelperBase> helper);
 
     template <typename Value>
     const Value &dataAs() const {
         assert(signature() == DBusSignatureTraits<Value>::signature::data());
-        return *static_cast<Value *>(data_.get());
+        return *static_cast<const Value *>(rawData());
     }
 
     void writeToMessage(dbus::Message &msg) const;
 
-    const std::string &signature() const { return signature_; }
+    const std::string &signature() const;
 
-    void printData(LogMessageBuilder &builder) const {
-        if (helper_) {
-            helper_->print(builder, data_.get());
-        }
-    }
+    void printData(LogMessageBuilder &builder) const;
 
 private:
-    std::string signature_;
+    friend class Message;
+
+    // Read the value of a registered type from msg, the variant is only
+    // changed if it succeeds.
+    void readFromMessage(dbus::Message &msg, const VariantTypeInfo &type);
+
+    const void *rawData() const {
+        return data_ ? data_.get() : static_cast<const void *>(&inlineData_);
+    }
+
+    using InlineStorage =
+        std::aligned_storage_t<sizeof(uint64_t),
+                               std::max(alignof(uint64_t), alignof(double))>;
+
+    // Owned by the default registry, which outlives any variant, unlike
+    // statics of the library that set the value.
+    const VariantTypeInfo *type_ = nullptr;
     std::shared_ptr<void> data_;
-    std::shared_ptr<const VariantHelperBase> helper_;
+    // Used instead of data_ by types of VariantStoresInline.
+    InlineStorage inlineData_{};
 };
 
 template <typename Value, typename>
 void Variant::setData(Value &&value) {
     typedef std::remove_cv_t<std::remove_reference_t<Value>> value_type;
-    signature_ = DBusSignatureTraits<value_type>::signature::data();
-    data_ = std::make_shared<value_type>(std::forward<Value>(value));
-    helper_ = std::make_shared<VariantHelper<value_type>>();
+    // Only the pointer is cached here, the entry belongs to the registry.
+    static const VariantTypeInfo *type =
+        VariantTypeRegistry::defaultRegistry().typeForValue<value_type>();
+    type_ = type;
+    if constexpr (VariantStoresInline<value_type>::value) {
+        data_.reset();
+        new (&inlineData_) value_type(value);
+    } else {
+        data_ = std::make_shared<value_type>(std::forward<Value>(value));
+    }
 }
 
 static inline LogMessageBuilder &operator<<(LogMessageBuilder &builder,
@@ -0,0 +1,78 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#ifndef _FCITX_UTILS_DBUS_VARIANT_P_H_
+#define _FCITX_UTILS_DBUS_VARIANT_P_H_
+
+#include "variant.h"
+#include <shared_mutex>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+namespace fcitx {
+namespace dbus {
+
+// A registered variant type. Entries live as long as the registry, so it is
+// safe to keep plain pointers to them.
+struct VariantTypeInfo {
+    // Interned id of the signature, ids start from 1. Types that are not
+    // visible to lookup have id 0.
+    uint32_t id;
+    std::string signature;
+    std::shared_ptr<VariantHelperBase> helper;
+    // Whether the value is stored inside Variant.
+    bool storesInline;
+};
+
+class VariantTypeRegistryPrivate {
+public:
+    static VariantTypeRegistryPrivate &defaultRegistry() {
+        return *VariantTypeRegistry::defaultRegistry().d_func();
+    }
+
+    const VariantTypeInfo *registerType(const std::string &signature,
+                                        std::shared_ptr<VariantHelperBase>,
+                                        bool storesInline, bool listed);
+
+    // Find a registered type, return nullptr if signature is unknown.
+    // Recently seen signatures are cached per thread, so a hit neither hashes
+    // the string nor takes the lock.
+    const VariantTypeInfo *lookupTypeInfo(const std::string &signature) const;
+
+    // Return 0 if signature is unknown.
+    uint32_t lookupTypeId(const std::string &signature) const;
+
+    // Return the type registered with id, or nullptr if id is invalid.
+    const VariantTypeInfo *typeInfo(uint32_t id) const;
+
+private:
+    // Types are never unregistered, id - 1 is the index into types_.
+    std::vector<std::unique_ptr<VariantTypeInfo>> types_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    // Types that can only be set, not looked up. Keyed by helper type, since
+    // one signature may have many of them.
+    std::unordered_map<std::type_index, std::unique_ptr<VariantTypeInfo>>
+        unlistedTypes_;
+    mutable std::shared_timed_mutex mutex_;
+};
+
+} // namespace dbus
+} // namespace fcitx
+
+#endif // _FCITX_UTILS_DBUS_VARIANT_P_H_
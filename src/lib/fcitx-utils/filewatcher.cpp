@@ -0,0 +1,338 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "filewatcher.h"
+#include "event.h"
+#include "fs.h"
+#include "log.h"
+#include "misc_p.h"
+#include "stringutils.h"
+#include "unixfd.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fcitx {
+
+namespace {
+
+constexpr uint32_t watchMask = IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+                               IN_DELETE | IN_DELETE_SELF | IN_MODIFY |
+                               IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO |
+                               IN_ONLYDIR;
+
+// Directory itself is gone, every watch on it needs to be set up again.
+constexpr uint32_t selfMask = IN_DELETE_SELF | IN_IGNORED | IN_MOVE_SELF;
+
+// Entry under directory is added or removed.
+constexpr uint32_t entryMask =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+typedef std::function<void(const std::string &name, uint32_t mask)>
+    DirWatchCallback;
+
+} // namespace
+
+class FileWatchEntry;
+
+class FileWatcherPrivate {
+public:
+    FileWatcherPrivate(uint64_t delay)
+        : delay_(delay),
+          dirs_(
+              [this](const std::string &dir) {
+                  int wd = addWatch(dir);
+                  if (wd < 0) {
+                      return false;
+                  }
+                  dirToWd_[dir] = wd;
+                  wdToDirs_[wd].push_back(dir);
+                  return true;
+              },
+              [this](const std::string &dir) {
+                  auto iter = dirToWd_.find(dir);
+                  if (iter == dirToWd_.end()) {
+                      return;
+                  }
+                  removeWatchDir(iter->second, dir);
+                  dirToWd_.erase(iter);
+              }) {}
+
+    int addWatch(const std::string &dir) {
+        int wd = inotify_add_watch(fd_.fd(), dir.c_str(), watchMask);
+        // Directory may be gone in between, that is fine, but running out of
+        // watches means some changes are never reported.
+        if (wd < 0 && (errno == ENOSPC || errno == ENOMEM)) {
+            if (!exhausted_.exchange(true)) {
+                FCITX_WARN() << "Reached the limit of inotify watches.";
+            }
+        }
+        return wd;
+    }
+
+    void removeWatchDir(int wd, const std::string &dir) {
+        auto iter = wdToDirs_.find(wd);
+        if (iter == wdToDirs_.end()) {
+            return;
+        }
+        auto &dirs = iter->second;
+        dirs.erase(std::remove(dirs.begin(), dirs.end(), dir), dirs.end());
+        // Same directory may be watched through different paths, and they
+        // share the watch descriptor.
+        if (dirs.empty()) {
+            inotify_rm_watch(fd_.fd(), wd);
+            wdToDirs_.erase(iter);
+        }
+    }
+
+    std::unique_ptr<HandlerTableEntry<DirWatchCallback>>
+    watchDir(const std::string &dir, DirWatchCallback callback) {
+        auto entry = dirs_.add(dir, std::move(callback));
+        // Directory was removed and created again while it is still watched.
+        if (entry && dirToWd_[dir] < 0) {
+            int wd = addWatch(dir);
+            if (wd >= 0) {
+                dirToWd_[dir] = wd;
+                wdToDirs_[wd].push_back(dir);
+            }
+        }
+        return entry;
+    }
+
+    void schedule(FileWatchEntry *entry, bool rearm);
+    void handleEvents();
+    void dispatch();
+
+    UnixFD fd_;
+    uint64_t delay_;
+    std::unique_ptr<EventSourceIO> ioEvent_;
+    std::unique_ptr<EventSourceTime> timeEvent_;
+    MultiHandlerTable<std::string, DirWatchCallback> dirs_;
+    std::unordered_map<std::string, int> dirToWd_;
+    std::unordered_map<int, std::vector<std::string>> wdToDirs_;
+    std::unordered_set<FileWatchEntry *> entries_;
+    std::vector<FileWatchEntry *> pending_;
+    std::atomic<bool> exhausted_{false};
+};
+
+class FileWatchEntry : public HandlerTableEntry<FileWatchCallback> {
+public:
+    FileWatchEntry(FileWatcherPrivate *watcher, std::vector<std::string> paths,
+                   FileWatchCallback callback,
+                   const StandardPath *standardPath = nullptr)
+        : HandlerTableEntry<FileWatchCallback>(std::move(callback)),
+          watcher_(watcher), paths_(std::move(paths)),
+          standardPath_(standardPath) {
+        watcher_->entries_.insert(this);
+        arm();
+    }
+
+    ~FileWatchEntry() {
+        auto &pending = watcher_->pending_;
+        pending.erase(std::remove(pending.begin(), pending.end(), this),
+                      pending.end());
+        watcher_->entries_.erase(this);
+    }
+
+    void arm() {
+        std::vector<std::unique_ptr<HandlerTableEntry<DirWatchCallback>>>
+            watches;
+        auto add = [this, &watches](const std::string &dir,
+                                    DirWatchCallback callback) {
+            if (auto watch = watcher_->watchDir(dir, std::move(callback))) {
+                watches.push_back(std::move(watch));
+            }
+        };
+        for (const auto &path : paths_) {
+            if (fs::isdir(path)) {
+                add(path, [this](const std::string &, uint32_t mask) {
+                    watcher_->schedule(this, mask & selfMask);
+                });
+            }
+            // If path does not exist yet, wait for the missing directories
+            // to be created from the closest existing one.
+            auto child = path;
+            auto dir = fs::dirName(child);
+            while (dir != child && !fs::isdir(dir)) {
+                child = dir;
+                dir = fs::dirName(child);
+            }
+            bool missing = child != path;
+            add(dir, [this, name = fs::baseName(child), missing](
+                         const std::string &entry, uint32_t mask) {
+                if (mask & selfMask) {
+                    watcher_->schedule(this, true);
+                } else if (entry == name) {
+                    watcher_->schedule(this, missing || (mask & entryMask));
+                }
+            });
+        }
+        // Add new watches before dropping the old ones, so the unchanged
+        // directories are not removed from inotify in between.
+        watches_ = std::move(watches);
+    }
+
+    void setPending(bool rearm) {
+        rearm_ = rearm_ || rearm;
+        if (!pending_) {
+            pending_ = true;
+            watcher_->pending_.push_back(this);
+        }
+    }
+
+    void dispatch() {
+        pending_ = false;
+        if (rearm_) {
+            rearm_ = false;
+            arm();
+        }
+        // Make sure callback sees the new files.
+        if (standardPath_) {
+            for (const auto &path : paths_) {
+                standardPath_->invalidateCache(path);
+            }
+        }
+        // Callback may delete this entry, so do not call it in place.
+        auto callback = **handler_;
+        callback();
+    }
+
+private:
+    FileWatcherPrivate *watcher_;
+    std::vector<std::string> paths_;
+    const StandardPath *standardPath_;
+    std::vector<std::unique_ptr<HandlerTableEntry<DirWatchCallback>>>
+        watches_;
+    bool pending_ = false;
+    bool rearm_ = false;
+};
+
+void FileWatcherPrivate::schedule(FileWatchEntry *entry, bool rearm) {
+    entry->setPending(rearm);
+    // Restart the timer, so a burst of changes only results in one call.
+    timeEvent_->setNextInterval(delay_);
+    timeEvent_->setOneShot();
+}
+
+void FileWatcherPrivate::handleEvents() {
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t len;
+    while ((len = fs::safeRead(fd_.fd(), buffer, sizeof(buffer))) > 0) {
+        const char *end = buffer + len;
+        for (const char *ptr = buffer; ptr < end;) {
+            const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events are lost, assume everything changed.
+                for (auto *entry : entries_) {
+                    schedule(entry, true);
+                }
+                continue;
+            }
+
+            auto dirs = findValue(wdToDirs_, event->wd);
+            if (!dirs) {
+                continue;
+            }
+            std::string name = event->len ? event->name : "";
+            for (const auto &dir : *dirs) {
+                for (auto &callback : dirs_.view(dir)) {
+                    callback(name, event->mask);
+                }
+            }
+
+            if (event->mask & IN_IGNORED) {
+                // Kernel already removed the watch, keep the directory
+                // until its entries are gone, and mark it as not watched.
+                for (const auto &dir : *dirs) {
+                    dirToWd_[dir] = -1;
+                }
+                wdToDirs_.erase(event->wd);
+            }
+        }
+    }
+}
+
+void FileWatcherPrivate::dispatch() {
+    // Callbacks may add or remove entries, so take them one by one.
+    while (!pending_.empty()) {
+        auto *entry = pending_.front();
+        pending_.erase(pending_.begin());
+        entry->dispatch();
+    }
+}
+
+FileWatcher::FileWatcher(EventLoop *loop, uint64_t delay)
+    : d_ptr(std::make_unique<FileWatcherPrivate>(delay)) {
+    FCITX_D();
+    d->fd_.give(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (!d->fd_.isValid()) {
+        // Not fatal, files can still be reloaded by hand.
+        FCITX_WARN() << "Failed to create inotify fd, files are not watched.";
+    } else {
+        d->ioEvent_ = loop->addIOEvent(
+            d->fd_.fd(), IOEventFlag::In,
+            [d](EventSourceIO *, int, IOEventFlags) {
+                d->handleEvents();
+                return true;
+            });
+    }
+    d->timeEvent_ = loop->addTimeEvent(CLOCK_MONOTONIC, now(CLOCK_MONOTONIC),
+                                       0, [d](EventSourceTime *, uint64_t) {
+                                           d->dispatch();
+                                           return true;
+                                       });
+    d->timeEvent_->setEnabled(false);
+}
+
+FileWatcher::~FileWatcher() {}
+
+bool FileWatcher::isValid() const {
+    FCITX_D();
+    return d->fd_.isValid() && !d->exhausted_;
+}
+
+std::unique_ptr<HandlerTableEntry<FileWatchCallback>>
+FileWatcher::watch(const std::string &path, FileWatchCallback callback) {
+    FCITX_D();
+    return std::make_unique<FileWatchEntry>(
+        d, std::vector<std::string>{fs::cleanPath(path)}, std::move(callback));
+}
+
+std::unique_ptr<HandlerTableEntry<FileWatchCallback>>
+FileWatcher::watch(StandardPath::Type type, const std::string &path,
+                   FileWatchCallback callback,
+                   const StandardPath &standardPath) {
+    FCITX_D();
+    std::vector<std::string> paths;
+    standardPath.scanDirectories(
+        type, [&paths, &path](const std::string &dir, bool) {
+            paths.push_back(fs::cleanPath(stringutils::joinPath(dir, path)));
+            return true;
+        });
+    return std::make_unique<FileWatchEntry>(d, std::move(paths),
+                                            std::move(callback), &standardPath);
+}
+
+} // namespace fcitx
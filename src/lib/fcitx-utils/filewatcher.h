@@ -0,0 +1,95 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#ifndef _FCITX_UTILS_FILEWATCHER_H_
+#define _FCITX_UTILS_FILEWATCHER_H_
+
+#include "fcitxutils_export.h"
+#include <fcitx-utils/handlertable.h>
+#include <fcitx-utils/macros.h>
+#include <fcitx-utils/standardpath.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace fcitx {
+
+class EventLoop;
+class FileWatcherPrivate;
+
+typedef std::function<void()> FileWatchCallback;
+
+/**
+ * Watch files with inotify from an EventLoop.
+ *
+ * Editors and safeSave usually produce a burst of events for a single change,
+ * so callbacks are not called for every event. A callback is called once
+ * after there is no change to any of its files for a short delay.
+ *
+ * Watch entries must not outlive the FileWatcher.
+ */
+class FCITXUTILS_EXPORT FileWatcher {
+public:
+    /**
+     * Construct a file watcher attached to loop. If inotify is not
+     * available, callbacks are never called.
+     *
+     * @param loop event loop to attach to.
+     * @param delay time in usec to wait for more changes before calling the
+     * callback.
+     */
+    FileWatcher(EventLoop *loop, uint64_t delay = 200000);
+    virtual ~FileWatcher();
+
+    /**
+     * Whether changes are reported. It is false if inotify is not available,
+     * or the limit of watches is reached, in which case users should not
+     * rely on the callbacks to keep any cache up to date. Can be called from
+     * any thread.
+     */
+    bool isValid() const;
+
+    /**
+     * Watch a file or directory by absolute path.
+     *
+     * The path does not need to exist. Creation, removal and modification of
+     * the path are reported. If path is a directory, change to any file
+     * directly under it is also reported.
+     */
+    FCITX_NODISCARD std::unique_ptr<HandlerTableEntry<FileWatchCallback>>
+    watch(const std::string &path, FileWatchCallback callback);
+
+    /**
+     * Watch path under every directory of type, including the user
+     * directory. It is the set of files that StandardPath::open and
+     * StandardPath::multiOpen may return. Cached listing of the watched
+     * directories in standardPath is dropped before callback is called.
+     */
+    FCITX_NODISCARD std::unique_ptr<HandlerTableEntry<FileWatchCallback>>
+    watch(StandardPath::Type type, const std::string &path,
+          FileWatchCallback callback,
+          const StandardPath &standardPath = StandardPath::global());
+
+private:
+    const std::unique_ptr<FileWatcherPrivate> d_ptr;
+    FCITX_DECLARE_PRIVATE(FileWatcher);
+};
+
+} // namespace fcitx
+
+#endif // _FCITX_UTILS_FILEWATCHER_H_
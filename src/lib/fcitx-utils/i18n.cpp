@@ -3,6 +3,8 @@
 #include "fcitxutils_export.h"
 #include "log.h"
 #include "standardpath.h"
+#include <clocale>
+#include <cstdlib>
 #include <libintl.h>
 #include <mutex>
 #include <string>
@@ -86,4 +88,15 @@ translateDomainCtx(const char *domain, const char *ctx, const char *s) {
 FCITXUTILS_EXPORT void registerDomain(const char *domain, const char *dir) {
     gettextManager.addDomain(domain, dir);
 }
+FCITXUTILS_EXPORT std::string messagesLocale() {
+    std::string locale;
+    if (const char *lc = setlocale(LC_MESSAGES, nullptr)) {
+        locale = lc;
+    }
+    if (const char *language = getenv("LANGUAGE")) {
+        locale.push_back(':');
+        locale.append(language);
+    }
+    return locale;
+}
 } // namespace fcitx
@@ -36,6 +36,10 @@ std::string translateDomainCtx(const char *domain, const char *ctx,
 const char *translateDomainCtx(const char *domain, const char *ctx,
                                const char *s);
 void registerDomain(const char *domain, const char *dir);
+
+/// LC_MESSAGES and LANGUAGE joined by ':', what gettext uses to pick a
+/// translation. Useful to tell whether cached translated text is stale.
+std::string messagesLocale();
 } // namespace fcitx
 
 #ifndef FCITX_NO_I18N_MACRO
@@ -18,17 +18,137 @@
 //
 
 #include "library.h"
-#include "stringutils.h"
+#include "unixfd.h"
 #include <cstring>
 #include <dlfcn.h>
+#include <elf.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <vector>
 
 namespace fcitx {
 
+namespace {
+
+bool readAt(int fd, void *buffer, size_t size, off_t offset) {
+    auto *ptr = static_cast<char *>(buffer);
+    while (size) {
+        auto ret = pread(fd, ptr, size, offset);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        ptr += ret;
+        size -= ret;
+        offset += ret;
+    }
+    return true;
+}
+
+// Whether [offset, offset + size) lies within [0, limit).
+bool inRange(uint64_t offset, uint64_t size, uint64_t limit) {
+    return offset <= limit && size <= limit - offset;
+}
+
+// Only the headers and the dynamic symbol table are read, instead of the
+// whole file. The content of symbol is stored in data with a trailing NUL.
+// Sizes come from the file, so they are checked against the file size before
+// anything is allocated.
+template <typename Ehdr, typename Shdr, typename Sym>
+bool readElfSymbol(int fd, uint64_t fileSize, const char *name,
+                   std::vector<char> &data) {
+    Ehdr ehdr;
+    if (!readAt(fd, &ehdr, sizeof(ehdr), 0) ||
+        ehdr.e_shentsize != sizeof(Shdr) || ehdr.e_shnum == 0 ||
+        !inRange(ehdr.e_shoff, uint64_t(ehdr.e_shnum) * sizeof(Shdr),
+                fileSize)) {
+        return false;
+    }
+    std::vector<Shdr> shdrs(ehdr.e_shnum);
+    if (!readAt(fd, shdrs.data(), shdrs.size() * sizeof(Shdr),
+                ehdr.e_shoff)) {
+        return false;
+    }
+    for (const auto &shdr : shdrs) {
+        if (shdr.sh_type != SHT_DYNSYM || shdr.sh_entsize != sizeof(Sym) ||
+            shdr.sh_link >= shdrs.size()) {
+            continue;
+        }
+        const auto &strtab = shdrs[shdr.sh_link];
+        if (!inRange(shdr.sh_offset, shdr.sh_size, fileSize) ||
+            !inRange(strtab.sh_offset, strtab.sh_size, fileSize)) {
+            return false;
+        }
+        std::vector<Sym> symbols(shdr.sh_size / sizeof(Sym));
+        // Extra NUL in case the string table is not terminated.
+        std::vector<char> names(strtab.sh_size + 1, '\0');
+        if (!readAt(fd, symbols.data(), symbols.size() * sizeof(Sym),
+                    shdr.sh_offset) ||
+            !readAt(fd, names.data(), strtab.sh_size, strtab.sh_offset)) {
+            return false;
+        }
+        for (const auto &symbol : symbols) {
+            if (symbol.st_name >= strtab.sh_size ||
+                strcmp(&names[symbol.st_name], name) != 0) {
+                continue;
+            }
+            if (symbol.st_shndx == SHN_UNDEF ||
+                symbol.st_shndx >= shdrs.size()) {
+                return false;
+            }
+            // Map the address of symbol back to the offset in file.
+            const auto &section = shdrs[symbol.st_shndx];
+            if (section.sh_type == SHT_NOBITS ||
+                symbol.st_value < section.sh_addr ||
+                !inRange(section.sh_offset, section.sh_size, fileSize)) {
+                return false;
+            }
+            auto offset = symbol.st_value - section.sh_addr;
+            if (!inRange(offset, symbol.st_size, section.sh_size)) {
+                return false;
+            }
+            data.assign(symbol.st_size + 1, '\0');
+            return readAt(fd, data.data(), symbol.st_size,
+                          section.sh_offset + offset);
+        }
+    }
+    return false;
+}
+
+bool readElfSymbol(int fd, const char *name, std::vector<char> &data) {
+    struct stat stat;
+    if (fstat(fd, &stat) != 0) {
+        return false;
+    }
+    unsigned char ident[EI_NIDENT];
+    if (!readAt(fd, ident, sizeof(ident), 0) ||
+        memcmp(ident, ELFMAG, SELFMAG) != 0) {
+        return false;
+    }
+    const uint16_t endian = 1;
+    const auto native = *reinterpret_cast<const unsigned char *>(&endian) == 1
+                            ? ELFDATA2LSB
+                            : ELFDATA2MSB;
+    if (ident[EI_DATA] != native) {
+        return false;
+    }
+    if (ident[EI_CLASS] == ELFCLASS64) {
+        return readElfSymbol<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(
+            fd, stat.st_size, name, data);
+    }
+    if (ident[EI_CLASS] == ELFCLASS32) {
+        return readElfSymbol<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(
+            fd, stat.st_size, name, data);
+    }
+    return false;
+}
+
+} // namespace
+
 class LibraryPrivate {
 public:
     LibraryPrivate(const std::string &path) : path_(path), handle_(nullptr) {}
@@ -94,6 +214,22 @@ bool Library::unload() {
     return d->unload();
 }
 
+bool Library::prefetch() {
+    FCITX_D();
+    UnixFD fd = UnixFD::own(open(d->path_.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.isValid()) {
+        d->error_ = strerror(errno);
+        return false;
+    }
+    // Pages are read asynchronously, closing the file does not cancel it.
+    int ret = posix_fadvise(fd.fd(), 0, 0, POSIX_FADV_WILLNEED);
+    if (ret != 0) {
+        d->error_ = strerror(ret);
+        return false;
+    }
+    return true;
+}
+
 void *Library::resolve(const char *name) {
     FCITX_D();
     auto result = dlsym(d->handle_, name);
@@ -121,52 +257,26 @@ bool Library::findData(const char *slug, const char *magic, size_t lenOfMagic,
         return true;
     }
 
-    int fd = open(d->path_.c_str(), O_RDONLY);
-    if (fd < 0) {
+    UnixFD fd = UnixFD::own(open(d->path_.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.isValid()) {
         d->error_ = strerror(errno);
         return false;
     }
 
-    void *needfree = nullptr;
-    bool result = false;
-    do {
-        struct stat statbuf;
-        int statresult = fstat(fd, &statbuf);
-        if (statresult < 0) {
-            d->error_ = strerror(errno);
-            break;
-        }
-        void *needunmap = nullptr;
-        void *data = needunmap =
-            mmap(0, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-        if (!data) {
-            data = malloc(statbuf.st_size);
-            needfree = data;
-            if (!data) {
-                break;
-            }
-            if (read(fd, data, statbuf.st_size) != statbuf.st_size) {
-                break;
-            }
-        }
-        const char *pos = stringutils::backwardSearch(
-            static_cast<char *>(data), static_cast<size_t>(statbuf.st_size),
-            magic, lenOfMagic, 0);
-        pos += lenOfMagic;
-
-        if (parser) {
-            parser(pos);
-        }
-        result = true;
-        if (needunmap) {
-            munmap(needunmap, statbuf.st_size);
-        }
-    } while (0);
-
-    close(fd);
-    free(needfree);
-
-    return result;
+    std::vector<char> data;
+    if (!readElfSymbol(fd.fd(), slug, data)) {
+        d->error_ = "Failed to find symbol in ELF dynamic symbol table.";
+        return false;
+    }
+    // data always has a trailing NUL.
+    if (data.size() <= lenOfMagic ||
+        memcmp(data.data(), magic, lenOfMagic) != 0) {
+        return false;
+    }
+    if (parser) {
+        parser(data.data() + lenOfMagic);
+    }
+    return true;
 }
 
 std::string Library::error() {
@@ -51,9 +51,15 @@ public:
     bool loaded() const;
     bool load(Flags<LibraryLoadHint> hint = LibraryLoadHint::DefaultHint);
     bool unload();
+    /// Ask the system to start reading the library file in background, so a
+    /// following load() does not have to wait for the disk.
+    bool prefetch();
     void *resolve(const char *name);
+    /// Find the data exported as symbol slug and starting with magic, pass
+    /// the data after magic to parser. If library is not loaded, the symbol
+    /// is looked up from the dynamic symbol table of the ELF file.
     bool findData(const char *slug, const char *magic, size_t lenOfMagic,
-                  std::function<void(const char *data)> library);
+                  std::function<void(const char *data)> parser);
     std::string error();
 
     template <typename Func>
@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <dirent.h>
 #include <fcntl.h>
+#include <mutex>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -45,6 +46,41 @@ std::string constructPath(const std::string &basepath,
     }
     return fs::cleanPath(stringutils::joinPath(basepath, path));
 }
+
+void closedir0(DIR *dir) {
+    if (dir) {
+        closedir(dir);
+    }
+}
+
+struct DirectoryListing {
+    // Entries in readdir order, empty if directory does not exist.
+    std::vector<std::string> names;
+    // Whether an entry is a regular file, or a symlink to one.
+    std::unordered_map<std::string, bool> isFile;
+};
+
+DirectoryListing readDirectoryListing(const std::string &path) {
+    DirectoryListing listing;
+    std::unique_ptr<DIR, decltype(closedir0) *> scopedDir{
+        opendir(path.c_str()), closedir0};
+    if (!scopedDir) {
+        return listing;
+    }
+    struct dirent *drt;
+    while ((drt = readdir(scopedDir.get())) != nullptr) {
+        if (strcmp(drt->d_name, ".") == 0 || strcmp(drt->d_name, "..") == 0) {
+            continue;
+        }
+        listing.names.emplace_back(drt->d_name);
+        bool isReg = drt->d_type == DT_REG;
+        if (drt->d_type == DT_LNK || drt->d_type == DT_UNKNOWN) {
+            isReg = fs::isreg(constructPath(path, drt->d_name));
+        }
+        listing.isFile.emplace(listing.names.back(), isReg);
+    }
+    return listing;
+}
 } // namespace
 
 StandardPathFile::~StandardPathFile() {}
@@ -112,8 +148,6 @@ public:
             defaultPaths("FCITX_ADDON_DIRS", FCITX_INSTALL_ADDONDIR, nullptr);
     }
 
-    FCITX_INLINE_DEFINE_DEFAULT_DTOR_AND_COPY(StandardPathPrivate)
-
     // http://standards.freedesktop.org/basedir-spec/basedir-spec-latest.html
     std::string defaultPath(const char *env, const char *defaultPath) {
         char *cdir = getenv(env);
@@ -223,6 +257,38 @@ public:
         }
     }
 
+    // Return nullptr if cache is disabled, or dir is not cacheable.
+    std::shared_ptr<const DirectoryListing>
+    cachedListing(const std::string &dir, bool cacheable) const {
+        if (!cacheable) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        if (!cacheEnabled_) {
+            return nullptr;
+        }
+        auto &listing = cache_[dir];
+        if (!listing) {
+            listing = std::make_shared<const DirectoryListing>(
+                readDirectoryListing(dir));
+        }
+        return listing;
+    }
+
+    // Return false only if cache knows path does not exist.
+    bool mayExist(const std::string &path, bool cacheable) const {
+        auto listing = cachedListing(fs::dirName(path), cacheable);
+        return !listing || listing->isFile.count(fs::baseName(path));
+    }
+
+    bool isFile(const std::string &path, bool cacheable) const {
+        if (auto listing = cachedListing(fs::dirName(path), cacheable)) {
+            auto iter = listing->isFile.find(fs::baseName(path));
+            return iter != listing->isFile.end() && iter->second;
+        }
+        return fs::isreg(path);
+    }
+
     std::string configHome_;
     std::vector<std::string> configDirs_;
     std::string pkgconfigHome_;
@@ -234,6 +300,15 @@ public:
     std::string cacheHome_;
     std::string runtimeDir_;
     std::vector<std::string> addonDirs_;
+
+    // Users directories are written by fcitx itself, so only system
+    // directories are cached.
+    mutable std::mutex cacheMutex_;
+    mutable bool cacheEnabled_ = false;
+    mutable uint64_t cacheGeneration_ = 0;
+    mutable std::unordered_map<std::string,
+                               std::shared_ptr<const DirectoryListing>>
+        cache_;
 };
 
 StandardPath::StandardPath(bool skipFcitxPath)
@@ -280,12 +355,6 @@ std::string StandardPath::fcitxPath(const char *path, const char *subPath) {
     return stringutils::joinPath(fcitxPath(path), subPath);
 }
 
-void closedir0(DIR *dir) {
-    if (dir) {
-        closedir(dir);
-    }
-}
-
 std::string StandardPath::userDirectory(Type type) const {
     FCITX_D();
     return d->userPath(type);
@@ -296,6 +365,36 @@ std::vector<std::string> StandardPath::directories(Type type) const {
     return d->directories(type);
 }
 
+void StandardPath::setCacheEnabled(bool enabled) const {
+    FCITX_D();
+    std::lock_guard<std::mutex> lock(d->cacheMutex_);
+    d->cacheEnabled_ = enabled;
+    d->cache_.clear();
+    d->cacheGeneration_++;
+}
+
+void StandardPath::invalidateCache() const {
+    FCITX_D();
+    std::lock_guard<std::mutex> lock(d->cacheMutex_);
+    d->cache_.clear();
+    d->cacheGeneration_++;
+}
+
+void StandardPath::invalidateCache(const std::string &path) const {
+    FCITX_D();
+    auto cleanPath = fs::cleanPath(path);
+    std::lock_guard<std::mutex> lock(d->cacheMutex_);
+    d->cache_.erase(cleanPath);
+    d->cache_.erase(fs::dirName(cleanPath));
+    d->cacheGeneration_++;
+}
+
+uint64_t StandardPath::cacheGeneration() const {
+    FCITX_D();
+    std::lock_guard<std::mutex> lock(d->cacheMutex_);
+    return d->cacheGeneration_;
+}
+
 void StandardPath::scanDirectories(
     Type type,
     std::function<bool(const std::string &path, bool user)> scanner) const {
@@ -330,7 +429,17 @@ void StandardPath::scanFiles(
     std::function<bool(const std::string &fileName, const std::string &dir,
                        bool user)>
         scanner) const {
-    auto scanDir = [scanner](const std::string &fullPath, bool isUser) {
+    FCITX_D();
+    auto scanDir = [d, scanner](const std::string &fullPath, bool isUser,
+                                bool cacheable) {
+        if (auto listing = d->cachedListing(fullPath, cacheable)) {
+            for (const auto &name : listing->names) {
+                if (!scanner(name, fullPath, isUser)) {
+                    return false;
+                }
+            }
+            return true;
+        }
         std::unique_ptr<DIR, decltype(closedir0) *> scopedDir{
             opendir(fullPath.c_str()), closedir0};
         if (scopedDir) {
@@ -350,58 +459,61 @@ void StandardPath::scanFiles(
         return true;
     };
     if (isAbsolutePath(path)) {
-        scanDir(path, false);
+        scanDir(path, false, false);
     } else {
         scanDirectories(
             type, [&path, &scanDir](const std::string &dirPath, bool isUser) {
                 auto fullPath = constructPath(dirPath, path);
-                return scanDir(fullPath, isUser);
+                return scanDir(fullPath, isUser, !isUser);
             });
     }
 }
 
 std::string StandardPath::locate(Type type, const std::string &path) const {
+    FCITX_D();
     std::string retPath;
     if (isAbsolutePath(path)) {
         if (fs::isreg(path)) {
             retPath = path;
         }
     } else {
-        scanDirectories(type,
-                        [&retPath, &path](const std::string &dirPath, bool) {
-                            auto fullPath = constructPath(dirPath, path);
-                            if (!fs::isreg(fullPath)) {
-                                return true;
-                            }
-                            retPath = fullPath;
-                            return false;
-                        });
+        scanDirectories(type, [d, &retPath, &path](const std::string &dirPath,
+                                                   bool isUser) {
+            auto fullPath = constructPath(dirPath, path);
+            if (!d->isFile(fullPath, !isUser)) {
+                return true;
+            }
+            retPath = fullPath;
+            return false;
+        });
     }
     return retPath;
 }
 
 std::vector<std::string>
 StandardPath::locateAll(Type type, const std::string &path) const {
+    FCITX_D();
     std::vector<std::string> retPaths;
     if (isAbsolutePath(path)) {
         if (fs::isreg(path)) {
             retPaths.push_back(path);
         }
     } else {
-        scanDirectories(type,
-                        [&retPaths, &path](const std::string &dirPath, bool) {
-                            auto fullPath = constructPath(dirPath, path);
-                            if (fs::isreg(fullPath)) {
-                                retPaths.push_back(fullPath);
-                            }
-                            return true;
-                        });
+        scanDirectories(type, [d, &retPaths, &path](const std::string &dirPath,
+                                                    bool isUser) {
+            auto fullPath = constructPath(dirPath, path);
+            if (d->isFile(fullPath, !isUser)) {
+                retPaths.push_back(fullPath);
+            }
+            return true;
+        });
     }
     return retPaths;
 }
 
 StandardPathFile StandardPath::open(Type type, const std::string &path,
                                     int flags) const {
+    FCITX_D();
     int retFD = -1;
     std::string fdPath;
     if (isAbsolutePath(path)) {
@@ -411,9 +523,12 @@ StandardPathFile StandardPath::open(Type type, const std::string &path,
             fdPath = path;
         }
     } else {
-        scanDirectories(type, [flags, &retFD, &fdPath,
-                               &path](const std::string &dirPath, bool) {
+        scanDirectories(type, [d, flags, &retFD, &fdPath, &path](
+                                  const std::string &dirPath, bool isUser) {
             auto fullPath = constructPath(dirPath, path);
+            if (!d->mayExist(fullPath, !isUser)) {
+                return true;
+            }
             int fd = ::open(fullPath.c_str(), flags);
             if (fd < 0) {
                 return true;
@@ -450,6 +565,7 @@ StandardPathFile StandardPath::openUser(Type type, const std::string &path,
 std::vector<StandardPathFile> StandardPath::openAll(StandardPath::Type type,
                                                     const std::string &path,
                                                     int flags) const {
+    FCITX_D();
     std::vector<StandardPathFile> result;
     if (isAbsolutePath(path)) {
         int fd = ::open(path.c_str(), flags);
@@ -457,9 +573,12 @@ std::vector<StandardPathFile> StandardPath::openAll(StandardPath::Type type,
             result.emplace_back(fd, path);
         }
     } else {
-        scanDirectories(
-            type, [flags, &result, &path](const std::string &dirPath, bool) {
+        scanDirectories(type, [d, flags, &result, &path](
+                                  const std::string &dirPath, bool isUser) {
                 auto fullPath = constructPath(dirPath, path);
+                if (!d->mayExist(fullPath, !isUser)) {
+                    return true;
+                }
                 int fd = ::open(fullPath.c_str(), flags);
                 if (fd < 0) {
                     return true;
@@ -36,6 +36,7 @@
 #include <fcitx-utils/macros.h>
 #include <fcitx-utils/stringutils.h>
 #include <fcitx-utils/unixfd.h>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
@@ -223,6 +224,26 @@ public:
     /// \brief Get all directories in the order of priority.
     std::vector<std::string> directories(Type type) const;
 
+    /// \brief Cache directory listing of non-user directories.
+    ///
+    /// Once enabled, scanFiles, locate, locateAll, open, openAll, multiOpen
+    /// and multiOpenAll read a system directory only once, and reuse the
+    /// listing until the cache is invalidated. User directories are always
+    /// read from disk. Cache is disabled by default.
+    ///
+    /// The cache does not change what any lookup returns, so it is logically
+    /// mutable and can be controlled through the const global() instance.
+    void setCacheEnabled(bool enabled) const;
+
+    /// \brief Drop all the cached directory listing.
+    void invalidateCache() const;
+
+    /// \brief Drop the cached listing of path and its parent directory.
+    void invalidateCache(const std::string &path) const;
+
+    /// \brief Return a number that increases whenever cache is invalidated.
+    uint64_t cacheGeneration() const;
+
     /// \brief Check if a file exists.
     std::string locate(Type type, const std::string &path) const;
 
@@ -26,29 +26,89 @@ namespace fcitx {
 
 AddonLoader::~AddonLoader() {}
 
+void AddonLoader::prepare(const AddonInfo &) {}
+
+void AddonLoader::prefetch(const AddonInfo &) {}
+
+void AddonLoader::unprepare(const AddonInfo &) {}
+
 SharedLibraryLoader::~SharedLibraryLoader() {}
 
+std::vector<std::string>
+SharedLibraryLoader::locateLibrary(const AddonInfo &info) const {
+    return standardPath_.locateAll(StandardPath::Type::Addon,
+                                   info.library() + FCITX_LIBRARY_SUFFIX);
+}
+
+Library SharedLibraryLoader::openLibrary(const AddonInfo &info) const {
+    for (const auto &libraryPath : locateLibrary(info)) {
+        Library lib(libraryPath);
+        if (!lib.load()) {
+            FCITX_LOG(Error)
+                << "Failed to load library for addon " << info.uniqueName()
+                << " on " << libraryPath << ". Error: " << lib.error();
+            continue;
+        }
+        return lib;
+    }
+    return {};
+}
+
+void SharedLibraryLoader::prepare(const AddonInfo &info) {
+    // Also remember the failure, so load() does not try again.
+    auto lib = openLibrary(info);
+    std::lock_guard<std::mutex> lock(mutex_);
+    preloaded_.emplace(info.uniqueName(), std::move(lib));
+}
+
+void SharedLibraryLoader::prefetch(const AddonInfo &info) {
+    // Only the library that openLibrary tries first is worth reading.
+    auto libs = locateLibrary(info);
+    if (!libs.empty()) {
+        Library(libs.front()).prefetch();
+    }
+}
+
+void SharedLibraryLoader::unprepare(const AddonInfo &info) {
+    Library lib;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto preloaded = preloaded_.find(info.uniqueName());
+        if (preloaded == preloaded_.end()) {
+            return;
+        }
+        lib = std::move(preloaded->second);
+        preloaded_.erase(preloaded);
+    }
+    // Unload outside the lock, dlclose runs the static destructors.
+    lib.unload();
+}
+
 AddonInstance *SharedLibraryLoader::load(const AddonInfo &info,
                                          AddonManager *manager) {
     auto iter = registry_.find(info.uniqueName());
     if (iter == registry_.end()) {
-        auto libs = standardPath_.locateAll(
-            StandardPath::Type::Addon, info.library() + FCITX_LIBRARY_SUFFIX);
-        for (const auto &libraryPath : libs) {
-            Library lib(libraryPath);
-            if (!lib.load()) {
-                FCITX_LOG(Error)
-                    << "Failed to load library for addon " << info.uniqueName()
-                    << " on " << libraryPath << ". Error: " << lib.error();
-                continue;
+        Library lib;
+        bool prepared = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto preloaded = preloaded_.find(info.uniqueName());
+            if (preloaded != preloaded_.end()) {
+                lib = std::move(preloaded->second);
+                preloaded_.erase(preloaded);
+                prepared = true;
             }
+        }
+        if (!prepared) {
+            lib = openLibrary(info);
+        }
+        if (lib.loaded()) {
             try {
                 registry_.emplace(
                     info.uniqueName(),
                     std::make_unique<SharedLibraryFactory>(std::move(lib)));
             } catch (const std::exception &e) {
             }
-            break;
         }
         iter = registry_.find(info.uniqueName());
     }
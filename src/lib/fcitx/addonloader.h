@@ -38,6 +38,17 @@ public:
     virtual std::string type() const = 0;
     virtual AddonInstance *load(const AddonInfo &info,
                                 AddonManager *manager) = 0;
+    /// Do the part of load that does not need the manager ahead of time, e.g.
+    /// opening the library. It may be called from a worker thread, so static
+    /// initializers of the library run there, and load() may still be called
+    /// for an addon that is never prepared.
+    virtual void prepare(const AddonInfo &info);
+    /// Hint that the addon is going to be loaded soon, e.g. start reading the
+    /// library from disk. It is called for all addons to load before any of
+    /// them is prepared, so it should return quickly.
+    virtual void prefetch(const AddonInfo &info);
+    /// Drop what prepare() kept for an addon that is not going to be loaded.
+    virtual void unprepare(const AddonInfo &info);
 };
 } // namespace fcitx
 
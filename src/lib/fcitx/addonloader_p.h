@@ -26,6 +26,9 @@
 #include "fcitx-utils/library.h"
 #include "fcitx-utils/standardpath.h"
 #include <exception>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace fcitx {
 
@@ -54,13 +57,22 @@ class SharedLibraryLoader : public AddonLoader {
 public:
     ~SharedLibraryLoader();
     AddonInstance *load(const AddonInfo &info, AddonManager *manager) override;
+    void prepare(const AddonInfo &info) override;
+    void unprepare(const AddonInfo &info) override;
+    void prefetch(const AddonInfo &info) override;
 
     std::string type() const override { return "SharedLibrary"; }
 
 private:
+    std::vector<std::string> locateLibrary(const AddonInfo &info) const;
+    Library openLibrary(const AddonInfo &info) const;
+
     StandardPath standardPath_;
     std::unordered_map<std::string, std::unique_ptr<SharedLibraryFactory>>
         registry_;
+    // Libraries opened by prepare(), guarded by mutex_.
+    std::mutex mutex_;
+    std::unordered_map<std::string, Library> preloaded_;
 };
 
 class StaticLibraryLoader : public AddonLoader {
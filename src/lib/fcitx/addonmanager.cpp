@@ -20,11 +20,16 @@
 #include "addonmanager.h"
 #include "addonloader.h"
 #include "addonloader_p.h"
-#include "fcitx-config/iniparser.h"
+#include "fcitx-utils/event.h"
 #include "fcitx-utils/log.h"
 #include "instance.h"
+#include "metadatacache_p.h"
 #include "misc_p.h"
-#include <fcntl.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <unistd.h>
 #include <unordered_map>
 #include <unordered_set>
@@ -62,11 +67,83 @@ private:
     std::unique_ptr<AddonInstance> instance_;
 };
 
-enum class DependencyCheckStatus {
-    Satisfied,
-    Pending,
-    PendingUpdateRequest,
-    Failed
+// Runs AddonLoader::prepare for addons in load order on worker threads, so
+// the main thread only has to construct them.
+class AddonPreloader {
+public:
+    using Job = std::pair<AddonLoader *, const AddonInfo *>;
+
+    AddonPreloader(std::vector<Job> jobs)
+        : jobs_(std::move(jobs)), done_(jobs_.size(), false),
+          prepareTime_(jobs_.size(), 0) {
+        // Not worth a thread, e.g. a single on demand addon.
+        if (jobs_.size() < 2) {
+            return;
+        }
+        // Let the disk read all of them at once, instead of one by one when
+        // each addon is prepared.
+        for (const auto &job : jobs_) {
+            if (job.first) {
+                job.first->prefetch(*job.second);
+            }
+        }
+        size_t threads = std::min<size_t>(
+            {std::max(std::thread::hardware_concurrency(), 1U), maxThreads,
+             jobs_.size()});
+        for (size_t i = 0; i < threads; i++) {
+            threads_.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~AddonPreloader() {
+        next_ = jobs_.size();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void wait(size_t index) {
+        if (threads_.empty()) {
+            prepare(index);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this, index]() { return done_[index]; });
+    }
+
+    // Time spent in prepare in microseconds, only valid after wait(index).
+    uint64_t prepareTime(size_t index) const { return prepareTime_[index]; }
+
+private:
+    static constexpr size_t maxThreads = 4;
+
+    void run() {
+        size_t index;
+        while ((index = next_++) < jobs_.size()) {
+            prepare(index);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_[index] = true;
+            }
+            condition_.notify_all();
+        }
+    }
+
+    void prepare(size_t index) {
+        if (auto loader = jobs_[index].first) {
+            auto start = now(CLOCK_MONOTONIC);
+            loader->prepare(*jobs_[index].second);
+            prepareTime_[index] = now(CLOCK_MONOTONIC) - start;
+        }
+    }
+
+    std::vector<Job> jobs_;
+    std::vector<bool> done_;
+    std::vector<uint64_t> prepareTime_;
+    std::atomic<size_t> next_{0};
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<std::thread> threads_;
 };
 
 class AddonManagerPrivate {
@@ -81,37 +158,89 @@ public:
         return nullptr;
     }
 
-    DependencyCheckStatus checkDependencies(const Addon &a) {
-        auto &dependencies = a.info().dependencies();
-        for (auto &dependency : dependencies) {
-            Addon *dep = addon(dependency);
-            if (!dep || !dep->isLoadable()) {
-                return DependencyCheckStatus::Failed;
-            }
+    bool wantLoad(const Addon &addon) const {
+        return !addon.loaded() && addon.isLoadable() &&
+               (!addon.info().onDemand() ||
+                requested_.count(addon.info().uniqueName()));
+    }
 
-            if (!dep->loaded()) {
-                if (dep->info().onDemand() &&
-                    requested_.insert(dep->info().uniqueName()).second) {
-                    return DependencyCheckStatus::PendingUpdateRequest;
+    // Collect the addons that need to be loaded, and sort them so every addon
+    // comes after what it depends on.
+    std::vector<Addon *> resolveLoadOrder() {
+        std::vector<Addon *> addons;
+        std::unordered_map<Addon *, size_t> index;
+        for (auto &item : addons_) {
+            if (wantLoad(*item.second)) {
+                index.emplace(item.second.get(), addons.size());
+                addons.push_back(item.second.get());
+            }
+        }
+        // Pull in the on demand addons that are required by others.
+        for (size_t i = 0; i < addons.size(); i++) {
+            for (auto &dependency : addons[i]->info().dependencies()) {
+                Addon *dep = addon(dependency);
+                if (dep && !dep->loaded() && dep->isLoadable() &&
+                    !index.count(dep)) {
+                    requested_.insert(dep->info().uniqueName());
+                    index.emplace(dep, addons.size());
+                    addons.push_back(dep);
                 }
-                return DependencyCheckStatus::Pending;
             }
         }
-        auto &optionalDependencies = a.info().optionalDependencies();
-        for (auto &dependency : optionalDependencies) {
-            Addon *dep = addon(dependency);
-            // if not available, don't bother load it
-            if (!dep || !dep->isLoadable()) {
-                continue;
+
+        std::vector<size_t> inDegree(addons.size(), 0);
+        std::vector<std::vector<size_t>> dependents(addons.size());
+        auto addEdge = [&](const std::string &dependency, size_t i) {
+            if (auto dep = findValue(index, addon(dependency))) {
+                dependents[*dep].push_back(i);
+                inDegree[i]++;
+            }
+        };
+        for (size_t i = 0; i < addons.size(); i++) {
+            for (auto &dependency : addons[i]->info().dependencies()) {
+                addEdge(dependency, i);
             }
+            // Optional dependencies are only waited for if they are going to
+            // be loaded anyway.
+            for (auto &dependency : addons[i]->info().optionalDependencies()) {
+                addEdge(dependency, i);
+            }
+        }
 
-            // otherwise wait for it
-            if (!dep->loaded() && !dep->info().onDemand()) {
-                return DependencyCheckStatus::Pending;
+        std::vector<Addon *> result;
+        std::vector<size_t> ready;
+        for (size_t i = 0; i < addons.size(); i++) {
+            if (inDegree[i] == 0) {
+                ready.push_back(i);
             }
         }
+        while (!ready.empty()) {
+            auto i = ready.back();
+            ready.pop_back();
+            result.push_back(addons[i]);
+            for (auto dependent : dependents[i]) {
+                if (--inDegree[dependent] == 0) {
+                    ready.push_back(dependent);
+                }
+            }
+        }
+        for (size_t i = 0; i < addons.size(); i++) {
+            if (inDegree[i]) {
+                FCITX_ERROR() << "Addon " << addons[i]->info().uniqueName()
+                              << " is part of a dependency cycle.";
+            }
+        }
+        return result;
+    }
 
-        return DependencyCheckStatus::Satisfied;
+    bool dependenciesLoaded(const Addon &a) {
+        for (auto &dependency : a.info().dependencies()) {
+            Addon *dep = addon(dependency);
+            if (!dep || !dep->loaded()) {
+                return false;
+            }
+        }
+        return true;
     }
 
     void loadAddons(AddonManager *q_ptr) {
@@ -119,62 +248,56 @@ public:
             throw std::runtime_error("loadAddons is not reentrant, do not call "
                                      "addon(.., true) in constructor of addon");
         }
-        inLoadAddons_ = true;
-        bool changed = false;
-        do {
-            changed = false;
-
-            for (auto &item : addons_) {
-                changed |= loadAddon(q_ptr, *item.second.get());
-            }
-        } while (changed);
-        inLoadAddons_ = false;
-    }
-
-    bool loadAddon(AddonManager *q_ptr, Addon &addon) {
         if (unloading_) {
-            return false;
-        }
-
-        if (addon.loaded() || !addon.isLoadable()) {
-            return false;
+            return;
         }
-        if (addon.info().onDemand() &&
-            requested_.count(addon.info().uniqueName()) == 0) {
-            return false;
+        inLoadAddons_ = true;
+        auto order = resolveLoadOrder();
+        std::vector<AddonPreloader::Job> jobs;
+        for (auto addon : order) {
+            auto loader = findValue(loaders_, addon->info().type());
+            jobs.emplace_back(loader ? loader->get() : nullptr,
+                              &addon->info());
         }
-        auto result = checkDependencies(addon);
-        FCITX_LOG(Debug) << "Call loadAddon() with "
-                         << addon.info().uniqueName()
-                         << " checkDependencies() returns "
-                         << static_cast<int>(result);
-        if (result == DependencyCheckStatus::Failed) {
-            addon.setFailed();
-        } else if (result == DependencyCheckStatus::Satisfied) {
-            realLoad(q_ptr, addon);
+        AddonPreloader preloader(std::move(jobs));
+        for (size_t i = 0; i < order.size(); i++) {
+            auto &addon = *order[i];
+            preloader.wait(i);
+            if (dependenciesLoaded(addon)) {
+                realLoad(q_ptr, addon, preloader.prepareTime(i));
+            } else {
+                FCITX_LOG(Debug) << "Dependencies of "
+                                 << addon.info().uniqueName()
+                                 << " failed to load.";
+                addon.setFailed();
+            }
             if (addon.loaded()) {
                 loadOrder_.push_back(addon.info().uniqueName());
-                return true;
+            } else if (auto loader =
+                           findValue(loaders_, addon.info().type())) {
+                // Don't keep the library of a failed addon opened.
+                (*loader)->unprepare(addon.info());
             }
-        } else if (result == DependencyCheckStatus::PendingUpdateRequest) {
-            return true;
         }
-        // here we are "pending" on others.
-        return false;
+        inLoadAddons_ = false;
     }
 
-    void realLoad(AddonManager *q_ptr, Addon &addon) {
+    void realLoad(AddonManager *q_ptr, Addon &addon, uint64_t prepareTime) {
         if (!addon.isLoadable()) {
             return;
         }
 
+        auto start = now(CLOCK_MONOTONIC);
         if (auto loader = findValue(loaders_, addon.info().type())) {
             addon.instance_.reset((*loader)->load(addon.info(), q_ptr));
         }
         if (!addon.instance_) {
             addon.setFailed(true);
         } else {
-            FCITX_INFO() << "Loaded addon " << addon.info().uniqueName();
+            auto loadTime = now(CLOCK_MONOTONIC) - start;
+            FCITX_INFO() << "Loaded addon " << addon.info().uniqueName()
+                         << " (prepare: " << prepareTime / 1000.0
+                         << "ms, load: " << loadTime / 1000.0 << "ms)";
         }
     }
 
@@ -221,20 +344,8 @@ void AddonManager::registerDefaultLoader(StaticAddonRegistry *registry) {
 void AddonManager::load(const std::unordered_set<std::string> &enabled,
                         const std::unordered_set<std::string> &disabled) {
     FCITX_D();
-    auto &path = StandardPath::global();
-    auto fileMap =
-        path.multiOpenAll(StandardPath::Type::PkgData, d->addonConfigDir_,
-                          O_RDONLY, filter::Suffix(".conf"));
-    for (const auto &file : fileMap) {
-        auto &files = file.second;
-        RawConfig config;
-        // reverse the order, so we end up parse user file at last.
-        for (auto iter = files.rbegin(), end = files.rend(); iter != end;
-             iter++) {
-            auto fd = iter->fd();
-            readFromIni(config, fd);
-        }
-
+    for (auto &file : loadMergedConfigs(d->addonConfigDir_)) {
+        auto &config = file.second;
         // remove .conf
         auto name = file.first.substr(0, file.first.size() - 5);
         // override configuration
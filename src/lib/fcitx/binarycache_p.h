@@ -0,0 +1,186 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#ifndef _FCITX_BINARYCACHE_P_H_
+#define _FCITX_BINARYCACHE_P_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace fcitx {
+
+// Helpers for the small binary caches in the user cache directory. The
+// format is native endian, caches are never shared between machines.
+
+// Identity of a source file, a cache is valid as long as all of its source
+// files keep the same stamp.
+struct FileStamp {
+    std::string path;
+    int64_t mtimeSec = 0;
+    int64_t mtimeNsec = 0;
+    uint64_t size = 0;
+    uint64_t inode = 0;
+
+    bool operator==(const FileStamp &other) const {
+        return path == other.path && mtimeSec == other.mtimeSec &&
+               mtimeNsec == other.mtimeNsec && size == other.size &&
+               inode == other.inode;
+    }
+    bool operator!=(const FileStamp &other) const { return !(*this == other); }
+};
+
+// Return false if path is not a regular file, stamp is still usable as a
+// placeholder for a missing file.
+static inline bool readFileStamp(const std::string &path, FileStamp &stamp) {
+    stamp = FileStamp();
+    stamp.path = path;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    stamp.mtimeSec = st.st_mtim.tv_sec;
+    stamp.mtimeNsec = st.st_mtim.tv_nsec;
+    stamp.size = st.st_size;
+    stamp.inode = st.st_ino;
+    return true;
+}
+
+class BinaryCacheWriter {
+public:
+    void writeBytes(const char *data, size_t size) {
+        buffer_.append(data, size);
+    }
+
+    template <typename T>
+    void writeInt(T value) {
+        writeBytes(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void writeString(const std::string &str) {
+        writeInt<uint32_t>(str.size());
+        buffer_.append(str);
+    }
+
+    void writeStrings(const std::vector<std::string> &strs) {
+        writeInt<uint32_t>(strs.size());
+        for (const auto &str : strs) {
+            writeString(str);
+        }
+    }
+
+    void writeStamps(const std::vector<FileStamp> &stamps) {
+        writeInt<uint32_t>(stamps.size());
+        for (const auto &stamp : stamps) {
+            writeString(stamp.path);
+            writeInt(stamp.mtimeSec);
+            writeInt(stamp.mtimeNsec);
+            writeInt(stamp.size);
+            writeInt(stamp.inode);
+        }
+    }
+
+    const std::string &buffer() const { return buffer_; }
+
+private:
+    std::string buffer_;
+};
+
+class BinaryCacheReader {
+public:
+    BinaryCacheReader(const char *data, size_t size)
+        : data_(data), size_(size) {}
+
+    bool readBytes(void *data, size_t size) {
+        if (size_ - pos_ < size) {
+            return false;
+        }
+        memcpy(data, data_ + pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool expectBytes(const char *data, size_t size) {
+        if (size_ - pos_ < size || memcmp(data_ + pos_, data, size) != 0) {
+            return false;
+        }
+        pos_ += size;
+        return true;
+    }
+
+    template <typename T>
+    bool readInt(T &value) {
+        return readBytes(&value, sizeof(value));
+    }
+
+    bool readString(std::string &str) {
+        uint32_t size;
+        if (!readInt(size) || size_ - pos_ < size) {
+            return false;
+        }
+        str.assign(data_ + pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool readStrings(std::vector<std::string> &strs) {
+        uint32_t count;
+        if (!readInt(count)) {
+            return false;
+        }
+        strs.clear();
+        for (uint32_t i = 0; i < count; i++) {
+            strs.emplace_back();
+            if (!readString(strs.back())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readStamps(std::vector<FileStamp> &stamps) {
+        uint32_t count;
+        if (!readInt(count)) {
+            return false;
+        }
+        stamps.clear();
+        for (uint32_t i = 0; i < count; i++) {
+            FileStamp stamp;
+            if (!readString(stamp.path) || !readInt(stamp.mtimeSec) ||
+                !readInt(stamp.mtimeNsec) || !readInt(stamp.size) ||
+                !readInt(stamp.inode)) {
+                return false;
+            }
+            stamps.push_back(std::move(stamp));
+        }
+        return true;
+    }
+
+    bool atEnd() const { return pos_ == size_; }
+
+private:
+    const char *data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+} // namespace fcitx
+
+#endif // _FCITX_BINARYCACHE_P_H_
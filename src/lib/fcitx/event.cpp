@@ -18,7 +18,13 @@
 //
 
 #include "event.h"
+#include "inputcontext.h"
 
 namespace fcitx {
 Event::~Event() {}
+
+// The callback is kept by the input context, so KeyEvent keeps its layout.
+KeyEventCallback KeyEvent::defer() { return ic_->deferKeyEvent(*this); }
+
+bool KeyEvent::deferred() const { return ic_->keyEventDeferred(*this); }
 } // namespace fcitx
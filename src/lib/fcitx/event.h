@@ -22,6 +22,7 @@
 #include "fcitxcore_export.h"
 #include <fcitx-utils/key.h>
 #include <fcitx/userinterface.h>
+#include <functional>
 #include <stdint.h>
 
 namespace fcitx {
@@ -171,6 +172,9 @@ protected:
     bool forward_ = false;
 };
 
+/// Called with whether the key is accepted once a key event is done.
+typedef std::function<void(bool)> KeyEventCallback;
+
 class FCITXCORE_EXPORT KeyEvent : public KeyEventBase {
 public:
     KeyEvent(InputContext *context, Key rawKey, bool isRelease = false,
@@ -185,6 +189,18 @@ public:
         accept();
     }
 
+    /**
+     * Finish the key later instead of before the handler returns.
+     *
+     * Returns an empty callback if the frontend waits for the result, then
+     * the key must be handled right away. Otherwise the returned callback
+     * must be called exactly once with the result, usually after
+     * filterAndAccept() so nothing else handles the key in the meantime.
+     * The event itself must not be used once the handler returns.
+     */
+    KeyEventCallback defer();
+    bool deferred() const;
+
 private:
     bool filtered_ = false;
 };
@@ -133,6 +133,11 @@ void GlobalConfig::load(const RawConfig &rawConfig, bool partial) {
     d->load(rawConfig, partial);
 }
 
+void GlobalConfig::loadFromIni(int fd) {
+    FCITX_D();
+    readFromIni(*d, fd);
+}
+
 void GlobalConfig::save(RawConfig &config) const {
     FCITX_D();
     d->save(config);
@@ -58,6 +58,8 @@ public:
     void setDisabledAddons(const std::vector<std::string> &addons);
 
     void load(const RawConfig &rawConfig, bool partial = false);
+    /// Same as load() with the INI file read from fd.
+    void loadFromIni(int fd);
     void save(RawConfig &rawConfig) const;
     bool safeSave(const std::string &path = "config") const;
     const Configuration &config() const;
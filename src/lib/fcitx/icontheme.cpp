@@ -17,14 +17,21 @@
 // see <http://www.gnu.org/licenses/>.
 //
 #include "icontheme.h"
+#include "binarycache_p.h"
 #include "fcitx-config/iniparser.h"
 #include "fcitx-config/marshallfunction.h"
+#include "fcitx-utils/filewatcher.h"
 #include "fcitx-utils/fs.h"
 #include "fcitx-utils/log.h"
+#include "fcitx-utils/misc_p.h"
+#include <atomic>
+#include <dirent.h>
 #include <fcntl.h>
 #include <fstream>
+#include <optional>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <unordered_set>
 
 namespace fcitx {
@@ -160,6 +167,12 @@ bool timespecLess(const timespec &lhs, const timespec &rhs) {
     return lhs.tv_nsec < rhs.tv_nsec;
 }
 
+static void closedir0(DIR *dir) {
+    if (dir) {
+        closedir(dir);
+    }
+}
+
 static uint32_t iconNameHash(const char *p) {
     uint32_t h = static_cast<signed char>(*p);
     for (p += 1; *p != '\0'; p++)
@@ -339,6 +352,25 @@ IconThemeCache::lookup(const std::string &name) const {
     return ret;
 }
 
+// A theme directory under one of the icon search paths, e.g.
+// /usr/share/icons/hicolor.
+struct IconThemeBaseDirectory {
+    IconThemeBaseDirectory(std::string path)
+        : path_(std::move(path)),
+          cache_(stringutils::joinPath(path_, "icon-theme.cache")) {}
+
+    std::string path_;
+    IconThemeCache cache_;
+    // In-memory equivalent of icon-theme.cache, icon name to sub directories,
+    // only built for base directory that does not ship a valid cache.
+    bool indexBuilt_ = false;
+    std::unordered_map<std::string, std::unordered_set<std::string>> index_;
+};
+
+// Entries in result cache if it grows beyond this size, normally we only
+// query a handful of icons.
+constexpr size_t maxIconResultCacheSize = 1024;
+
 class IconThemePrivate : QPtrHolder<IconTheme> {
 public:
     IconThemePrivate(IconTheme *q, const StandardPath &path)
@@ -351,6 +383,45 @@ public:
 
     void loadFile(int fd) { readFromIni(config_, fd); }
 
+    // Candidates of index.theme from low to high priority, including the ones
+    // that do not exist yet.
+    std::vector<std::string> indexFiles(const std::string &name) const {
+        std::vector<std::string> files;
+        auto dataDirs = standardPath_.directories(StandardPath::Type::Data);
+        for (auto iter = dataDirs.rbegin(), end = dataDirs.rend(); iter != end;
+             iter++) {
+            files.push_back(
+                stringutils::joinPath(*iter, "icons", name, "index.theme"));
+        }
+        auto userDir = standardPath_.userDirectory(StandardPath::Type::Data);
+        if (!userDir.empty()) {
+            files.push_back(
+                stringutils::joinPath(userDir, "icons", name, "index.theme"));
+        }
+        files.push_back(
+            stringutils::joinPath(home_, ".icons", name, "index.theme"));
+        return files;
+    }
+
+    std::vector<FileStamp> readIndexStamps(const std::string &name) const {
+        std::vector<FileStamp> stamps;
+        for (const auto &file : indexFiles(name)) {
+            stamps.emplace_back();
+            readFileStamp(file, stamps.back());
+        }
+        return stamps;
+    }
+
+    void load(const std::string &name) {
+        indexStamps_ = readIndexStamps(name);
+        for (const auto &file : indexFiles(name)) {
+            auto fd = UnixFD::own(open(file.c_str(), O_RDONLY));
+            if (fd.fd() >= 0) {
+                loadFile(fd.fd());
+            }
+        }
+    }
+
     void parse(IconTheme *parent) {
         if (!parent) {
             subThemeNames_.insert(internalName_);
@@ -426,7 +497,8 @@ public:
     }
 
     std::string findIcon(const std::string &icon, int size, int scale,
-                         const std::vector<std::string> &extensions) const {
+                         const std::vector<std::string> &extensions,
+                         bool useIndex) const {
         // Respect absolute path.
         if (icon.empty() || icon[0] == '/') {
             return icon;
@@ -435,7 +507,8 @@ public:
         std::string filename;
         // If we're a empty theme, only look at fallback icon.
         if (!internalName_.empty()) {
-            auto filename = findIconHelper(icon, size, scale, extensions);
+            auto filename =
+                findIconHelper(icon, size, scale, extensions, useIndex);
             if (!filename.empty()) {
                 return filename;
             }
@@ -447,8 +520,8 @@ public:
         if (filename.empty()) {
             auto dashPos = icon.rfind('-');
             if (dashPos != std::string::npos) {
-                filename =
-                    findIcon(icon.substr(0, dashPos), size, scale, extensions);
+                filename = findIcon(icon.substr(0, dashPos), size, scale,
+                                    extensions, useIndex);
             }
         }
         return filename;
@@ -456,15 +529,16 @@ public:
 
     std::string
     findIconHelper(const std::string &icon, int size, int scale,
-                   const std::vector<std::string> &extensions) const {
-        auto filename = lookupIcon(icon, size, scale, extensions);
+                   const std::vector<std::string> &extensions,
+                   bool useIndex) const {
+        auto filename = lookupIcon(icon, size, scale, extensions, useIndex);
         if (!filename.empty()) {
             return filename;
         }
 
         for (auto &inherit : inherits_) {
-            filename =
-                inherit.d_func()->lookupIcon(icon, size, scale, extensions);
+            filename = inherit.d_func()->lookupIcon(icon, size, scale,
+                                                    extensions, useIndex);
             if (!filename.empty()) {
                 return filename;
             }
@@ -472,8 +546,167 @@ public:
         return {};
     }
 
+    std::string findIconCached(const std::string &icon, int size, int scale,
+                               const std::vector<std::string> &extensions) {
+        // Without reliable change notification, neither the results nor
+        // the index can be kept, look at the file system every time.
+        if (!watcher_ || !watcher_->isValid()) {
+            return findIcon(icon, size, scale, extensions, false);
+        }
+        if (dirty_.exchange(false)) {
+            invalidate();
+        }
+        auto key = stringutils::concat(icon, "|", size, "|", scale, "|",
+                                       stringutils::join(extensions, ","));
+        if (auto path = findValue(resultCache_, key)) {
+            return *path;
+        }
+        if (resultCache_.size() >= maxIconResultCacheSize) {
+            resultCache_.clear();
+        }
+        // Negative result is also cached as empty string.
+        auto path = findIcon(icon, size, scale, extensions, true);
+        resultCache_.emplace(std::move(key), path);
+        return path;
+    }
+
+    // Fill the index with files in all known sub directories.
+    void buildIndex(IconThemeBaseDirectory &baseDir) const {
+        baseDir.indexBuilt_ = true;
+        auto indexDirectory = [&baseDir](const IconThemeDirectory &directory) {
+            auto path = stringutils::joinPath(baseDir.path_, directory.path());
+            std::unique_ptr<DIR, decltype(closedir0) *> dir{
+                opendir(path.c_str()), closedir0};
+            if (!dir) {
+                return;
+            }
+            struct dirent *entry;
+            while ((entry = readdir(dir.get())) != nullptr) {
+                if (entry->d_type != DT_REG && entry->d_type != DT_LNK &&
+                    entry->d_type != DT_UNKNOWN) {
+                    continue;
+                }
+                std::string name = entry->d_name;
+                auto dot = name.rfind('.');
+                if (dot == 0 || dot == std::string::npos) {
+                    continue;
+                }
+                name.erase(dot);
+                baseDir.index_[name].insert(directory.path());
+            }
+        };
+        for (const auto &directory : directories_) {
+            indexDirectory(directory);
+        }
+        for (const auto &directory : scaledDirectories_) {
+            indexDirectory(directory);
+        }
+    }
+
+    // Return the set of sub directories that may contain the icon, or nullopt
+    // if every sub directory needs to be checked.
+    std::optional<std::unordered_set<std::string>>
+    lookupDirectories(IconThemeBaseDirectory &baseDir,
+                      const std::string &iconname, bool useIndex) const {
+        if (baseDir.cache_.isValid()) {
+            return baseDir.cache_.lookup(iconname);
+        }
+        // Index is not updated if files are added later.
+        if (!useIndex) {
+            return std::nullopt;
+        }
+        if (!baseDir.indexBuilt_) {
+            buildIndex(baseDir);
+        }
+        if (auto dirs = findValue(baseDir.index_, iconname)) {
+            return *dirs;
+        }
+        return std::unordered_set<std::string>();
+    }
+
+    template <typename Callback>
+    void forEachTheme(Callback callback) {
+        callback(*this);
+        for (auto &inherit : inherits_) {
+            callback(*inherit.d_func());
+        }
+    }
+
+    // Watch all directories that may affect the result of findIcon. Only
+    // called on the top level theme, in the thread of watcher.
+    void setupWatches() {
+        std::vector<std::unique_ptr<HandlerTableEntry<FileWatchCallback>>>
+            watches;
+        auto watch = [this, &watches](const std::string &path) {
+            watches.push_back(watcher_->watch(path, [this]() {
+                dirty_ = true;
+                // Whether icon-theme.cache is valid may have changed, which
+                // decides the sub directories to watch.
+                setupWatches();
+            }));
+        };
+        // Parent of all theme directories and fallback icons.
+        std::vector<std::string> iconDirs{
+            stringutils::joinPath(home_, ".icons")};
+        for (const auto &dataDir :
+             standardPath_.directories(StandardPath::Type::Data)) {
+            iconDirs.push_back(stringutils::joinPath(dataDir, "icons"));
+        }
+        for (const auto &iconDir : iconDirs) {
+            watch(iconDir);
+        }
+        forEachTheme([&iconDirs, &watch](IconThemePrivate &theme) {
+            for (const auto &iconDir : iconDirs) {
+                auto path = stringutils::joinPath(iconDir, theme.internalName_);
+                watch(path);
+                // icon-theme.cache is updated by rewriting it in the base
+                // directory, but without it any new file may show up in
+                // sub directories.
+                if (!fs::isdir(path) ||
+                    IconThemeCache(stringutils::joinPath(
+                                       path, "icon-theme.cache"))
+                        .isValid()) {
+                    continue;
+                }
+                for (const auto &directory : theme.directories_) {
+                    watch(stringutils::joinPath(path, directory.path()));
+                }
+                for (const auto &directory : theme.scaledDirectories_) {
+                    watch(stringutils::joinPath(path, directory.path()));
+                }
+            }
+        });
+        // Add new watches before dropping the old ones, so the directories
+        // that are still watched are not removed from inotify in between.
+        watches_ = std::move(watches);
+    }
+
+    // Drop everything derived from file system and start over.
+    void invalidate() {
+        resultCache_.clear();
+        bool indexChanged = false;
+        forEachTheme([&indexChanged](IconThemePrivate &theme) {
+            if (theme.indexStamps_ !=
+                theme.readIndexStamps(theme.internalName_)) {
+                indexChanged = true;
+            }
+        });
+        // Directories and inherits of any theme in the chain may change,
+        // parse the whole chain again.
+        if (indexChanged) {
+            reload();
+            setupWatches();
+            return;
+        }
+        forEachTheme([](IconThemePrivate &theme) {
+            theme.baseDirs_.clear();
+            theme.prepare();
+        });
+    }
+
     std::string lookupIcon(const std::string &iconname, int size, int scale,
-                           const std::vector<std::string> &extensions) const {
+                           const std::vector<std::string> &extensions,
+                           bool useIndex) const {
 
         auto checkDirectory = [&extensions,
                                &iconname](const IconThemeDirectory &directory,
@@ -494,18 +727,13 @@ public:
         };
 
         for (auto &baseDir : baseDirs_) {
-            bool hasCache = false;
-            std::unordered_set<std::string> dirFilter;
-            if (baseDir.second.isValid()) {
-                dirFilter = baseDir.second.lookup(iconname);
-                hasCache = true;
-            }
+            auto dirFilter = lookupDirectories(baseDir, iconname, useIndex);
             for (auto &directory : directories_) {
-                if ((hasCache && !dirFilter.count(directory.path())) ||
+                if ((dirFilter && !dirFilter->count(directory.path())) ||
                     !directory.matchesSize(size, scale)) {
                     continue;
                 }
-                auto path = checkDirectory(directory, baseDir.first);
+                auto path = checkDirectory(directory, baseDir.path_);
                 if (!path.empty()) {
                     return path;
                 }
@@ -513,11 +741,11 @@ public:
 
             if (scale != 1) {
                 for (auto &directory : scaledDirectories_) {
-                    if ((hasCache && !dirFilter.count(directory.path())) ||
+                    if ((dirFilter && !dirFilter->count(directory.path())) ||
                         !directory.matchesSize(size, scale)) {
                         continue;
                     }
-                    auto path = checkDirectory(directory, baseDir.first);
+                    auto path = checkDirectory(directory, baseDir.path_);
                     if (!path.empty()) {
                         return path;
                     }
@@ -529,22 +757,17 @@ public:
         std::string closestFilename;
 
         for (auto &baseDir : baseDirs_) {
-            bool hasCache = false;
-            std::unordered_set<std::string> dirFilter;
-            if (baseDir.second.isValid()) {
-                dirFilter = baseDir.second.lookup(iconname);
-                hasCache = true;
-            }
+            auto dirFilter = lookupDirectories(baseDir, iconname, useIndex);
 
             auto checkDirectoryWithSize =
-                [&checkDirectory, &closestFilename, &dirFilter, hasCache, size,
-                 scale, &minSize, &baseDir](const IconThemeDirectory &dir) {
-                    if (hasCache && !dirFilter.count(dir.path())) {
+                [&checkDirectory, &closestFilename, &dirFilter, size, scale,
+                 &minSize, &baseDir](const IconThemeDirectory &dir) {
+                    if (dirFilter && !dirFilter->count(dir.path())) {
                         return;
                     }
                     auto distance = dir.sizeDistance(size, scale);
                     if (distance < minSize) {
-                        auto path = checkDirectory(dir, baseDir.first);
+                        auto path = checkDirectory(dir, baseDir.path_);
                         if (!path.empty()) {
                             closestFilename = path;
                             minSize = distance;
@@ -588,34 +811,53 @@ public:
     void prepare() {
         auto path = stringutils::joinPath(home_, ".icons", internalName_);
         if (fs::isdir(path)) {
-            baseDirs_.emplace_back(std::piecewise_construct,
-                                   std::forward_as_tuple(path),
-                                   std::forward_as_tuple(stringutils::joinPath(
-                                       path, "icon-theme.cache")));
+            baseDirs_.emplace_back(path);
         }
         for (auto &dataDir :
              standardPath_.directories(StandardPath::Type::Data)) {
             auto path = stringutils::joinPath(dataDir, "icons", internalName_);
             if (fs::isdir(path)) {
-                baseDirs_.emplace_back(
-                    std::piecewise_construct, std::forward_as_tuple(path),
-                    std::forward_as_tuple(
-                        stringutils::joinPath(path, "icon-theme.cache")));
+                baseDirs_.emplace_back(path);
             }
         }
     }
 
+    // Only called on the top level theme.
+    void reload() {
+        auto name = internalName_;
+        config_.removeAll();
+        name_ = I18NString();
+        comment_ = I18NString();
+        example_.clear();
+        inherits_.clear();
+        directories_.clear();
+        scaledDirectories_.clear();
+        subThemeNames_.clear();
+        baseDirs_.clear();
+        load(name);
+        parse(nullptr);
+        prepare();
+    }
+
     std::string home_;
     std::string internalName_;
     const StandardPath &standardPath_;
     RawConfig config_;
+    std::vector<FileStamp> indexStamps_;
     I18NString name_;
     I18NString comment_;
     std::vector<IconTheme> inherits_;
     std::vector<IconThemeDirectory> directories_;
     std::vector<IconThemeDirectory> scaledDirectories_;
     std::unordered_set<std::string> subThemeNames_;
-    std::vector<std::pair<std::string, IconThemeCache>> baseDirs_;
+    mutable std::vector<IconThemeBaseDirectory> baseDirs_;
+    // Only used by top level theme. Results are only cached while watcher_
+    // reports the changes.
+    FileWatcher *watcher_ = nullptr;
+    std::vector<std::unique_ptr<HandlerTableEntry<FileWatchCallback>>>
+        watches_;
+    std::atomic<bool> dirty_{false};
+    std::unordered_map<std::string, std::string> resultCache_;
     // Not really useful for our usecase.
     // bool hidden_;
     std::string example_;
@@ -628,19 +870,7 @@ IconTheme::IconTheme(const std::string &name, IconTheme *parent,
                      const StandardPath &standardPath)
     : IconTheme(standardPath) {
     FCITX_D();
-    auto files = standardPath.openAll(
-        StandardPath::Type::Data,
-        stringutils::joinPath("icons", name, "index.theme"), O_RDONLY);
-
-    for (auto iter = files.rbegin(), end = files.rend(); iter != end; iter++) {
-        d->loadFile(iter->fd());
-    }
-    auto path = stringutils::joinPath(d->home_, ".icons", name, "index.theme");
-    auto fd = UnixFD::own(open(path.c_str(), O_RDONLY));
-    if (fd.fd() >= 0) {
-        d->loadFile(fd.fd());
-    }
-
+    d->load(name);
     d->parse(parent);
     d->internalName_ = name;
     d->prepare();
@@ -664,11 +894,18 @@ FCITX_DEFINE_READ_ONLY_PROPERTY_PRIVATE(IconTheme,
                                         scaledDirectories);
 FCITX_DEFINE_READ_ONLY_PROPERTY_PRIVATE(IconTheme, std::string, example);
 
+void IconTheme::watch(FileWatcher &watcher) {
+    FCITX_D();
+    d->watcher_ = &watcher;
+    d->dirty_ = true;
+    d->setupWatches();
+}
+
 std::string IconTheme::findIcon(const std::string &iconName, uint desiredSize,
                                 int scale,
                                 const std::vector<std::string> &extensions) {
     FCITX_D();
-    return d->findIcon(iconName, desiredSize, scale, extensions);
+    return d->findIconCached(iconName, desiredSize, scale, extensions);
 }
 
 enum class DesktopType {
@@ -35,6 +35,7 @@
 
 namespace fcitx {
 
+class FileWatcher;
 class IconThemeDirectoryPrivate;
 class IconThemePrivate;
 
@@ -81,6 +82,12 @@ public:
                              ".svg", ".png", ".xpm"});
     static std::string defaultIconThemeName();
 
+    /// Cache the results of findIcon, and drop them when watcher reports a
+    /// change to the icon directories. Must be called from the thread of
+    /// watcher, and watcher must outlive the theme. findIcon itself may be
+    /// called from another thread.
+    void watch(FileWatcher &watcher);
+
     FCITX_DECLARE_READ_ONLY_PROPERTY(std::string, internalName);
     FCITX_DECLARE_READ_ONLY_PROPERTY(I18NString, name);
     FCITX_DECLARE_READ_ONLY_PROPERTY(I18NString, comment);
@@ -25,6 +25,7 @@
 #include "instance.h"
 #include <cassert>
 #include <exception>
+#include <utility>
 
 namespace fcitx {
 
@@ -186,6 +187,37 @@ bool InputContext::keyEvent(KeyEvent &event) {
     return d->postEvent(event);
 }
 
+void InputContext::keyEvent(KeyEvent &event, KeyEventCallback callback) {
+    FCITX_D();
+    // Key events may nest, e.g. sent from a key event handler, restore the
+    // outer one afterwards.
+    auto outerEvent = std::exchange(d->deferrableKeyEvent_, &event);
+    auto outerCallback =
+        std::exchange(d->keyEventCallback_, std::move(callback));
+    auto outerDeferred = std::exchange(d->keyEventDeferred_, false);
+    auto result = d->postEvent(event);
+    d->deferrableKeyEvent_ = outerEvent;
+    callback = std::exchange(d->keyEventCallback_, std::move(outerCallback));
+    auto deferred = std::exchange(d->keyEventDeferred_, outerDeferred);
+    if (!deferred && callback) {
+        callback(result);
+    }
+}
+
+KeyEventCallback InputContext::deferKeyEvent(const KeyEvent &event) {
+    FCITX_D();
+    if (d->deferrableKeyEvent_ != &event || !d->keyEventCallback_) {
+        return {};
+    }
+    d->keyEventDeferred_ = true;
+    return std::exchange(d->keyEventCallback_, nullptr);
+}
+
+bool InputContext::keyEventDeferred(const KeyEvent &event) const {
+    FCITX_D();
+    return d->deferrableKeyEvent_ == &event && d->keyEventDeferred_;
+}
+
 void InputContext::reset(ResetReason reason) {
     FCITX_D();
     d->emplaceEvent<ResetEvent>(reason, this);
@@ -50,6 +50,7 @@ class StatusArea;
 class FCITXCORE_EXPORT InputContext : public TrackableObject<InputContext> {
     friend class InputContextManagerPrivate;
     friend class FocusGroup;
+    friend class KeyEvent;
 
 public:
     InputContext(InputContextManager &manager, const std::string &program = {});
@@ -72,6 +73,13 @@ public:
     CapabilityFlags capabilityFlags() const;
     void setCursorRect(Rect rect);
     bool keyEvent(KeyEvent &key);
+    /**
+     * Send a key event that may be finished asynchronously.
+     *
+     * callback is called with the result, either before this returns or
+     * later if the key is deferred by KeyEvent::defer().
+     */
+    void keyEvent(KeyEvent &key, KeyEventCallback callback);
 
     bool hasFocus() const;
 
@@ -114,6 +122,8 @@ protected:
 
 private:
     void setHasFocus(bool hasFocus);
+    KeyEventCallback deferKeyEvent(const KeyEvent &event);
+    bool keyEventDeferred(const KeyEvent &event) const;
 
     std::unique_ptr<InputContextPrivate> d_ptr;
     FCITX_DECLARE_PRIVATE(InputContext);
@@ -94,6 +94,12 @@ public:
     ICUUID uuid_;
     std::vector<std::unique_ptr<InputContextProperty>> properties_;
     bool destroyed_ = false;
+
+    // Key event sent through keyEvent() with a callback, which
+    // KeyEvent::defer() may take.
+    const KeyEvent *deferrableKeyEvent_ = nullptr;
+    KeyEventCallback keyEventCallback_;
+    bool keyEventDeferred_ = false;
 };
 } // namespace fcitx
 
@@ -51,7 +51,10 @@ public:
           addon_(addon) {}
 
     std::string uniqueName_;
-    std::string name_;
+    // Only written by the first name() after the resolver is set or reset.
+    mutable std::string name_;
+    std::function<std::string()> nameResolver_;
+    mutable bool nameResolved_ = false;
     std::string nativeName_;
     std::string icon_;
     std::string label_;
@@ -95,6 +98,19 @@ InputMethodEntry &InputMethodEntry::setConfigurable(bool configurable) {
     return *this;
 }
 
+InputMethodEntry &
+InputMethodEntry::setNameResolver(std::function<std::string()> resolver) {
+    FCITX_D();
+    d->nameResolver_ = std::move(resolver);
+    d->nameResolved_ = false;
+    return *this;
+}
+
+void InputMethodEntry::resetResolvedName() {
+    FCITX_D();
+    d->nameResolved_ = false;
+}
+
 void InputMethodEntry::setUserData(
     std::unique_ptr<InputMethodEntryUserData> userData) {
     FCITX_D();
@@ -108,8 +124,16 @@ const InputMethodEntryUserData *InputMethodEntry::userData() const {
 
 const std::string &InputMethodEntry::name() const {
     FCITX_D();
+    if (d->nameResolver_ && !d->nameResolved_) {
+        d->name_ = d->nameResolver_();
+        d->nameResolved_ = true;
+    }
     return d->name_;
 }
+bool InputMethodEntry::hasName() const {
+    FCITX_D();
+    return d->nameResolver_ || !d->name_.empty();
+}
 const std::string &InputMethodEntry::nativeName() const {
     FCITX_D();
     return d->nativeName_;
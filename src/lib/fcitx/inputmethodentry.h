@@ -21,6 +21,7 @@
 
 #include "fcitxcore_export.h"
 #include <fcitx-utils/macros.h>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -43,11 +44,21 @@ public:
     InputMethodEntry &setIcon(const std::string &icon);
     InputMethodEntry &setLabel(const std::string &label);
     InputMethodEntry &setConfigurable(bool configurable);
+    /// Compute the name when it is first used instead of up front, useful
+    /// for engines that provide many entries with translated names. The
+    /// name passed to the constructor is replaced by the result. It is kept
+    /// until resetResolvedName(), e.g. after the message locale changes.
+    InputMethodEntry &setNameResolver(std::function<std::string()> resolver);
+    /// Compute the name again on next use, references returned by name()
+    /// stay valid until then.
+    void resetResolvedName();
     void setUserData(std::unique_ptr<InputMethodEntryUserData> userData);
 
     const InputMethodEntryUserData *userData() const;
 
     const std::string &name() const;
+    /// Whether the entry has a name, without resolving it.
+    bool hasName() const;
     const std::string &nativeName() const;
     const std::string &icon() const;
     const std::string &uniqueName() const;
@@ -27,6 +27,7 @@
 #include "inputmethodconfig_p.h"
 #include "inputmethodengine.h"
 #include "instance.h"
+#include "metadatacache_p.h"
 #include "misc_p.h"
 #include <cassert>
 #include <fcntl.h>
@@ -56,7 +57,7 @@ public:
 
 bool checkEntry(const InputMethodEntry &entry,
                 const std::unordered_set<std::string> &inputMethods) {
-    return (entry.name().empty() || entry.uniqueName().empty() ||
+    return (!entry.hasName() || entry.uniqueName().empty() ||
             entry.addon().empty() || inputMethods.count(entry.addon()) == 0)
                ? false
                : true;
@@ -74,22 +75,9 @@ void InputMethodManager::load() {
 
     auto inputMethods =
         d->addonManager_->addonNames(AddonCategory::InputMethod);
-    auto &path = StandardPath::global();
-    auto filesMap =
-        path.multiOpenAll(StandardPath::Type::PkgData, "inputmethod", O_RDONLY,
-                          filter::Suffix(".conf"));
-    for (const auto &file : filesMap) {
-        auto &files = file.second;
-        RawConfig config;
-        // reverse the order, so we end up parse user file at last.
-        for (auto iter = files.rbegin(), end = files.rend(); iter != end;
-             iter++) {
-            auto fd = iter->fd();
-            readFromIni(config, fd);
-        }
-
+    for (const auto &file : loadMergedConfigs("inputmethod")) {
         InputMethodInfo imInfo;
-        imInfo.load(config);
+        imInfo.load(file.second);
         // Remove ".conf"
         auto name = file.first.substr(0, file.first.size() - 5);
         InputMethodEntry entry = toInputMethodEntry(name, imInfo);
@@ -371,4 +359,11 @@ bool InputMethodManager::foreachEntries(
     }
     return true;
 }
+
+void InputMethodManager::resetEntryNames() {
+    FCITX_D();
+    for (auto &p : d->entries_) {
+        p.second.resetResolvedName();
+    }
+}
 } // namespace fcitx
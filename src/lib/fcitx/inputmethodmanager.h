@@ -56,6 +56,9 @@ public:
     const InputMethodEntry *entry(const std::string &name) const;
     bool foreachEntries(
         const std::function<bool(const InputMethodEntry &entry)> callback);
+    /// Translated names of entries are computed again on next use, call it
+    /// once the message locale changes.
+    void resetEntryNames();
 
     FCITX_DECLARE_SIGNAL(InputMethodManager, CurrentGroupAboutToBeChanged,
                          void(const std::string &group));
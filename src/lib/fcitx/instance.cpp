@@ -22,6 +22,7 @@
 #include "config.h"
 #include "fcitx-config/iniparser.h"
 #include "fcitx-utils/event.h"
+#include "fcitx-utils/filewatcher.h"
 #include "fcitx-utils/i18n.h"
 #include "fcitx-utils/log.h"
 #include "fcitx-utils/standardpath.h"
@@ -290,6 +291,8 @@ public:
 
     int signalPipe_ = -1;
     EventLoop eventLoop_;
+    // Addons are unloaded in ~Instance, before their watches would dangle.
+    FileWatcher fileWatcher_{&eventLoop_};
     std::unique_ptr<EventSourceIO> signalPipeEvent_;
     std::unique_ptr<EventSource> exitEvent_;
     InputContextManager icManager_;
@@ -405,6 +408,9 @@ Instance::Instance(int argc, char **argv) {
     d->arg_ = arg;
     d->addonManager_.setInstance(this);
     d->icManager_.setInstance(this);
+    // System directories only change when packages are installed, which is
+    // covered by file watches and ReloadConfig.
+    StandardPath::global().setCacheEnabled(true);
     d->connections_.emplace_back(
         d->imManager_.connect<InputMethodManager::CurrentGroupAboutToBeChanged>(
             [this, d](const std::string &) {
@@ -954,6 +960,11 @@ EventLoop &Instance::eventLoop() {
     return d->eventLoop_;
 }
 
+FileWatcher &Instance::fileWatcher() {
+    FCITX_D();
+    return d->fileWatcher_;
+}
+
 InputContextManager &Instance::inputContextManager() {
     FCITX_D();
     return d->icManager_;
@@ -1169,6 +1180,7 @@ void Instance::deactivate() {
 void Instance::exit() { eventLoop().quit(); }
 
 void Instance::reloadAddonConfig(const std::string &addonName) {
+    StandardPath::global().invalidateCache();
     auto addon = addonManager().addon(addonName);
     if (addon) {
         addon->reloadConfig();
@@ -1178,11 +1190,10 @@ void Instance::reloadAddonConfig(const std::string &addonName) {
 void Instance::reloadConfig() {
     FCITX_D();
     auto &standardPath = StandardPath::global();
+    standardPath.invalidateCache();
     auto file =
         standardPath.open(StandardPath::Type::PkgConfig, "config", O_RDONLY);
-    RawConfig config;
-    readFromIni(config, file.fd());
-    d->globalConfig_.load(config);
+    d->globalConfig_.loadFromIni(file.fd());
     FCITX_LOG(Debug) << "Trigger Key: "
                      << Key::keyListToString(d->globalConfig_.triggerKeys());
 }
@@ -36,6 +36,7 @@ class InputContext;
 class KeyEvent;
 class InstancePrivate;
 class EventLoop;
+class FileWatcher;
 class AddonManager;
 class InputContextManager;
 class InputMethodManager;
@@ -69,6 +70,7 @@ public:
     bool quitWhenMainDisplayDisconnected() const;
 
     EventLoop &eventLoop();
+    FileWatcher &fileWatcher();
     AddonManager &addonManager();
     InputContextManager &inputContextManager();
     UserInterfaceManager &userInterfaceManager();
@@ -0,0 +1,177 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "metadatacache_p.h"
+#include "binarycache_p.h"
+#include "fcitx-config/iniparser.h"
+#include "fcitx-utils/fs.h"
+#include "fcitx-utils/standardpath.h"
+#include "fcitx-utils/stringutils.h"
+#include "fcitx-utils/unixfd.h"
+#include <fcntl.h>
+#include <map>
+#include <sys/stat.h>
+
+namespace fcitx {
+
+namespace {
+
+constexpr char cacheMagic[] = "FCITXMDC";
+// Bump this if the format changes.
+constexpr uint32_t cacheVersion = 1;
+
+void writeConfig(BinaryCacheWriter &writer, const RawConfig &config) {
+    writer.writeString(config.value());
+    writer.writeString(config.comment());
+    writer.writeInt<uint32_t>(config.subItemsSize());
+    config.visitSubItems([&writer](const RawConfig &sub, const std::string &) {
+        writer.writeString(sub.name());
+        writeConfig(writer, sub);
+        return true;
+    });
+}
+
+bool readConfig(BinaryCacheReader &reader, RawConfig &config) {
+    std::string value, comment;
+    uint32_t count;
+    if (!reader.readString(value) || !reader.readString(comment) ||
+        !reader.readInt(count)) {
+        return false;
+    }
+    config.setValue(std::move(value));
+    config.setComment(std::move(comment));
+    for (uint32_t i = 0; i < count; i++) {
+        std::string name;
+        if (!reader.readString(name) ||
+            !readConfig(reader, *config.get(name, true))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string cacheFile(const std::string &directory) {
+    return stringutils::concat(
+        "fcitx5/", stringutils::replaceAll(directory, "/", "_"), ".cache");
+}
+
+bool readCache(const std::string &directory,
+               const std::vector<FileStamp> &stamps,
+               std::map<std::string, RawConfig> &result) {
+    auto file = StandardPath::global().openUser(StandardPath::Type::Cache,
+                                                cacheFile(directory), O_RDONLY);
+    struct stat stat;
+    if (file.fd() < 0 || fstat(file.fd(), &stat) != 0) {
+        return false;
+    }
+    std::string buffer;
+    buffer.resize(stat.st_size);
+    if (fs::safeRead(file.fd(), &buffer[0], buffer.size()) !=
+        static_cast<ssize_t>(buffer.size())) {
+        return false;
+    }
+
+    BinaryCacheReader reader(buffer.data(), buffer.size());
+    uint32_t version, count;
+    std::vector<FileStamp> cachedStamps;
+    if (!reader.expectBytes(cacheMagic, sizeof(cacheMagic)) ||
+        !reader.readInt(version) || version != cacheVersion ||
+        !reader.readStamps(cachedStamps) || cachedStamps != stamps ||
+        !reader.readInt(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        std::string name;
+        if (!reader.readString(name) || !readConfig(reader, result[name])) {
+            result.clear();
+            return false;
+        }
+    }
+    if (!reader.atEnd()) {
+        result.clear();
+        return false;
+    }
+    return true;
+}
+
+void writeCache(const std::string &directory,
+                const std::vector<FileStamp> &stamps,
+                const std::map<std::string, RawConfig> &result) {
+    BinaryCacheWriter writer;
+    writer.writeBytes(cacheMagic, sizeof(cacheMagic));
+    writer.writeInt(cacheVersion);
+    writer.writeStamps(stamps);
+    writer.writeInt<uint32_t>(result.size());
+    for (const auto &item : result) {
+        writer.writeString(item.first);
+        writeConfig(writer, item.second);
+    }
+    const auto &buffer = writer.buffer();
+    StandardPath::global().safeSave(
+        StandardPath::Type::Cache, cacheFile(directory), [&buffer](int fd) {
+            return fs::safeWrite(fd, buffer.data(), buffer.size()) ==
+                   static_cast<ssize_t>(buffer.size());
+        });
+}
+
+} // namespace
+
+std::map<std::string, RawConfig>
+loadMergedConfigs(const std::string &directory) {
+    // Files with the same name, in the order of priority.
+    std::map<std::string, std::vector<std::string>> files;
+    std::vector<FileStamp> stamps;
+    StandardPath::global().scanFiles(
+        StandardPath::Type::PkgData, directory,
+        [&files, &stamps](const std::string &name, const std::string &dir,
+                          bool) {
+            if (!stringutils::endsWith(name, ".conf")) {
+                return true;
+            }
+            FileStamp stamp;
+            if (!readFileStamp(stringutils::joinPath(dir, name), stamp)) {
+                return true;
+            }
+            files[name].push_back(stamp.path);
+            stamps.push_back(std::move(stamp));
+            return true;
+        });
+
+    std::map<std::string, RawConfig> result;
+    if (readCache(directory, stamps, result)) {
+        return result;
+    }
+
+    for (const auto &file : files) {
+        // RawConfig is not safe to move, so fill it in place.
+        auto &config = result[file.first];
+        // reverse the order, so we end up parse user file at last.
+        for (auto iter = file.second.rbegin(), end = file.second.rend();
+             iter != end; iter++) {
+            UnixFD fd = UnixFD::own(::open(iter->c_str(), O_RDONLY));
+            if (fd.isValid()) {
+                readFromIni(config, fd.fd());
+            }
+        }
+    }
+    writeCache(directory, stamps, result);
+    return result;
+}
+
+} // namespace fcitx
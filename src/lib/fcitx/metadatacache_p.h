@@ -0,0 +1,41 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#ifndef _FCITX_METADATACACHE_P_H_
+#define _FCITX_METADATACACHE_P_H_
+
+#include "fcitx-config/rawconfig.h"
+#include <map>
+#include <string>
+
+namespace fcitx {
+
+/// Read all .conf files under the PkgData sub directory and merge the files
+/// with the same name, so the user file takes precedence. Result is keyed by
+/// the file name.
+///
+/// The result is cached in binary form in the user cache directory. The cache
+/// is used as long as the same set of files is found, with the same
+/// modification time, size and inode, so a warm start does not parse any
+/// ini file.
+std::map<std::string, RawConfig>
+loadMergedConfigs(const std::string &directory);
+
+} // namespace fcitx
+
+#endif // _FCITX_METADATACACHE_P_H_
@@ -25,6 +25,7 @@
 #include "fcitx/menu.h"
 #include "fcitx/userinterfacemanager.h"
 #include "notificationitem.h"
+#include <algorithm>
 
 namespace fcitx {
 
@@ -136,13 +137,6 @@ void DBusMenu::handleEvent(int32_t id) {
     }
 }
 
-void DBusMenu::appendSubItem(
-    std::vector<dbus::Variant> &subItems, int32_t id, int depth,
-    const std::unordered_set<std::string> &propertyNames) {
-    DBusMenuLayout subLayout;
-    fillLayoutItem(id, depth - 1, propertyNames, subLayout);
-    subItems.emplace_back(std::move(subLayout));
-}
 void DBusMenu::appendProperty(
     DBusMenuProperties &properties,
     const std::unordered_set<std::string> &propertyNames,
@@ -153,15 +147,10 @@ void DBusMenu::appendProperty(
     properties.emplace_back(name, std::move(variant));
 }
 
-void DBusMenu::fillLayoutItem(
-    int32_t id, int depth, const std::unordered_set<std::string> &propertyNames,
-    DBusMenuLayout &layout) {
-    std::get<0>(layout) = id;
-    fillLayoutProperties(id, propertyNames, std::get<1>(layout));
-    auto &subLayoutItems = std::get<2>(layout);
-
+std::vector<int32_t> DBusMenu::children(int32_t id) {
+    std::vector<int32_t> result;
     if (id < 0) {
-        return;
+        return result;
     }
     /* for dbus menu, we have
      * root (0,0) -> Group -> not visible if only one group
@@ -171,21 +160,16 @@ void DBusMenu::fillLayoutItem(
      *            -> restart (0,3)
      *            -> exit (0,4)
      */
-    if (depth == 0) {
-        return;
-    }
-    requestedMenus_.insert(id);
     auto &imManager = parent_->instance()->inputMethodManager();
     if (id == 0) {
         // Group
         if (imManager.groupCount()) {
-            appendSubItem(subLayoutItems, BII_InputMethodGroup, depth,
-                          propertyNames);
+            result.push_back(BII_InputMethodGroup);
         }
         // Input Method
-        appendSubItem(subLayoutItems, BII_InputMethod, depth, propertyNames);
+        result.push_back(BII_InputMethod);
         // Separator
-        appendSubItem(subLayoutItems, BII_Separator1, depth, propertyNames);
+        result.push_back(BII_Separator1);
         bool hasAction = false;
         if (auto ic = lastRelevantIc()) {
             auto &statusArea = ic->statusArea();
@@ -194,32 +178,30 @@ void DBusMenu::fillLayoutItem(
                     // Obviously it's not registered with ui manager.
                     continue;
                 }
-                appendSubItem(subLayoutItems, builtInIds + action->id(), depth,
-                              propertyNames);
+                result.push_back(builtInIds + action->id());
                 hasAction = true;
             }
         }
         if (hasAction) {
-            appendSubItem(subLayoutItems, BII_Separator2, depth, propertyNames);
-        }
-        appendSubItem(subLayoutItems, BII_ConfigureCurrent, depth,
-                      propertyNames);
-        appendSubItem(subLayoutItems, BII_Configure, depth, propertyNames);
-        appendSubItem(subLayoutItems, BII_Separator3, depth, propertyNames);
-        appendSubItem(subLayoutItems, BII_Restart, depth, propertyNames);
-        appendSubItem(subLayoutItems, BII_Exit, depth, propertyNames);
+            result.push_back(BII_Separator2);
+        }
+        result.push_back(BII_ConfigureCurrent);
+        result.push_back(BII_Configure);
+        result.push_back(BII_Separator3);
+        result.push_back(BII_Restart);
+        result.push_back(BII_Exit);
     } else if (id == BII_InputMethodGroup) {
         int idx = BII_InputMethodGroupStart;
         for (const auto &group : imManager.groups()) {
             FCITX_UNUSED(group);
-            appendSubItem(subLayoutItems, idx, depth, propertyNames);
+            result.push_back(idx);
             idx++;
         }
     } else if (id == BII_InputMethod) {
         int idx = BII_InputMethodStart;
         for (const auto &item : imManager.currentGroup().inputMethodList()) {
             FCITX_UNUSED(item);
-            appendSubItem(subLayoutItems, idx, depth, propertyNames);
+            result.push_back(idx);
             idx++;
         }
     } else if (id > builtInIds) {
@@ -233,12 +215,91 @@ void DBusMenu::fillLayoutItem(
                         // Obviously it's not registered with ui manager.
                         continue;
                     }
-                    appendSubItem(subLayoutItems, builtInIds + menuAction->id(),
-                                  depth, propertyNames);
+                    result.push_back(builtInIds + menuAction->id());
                 }
             }
         }
     }
+    return result;
+}
+
+DBusMenu::DBusMenuItem &DBusMenu::cachedItem(int32_t id, int32_t parent) {
+    auto iter = items_.find(id);
+    if (iter == items_.end()) {
+        iter = items_.emplace(id, DBusMenuItem()).first;
+        fillLayoutProperties(id, {}, iter->second.properties);
+        iter->second.children = children(id);
+    }
+    if (parent >= 0) {
+        iter->second.parent = parent;
+    }
+    return iter->second;
+}
+
+const dbus::Variant &DBusMenu::cachedLayout(int32_t id, int32_t parent) {
+    auto &item = cachedItem(id, parent);
+    if (!item.layoutValid) {
+        DBusMenuLayout layout;
+        fillLayoutItem(id, parent, -1, {}, layout);
+        item.layout = dbus::Variant(std::move(layout));
+        item.layoutValid = true;
+    }
+    return item.layout;
+}
+
+void DBusMenu::invalidateLayout(int32_t id) {
+    // If an item is invalid, all its ancestors are invalid too.
+    auto iter = items_.find(id);
+    while (iter != items_.end() && iter->second.layoutValid) {
+        iter->second.layoutValid = false;
+        iter = items_.find(iter->second.parent);
+    }
+}
+
+void DBusMenu::markRequested(int32_t id) {
+    // Same as what fillLayoutItem would record for the whole subtree.
+    requestedMenus_.insert(id);
+    auto iter = items_.find(id);
+    if (iter == items_.end()) {
+        return;
+    }
+    for (auto child : iter->second.children) {
+        markRequested(child);
+    }
+}
+
+void DBusMenu::fillLayoutItem(
+    int32_t id, int32_t parent, int depth,
+    const std::unordered_set<std::string> &propertyNames,
+    DBusMenuLayout &layout) {
+    auto &item = cachedItem(id, parent);
+    std::get<0>(layout) = id;
+    if (propertyNames.empty()) {
+        std::get<1>(layout) = item.properties;
+    } else {
+        for (const auto &property : item.properties) {
+            if (propertyNames.count(property.key())) {
+                std::get<1>(layout).push_back(property);
+            }
+        }
+    }
+    auto &subLayoutItems = std::get<2>(layout);
+
+    if (id < 0 || depth == 0) {
+        return;
+    }
+    requestedMenus_.insert(id);
+    for (auto child : item.children) {
+        if (depth < 0 && propertyNames.empty()) {
+            // Variant data is shared, so this does not copy the subtree.
+            subLayoutItems.push_back(cachedLayout(child, id));
+            markRequested(child);
+        } else {
+            DBusMenuLayout subLayout;
+            fillLayoutItem(child, id, depth - 1, propertyNames, subLayout);
+            subLayoutItems.emplace_back(std::move(subLayout));
+        }
+    }
 }
 
 void DBusMenu::fillLayoutProperties(
@@ -387,10 +448,136 @@ DBusMenu::getLayout(int parentId, int recursionDepth,
     std::get<0>(result) = revision_;
     std::unordered_set<std::string> properties(propertyNames.begin(),
                                                propertyNames.end());
-    fillLayoutItem(parentId, recursionDepth, properties, std::get<1>(result));
+    fillLayoutItem(parentId, -1, recursionDepth, properties,
+                   std::get<1>(result));
     return result;
 }
 
+namespace {
+
+// We only ever put string and int into properties.
+bool samePropertyValue(const dbus::Variant &lhs, const dbus::Variant &rhs) {
+    if (lhs.signature() != rhs.signature()) {
+        return false;
+    }
+    if (lhs.signature() == "s") {
+        return lhs.dataAs<std::string>() == rhs.dataAs<std::string>();
+    }
+    if (lhs.signature() == "i") {
+        return lhs.dataAs<int32_t>() == rhs.dataAs<int32_t>();
+    }
+    return false;
+}
+
+} // namespace
+
+void DBusMenu::updateMenu() {
+    // Nothing is sent to the host yet.
+    if (items_.empty() || updateEvent_) {
+        return;
+    }
+    updateEvent_ = parent_->instance()->eventLoop().addDeferEvent(
+        [this](EventSource *) {
+            refresh();
+            updateEvent_.reset();
+            return true;
+        });
+}
+
+void DBusMenu::refresh() {
+    std::vector<int32_t> ids;
+    for (const auto &item : items_) {
+        ids.push_back(item.first);
+    }
+
+    std::vector<int32_t> layoutChanged;
+    std::vector<dbus::DBusStruct<int32_t, DBusMenuProperties>> updated;
+    std::vector<dbus::DBusStruct<int32_t, std::vector<std::string>>> removed;
+    for (auto id : ids) {
+        auto &item = items_[id];
+        auto newChildren = children(id);
+        if (newChildren != item.children) {
+            item.children = std::move(newChildren);
+            invalidateLayout(id);
+            layoutChanged.push_back(id);
+        }
+
+        DBusMenuProperties properties;
+        fillLayoutProperties(id, {}, properties);
+        DBusMenuProperties changed;
+        std::vector<std::string> removedNames;
+        for (const auto &property : properties) {
+            auto iter = std::find_if(
+                item.properties.begin(), item.properties.end(),
+                [&property](const DBusMenuProperty &oldProperty) {
+                    return oldProperty.key() == property.key();
+                });
+            if (iter == item.properties.end() ||
+                !samePropertyValue(iter->value(), property.value())) {
+                changed.push_back(property);
+            }
+        }
+        for (const auto &oldProperty : item.properties) {
+            if (std::none_of(properties.begin(), properties.end(),
+                             [&oldProperty](const DBusMenuProperty &property) {
+                                 return oldProperty.key() == property.key();
+                             })) {
+                removedNames.push_back(oldProperty.key());
+            }
+        }
+        if (changed.empty() && removedNames.empty()) {
+            continue;
+        }
+        item.properties = std::move(properties);
+        invalidateLayout(id);
+        if (!changed.empty()) {
+            updated.emplace_back(id, std::move(changed));
+        }
+        if (!removedNames.empty()) {
+            removed.emplace_back(id, std::move(removedNames));
+        }
+    }
+
+    if (!layoutChanged.empty()) {
+        // Drop the items that are no longer reachable from what the host
+        // asked for.
+        std::unordered_set<int32_t> reachable;
+        std::vector<int32_t> queue;
+        for (const auto &item : items_) {
+            if (item.second.parent < 0) {
+                queue.push_back(item.first);
+            }
+        }
+        while (!queue.empty()) {
+            auto id = queue.back();
+            queue.pop_back();
+            auto iter = items_.find(id);
+            if (iter == items_.end() || !reachable.insert(id).second) {
+                continue;
+            }
+            queue.insert(queue.end(), iter->second.children.begin(),
+                         iter->second.children.end());
+        }
+        for (auto iter = items_.begin(); iter != items_.end();) {
+            if (reachable.count(iter->first)) {
+                ++iter;
+            } else {
+                iter = items_.erase(iter);
+            }
+        }
+        revision_++;
+    }
+
+    if (!updated.empty() || !removed.empty()) {
+        itemsPropertiesUpdated(updated, removed);
+    }
+    for (auto id : layoutChanged) {
+        if (items_.count(id)) {
+            layoutUpdated(revision_, id);
+        }
+    }
+}
+
 InputContext *DBusMenu::lastRelevantIc() {
     if (auto ic = lastRelevantIc_.get()) {
         return ic;
@@ -404,7 +591,15 @@ bool DBusMenu::aboutToShow(int32_t id) {
             lastRelevantIc_ = ic->watch();
         }
         requestedMenus_.clear();
-        return true;
+        if (items_.empty()) {
+            return true;
+        }
+        // Changes are already sent as signals, only ask for a new layout if
+        // the structure changed.
+        auto revision = revision_;
+        updateEvent_.reset();
+        refresh();
+        return revision != revision_;
     }
     if (requestedMenus_.count(id)) {
         return false;
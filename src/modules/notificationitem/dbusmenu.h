@@ -26,6 +26,7 @@
 #include "fcitx-utils/i18n.h"
 #include "fcitx-utils/log.h"
 #include "fcitx/inputcontext.h"
+#include <unordered_map>
 #include <unordered_set>
 
 namespace fcitx {
@@ -39,10 +40,24 @@ class DBusMenu : public dbus::ObjectVTable<DBusMenu> {
     using DBusMenuLayout = dbus::DBusStruct<int32_t, DBusMenuProperties,
                                             std::vector<dbus::Variant>>;
 
+    // Menu item as last sent to the tray host.
+    struct DBusMenuItem {
+        int32_t parent = -1;
+        DBusMenuProperties properties;
+        std::vector<int32_t> children;
+        // Full layout of the subtree with all properties, only valid if
+        // layoutValid is true.
+        dbus::Variant layout;
+        bool layoutValid = false;
+    };
+
 public:
     DBusMenu(NotificationItem *item);
     ~DBusMenu();
 
+    // Schedule a check on the menu and notify the host about the changes.
+    void updateMenu();
+
 private:
     void event(int32_t id, const std::string &type, const dbus::Variant &,
                uint32_t);
@@ -51,11 +66,15 @@ private:
     getLayout(int parentId, int recursionDepth,
               const std::vector<std::string> &propertyNames);
 
-    void fillLayoutItem(int32_t id, int depth,
+    void fillLayoutItem(int32_t id, int32_t parent, int depth,
                         const std::unordered_set<std::string> &propertyNames,
                         DBusMenuLayout &layout);
-    void appendSubItem(std::vector<dbus::Variant> &, int32_t id, int depth,
-                       const std::unordered_set<std::string> &propertyNames);
+    DBusMenuItem &cachedItem(int32_t id, int32_t parent);
+    const dbus::Variant &cachedLayout(int32_t id, int32_t parent);
+    void invalidateLayout(int32_t id);
+    void markRequested(int32_t id);
+    void refresh();
+    std::vector<int32_t> children(int32_t id);
     void handleEvent(int32_t id);
     void appendProperty(DBusMenuProperties &properties,
                         const std::unordered_set<std::string> &propertyNames,
@@ -86,7 +105,6 @@ private:
                                  []() { return version_; });
     FCITX_OBJECT_VTABLE_PROPERTY(status, "Status", "s",
                                  []() { return "normal"; });
-    // We don't use this.
     FCITX_OBJECT_VTABLE_SIGNAL(itemsPropertiesUpdated, "ItemsPropertiesUpdated",
                                "a(ia{sv})a(ias)");
     FCITX_OBJECT_VTABLE_SIGNAL(layoutUpdated, "LayoutUpdated", "ui");
@@ -101,11 +119,15 @@ private:
     FCITX_OBJECT_VTABLE_METHOD(aboutToShow, "AboutToShow", "i", "b");
 
     constexpr static uint32_t version_ = 2;
-    constexpr static uint32_t revision_ = 2;
+    // Only bumped when the structure of the menu changes, property changes
+    // are sent with ItemsPropertiesUpdated.
+    uint32_t revision_ = 2;
     NotificationItem *parent_;
     std::unique_ptr<EventSourceTime> timeEvent_;
+    std::unique_ptr<EventSource> updateEvent_;
     TrackableObjectReference<InputContext> lastRelevantIc_;
     std::unordered_set<int32_t> requestedMenus_;
+    std::unordered_map<int32_t, DBusMenuItem> items_;
 };
 
 } // namespace fcitx
@@ -133,13 +133,31 @@ NotificationItem::NotificationItem(Instance *instance)
 
     eventHandlers_.emplace_back(instance_->watchEvent(
         EventType::InputContextFocusIn, EventWatcherPhase::Default,
-        [this](Event &) { sni_->newIcon(); }));
+        [this](Event &) {
+            sni_->newIcon();
+            menu_->updateMenu();
+        }));
     eventHandlers_.emplace_back(instance_->watchEvent(
         EventType::InputContextSwitchInputMethod, EventWatcherPhase::Default,
-        [this](Event &) { sni_->newIcon(); }));
+        [this](Event &) {
+            sni_->newIcon();
+            menu_->updateMenu();
+        }));
     eventHandlers_.emplace_back(instance_->watchEvent(
         EventType::InputMethodGroupChanged, EventWatcherPhase::Default,
-        [this](Event &) { sni_->newIcon(); }));
+        [this](Event &) {
+            sni_->newIcon();
+            menu_->updateMenu();
+        }));
+    // Actions are added, removed or changed, the cached menu is stale.
+    eventHandlers_.emplace_back(instance_->watchEvent(
+        EventType::InputContextUpdateUI, EventWatcherPhase::Default,
+        [this](Event &event) {
+            auto &icEvent = static_cast<InputContextUpdateUIEvent &>(event);
+            if (icEvent.component() == UserInterfaceComponent::StatusArea) {
+                menu_->updateMenu();
+            }
+        }));
 }
 
 NotificationItem::~NotificationItem() = default;
@@ -119,7 +119,9 @@ void Notifications::updateConfig() {
 }
 
 void Notifications::reloadConfig() {
-    readAsIni(config_, "conf/notifications.conf");
+    if (reloadAsIni(config_, "conf/notifications.conf").empty()) {
+        return;
+    }
 
     updateConfig();
 }
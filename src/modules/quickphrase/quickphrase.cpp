@@ -25,6 +25,7 @@
 #include "fcitx-utils/standardpath.h"
 #include "fcitx-utils/utf8.h"
 #include "fcitx/addonmanager.h"
+#include "fcitx/binarycache_p.h"
 #include "fcitx/candidatelist.h"
 #include "fcitx/inputcontextmanager.h"
 #include "fcitx/inputpanel.h"
@@ -224,10 +225,28 @@ QuickPhrase::QuickPhrase(Instance *instance)
             updateUI(inputContext);
         }));
 
-    reloadConfig();
+    dispatcher_.attach(&instance_->eventLoop());
+    // Phrases may be used right away, only reloads happen in the thread.
+    reloadPhrases(false);
+    readConfig();
+
+    auto &watcher = instance_->fileWatcher();
+    for (const char *path :
+         {"data/QuickPhrase.mb", "data/quickphrase.d", "quickphrase.d"}) {
+        fileWatches_.push_back(watcher.watch(StandardPath::Type::PkgData, path,
+                                             [this]() { reloadPhrases(); }));
+    }
+    fileWatches_.push_back(watcher.watch(StandardPath::Type::PkgConfig,
+                                         "conf/quickphrase.conf",
+                                         [this]() { readConfig(); }));
 }
 
-QuickPhrase::~QuickPhrase() {}
+QuickPhrase::~QuickPhrase() {
+    if (loadThread_.joinable()) {
+        loadThread_.join();
+    }
+    dispatcher_.detach();
+}
 
 class QuickPhraseCandidateWord : public CandidateWord {
 public:
@@ -292,54 +311,6 @@ void QuickPhrase::updateUI(InputContext *inputContext) {
     inputContext->updateUserInterface(UserInterfaceComponent::InputPanel);
 }
 
-void QuickPhrase::reloadConfig() {
-    map_.clear();
-    auto file = StandardPath::global().open(StandardPath::Type::PkgData,
-                                            "data/QuickPhrase.mb", O_RDONLY);
-    auto files = StandardPath::global().multiOpen(
-        StandardPath::Type::PkgData, "data/quickphrase.d/", O_RDONLY,
-        filter::Suffix(".mb"));
-    auto disableFiles = StandardPath::global().multiOpen(
-        StandardPath::Type::PkgData, "quickphrase.d/", O_RDONLY,
-        filter::Suffix(".mb.disable"));
-    if (file.fd() >= 0) {
-        load(file);
-    }
-
-    for (auto &p : files) {
-        if (disableFiles.count(p.first)) {
-            continue;
-        }
-        load(p.second);
-    }
-    readAsIni(config_, "conf/quickphrase.conf");
-
-    selectionKeys_.clear();
-    KeySym syms[] = {
-        FcitxKey_1, FcitxKey_2, FcitxKey_3, FcitxKey_4, FcitxKey_5,
-        FcitxKey_6, FcitxKey_7, FcitxKey_8, FcitxKey_9, FcitxKey_0,
-    };
-
-    KeyStates states;
-    switch (config_.chooseModifier.value()) {
-    case QuickPhraseChooseModifier::Alt:
-        states = KeyState::Alt;
-        break;
-    case QuickPhraseChooseModifier::Control:
-        states = KeyState::Ctrl;
-        break;
-    case QuickPhraseChooseModifier::Super:
-        states = KeyState::Super;
-        break;
-    default:
-        break;
-    }
-
-    for (auto sym : syms) {
-        selectionKeys_.emplace_back(sym, states);
-    }
-}
-
 enum class UnescapeState { NORMAL, ESCAPE };
 
 bool _unescape_string(std::string &str, bool unescapeQuote) {
@@ -382,7 +353,8 @@ bool _unescape_string(std::string &str, bool unescapeQuote) {
 }
 
 typedef std::unique_ptr<FILE, decltype(&fclose)> ScopedFILE;
-void QuickPhrase::load(StandardPathFile &file) {
+void loadPhrases(std::multimap<std::string, std::string> &map,
+                 StandardPathFile &file) {
     FILE *f = fdopen(file.fd(), "rb");
     if (!f) {
         return;
@@ -433,12 +405,112 @@ void QuickPhrase::load(StandardPathFile &file) {
         }
         _unescape_string(wordString, escapeQuote);
 
-        map_.emplace(std::move(key), std::move(wordString));
+        map.emplace(std::move(key), std::move(wordString));
     }
 
     free(buf);
 }
 
+void QuickPhrase::reloadConfig() {
+    reloadPhrases();
+    readConfig();
+}
+
+void QuickPhrase::reloadPhrases(bool async) {
+    if (loadThread_.joinable()) {
+        reloadPhrasesAgain_ = true;
+        return;
+    }
+
+    auto file = StandardPath::global().open(StandardPath::Type::PkgData,
+                                            "data/QuickPhrase.mb", O_RDONLY);
+    auto files = StandardPath::global().multiOpen(
+        StandardPath::Type::PkgData, "data/quickphrase.d/", O_RDONLY,
+        filter::Suffix(".mb"));
+    auto disableFiles = StandardPath::global().multiOpen(
+        StandardPath::Type::PkgData, "quickphrase.d/", O_RDONLY,
+        filter::Suffix(".mb.disable"));
+    std::vector<StandardPathFile> phraseFiles;
+    if (file.fd() >= 0) {
+        phraseFiles.push_back(std::move(file));
+    }
+    for (auto &p : files) {
+        if (disableFiles.count(p.first)) {
+            continue;
+        }
+        phraseFiles.push_back(std::move(p.second));
+    }
+
+    // Phrase tables are large, only rebuild them if any file changed.
+    std::vector<FileStamp> phraseStamps(phraseFiles.size());
+    for (size_t i = 0; i < phraseFiles.size(); i++) {
+        readFileStamp(phraseFiles[i].path(), phraseStamps[i]);
+    }
+    if (phraseStamps == phraseStamps_) {
+        return;
+    }
+    phraseStamps_ = std::move(phraseStamps);
+
+    if (!async) {
+        std::multimap<std::string, std::string> map;
+        for (auto &phraseFile : phraseFiles) {
+            loadPhrases(map, phraseFile);
+        }
+        map_ = std::move(map);
+        return;
+    }
+
+    // Parse in a thread, the old phrases are used until it is done.
+    auto load = [this, phraseFiles = std::move(phraseFiles)]() mutable {
+        auto map = std::make_shared<std::multimap<std::string, std::string>>();
+        for (auto &phraseFile : phraseFiles) {
+            loadPhrases(*map, phraseFile);
+        }
+        dispatcher_.schedule([this, map]() {
+            loadThread_.join();
+            map_ = std::move(*map);
+            if (reloadPhrasesAgain_) {
+                reloadPhrasesAgain_ = false;
+                reloadPhrases();
+            }
+        });
+    };
+    loadThread_ = std::thread(std::move(load));
+}
+
+void QuickPhrase::readConfig() {
+    auto changed = reloadAsIni(config_, "conf/quickphrase.conf");
+    if (std::find(changed.begin(), changed.end(),
+                  config_.chooseModifier.path()) == changed.end()) {
+        return;
+    }
+
+    selectionKeys_.clear();
+    KeySym syms[] = {
+        FcitxKey_1, FcitxKey_2, FcitxKey_3, FcitxKey_4, FcitxKey_5,
+        FcitxKey_6, FcitxKey_7, FcitxKey_8, FcitxKey_9, FcitxKey_0,
+    };
+
+    KeyStates states;
+    switch (config_.chooseModifier.value()) {
+    case QuickPhraseChooseModifier::Alt:
+        states = KeyState::Alt;
+        break;
+    case QuickPhraseChooseModifier::Control:
+        states = KeyState::Ctrl;
+        break;
+    case QuickPhraseChooseModifier::Super:
+        states = KeyState::Super;
+        break;
+    default:
+        break;
+    }
+
+    for (auto sym : syms) {
+        selectionKeys_.emplace_back(sym, states);
+    }
+}
+
 void QuickPhrase::trigger(InputContext *ic, const std::string &text,
                           const std::string &prefix, const std::string &str,
                           const std::string &alt, const Key &key) {
@@ -22,6 +22,8 @@
 #include "fcitx-config/configuration.h"
 #include "fcitx-config/enum.h"
 #include "fcitx-config/iniparser.h"
+#include "fcitx-utils/eventdispatcher.h"
+#include "fcitx-utils/filewatcher.h"
 #include "fcitx-utils/i18n.h"
 #include "fcitx-utils/key.h"
 #include "fcitx-utils/standardpath.h"
@@ -31,9 +33,13 @@
 #include "fcitx/instance.h"
 #include "quickphrase_public.h"
 #include <map>
+#include <thread>
+#include <vector>
 
 namespace fcitx {
 
+struct FileStamp;
+
 FCITX_CONFIG_ENUM(QuickPhraseChooseModifier, None, Alt, Control, Super);
 FCITX_CONFIG_ENUM_I18N_ANNOTATION(QuickPhraseChooseModifier, N_("None"),
                                   N_("Alt"), N_("Control"), N_("Super"));
@@ -75,7 +81,6 @@ public:
     }
 
     void reloadConfig() override;
-    void load(StandardPathFile &file);
     void updateUI(InputContext *inputContext);
     auto &factory() { return factory_; }
 
@@ -86,7 +91,18 @@ public:
 private:
     FCITX_ADDON_EXPORT_FUNCTION(QuickPhrase, trigger);
 
+    void reloadPhrases(bool async = true);
+    void readConfig();
+
     std::multimap<std::string, std::string> map_;
+    // Identity of the phrase files map_ is loaded from, or being loaded from
+    // by loadThread_.
+    std::vector<FileStamp> phraseStamps_;
+    EventDispatcher dispatcher_;
+    std::thread loadThread_;
+    bool reloadPhrasesAgain_ = false;
+    std::vector<std::unique_ptr<HandlerTableEntry<FileWatchCallback>>>
+        fileWatches_;
     QuickPhraseConfig config_;
     Instance *instance_;
     std::vector<std::unique_ptr<fcitx::HandlerTableEntry<fcitx::EventHandler>>>
@@ -239,21 +239,25 @@ load_le16(const void* p)
 // Open the dict file, return -1 if failed.
  **/
 std::string SpellCustomDict::locateDictFile(const std::string &lang) {
-    auto templatePath = "spell/" + lang + "_dict.fscd";
+    auto fileName = lang + "_dict.fscd";
     auto &standardPath = StandardPath::global();
     std::string path;
-    standardPath.scanDirectories(
-        StandardPath::Type::PkgData,
-        [&path, &templatePath](const std::string &dirPath, bool isUser) {
-            if (isUser) {
+    // Listing of system directories is cached by StandardPath.
+    standardPath.scanFiles(
+        StandardPath::Type::PkgData, "spell",
+        [&path, &fileName](const std::string &name, const std::string &dir,
+                           bool isUser) {
+            if (isUser || name != fileName) {
                 return true;
             }
-            auto fullPath = stringutils::joinPath(dirPath, templatePath);
-            if (fs::isreg(fullPath)) {
-                path = fullPath;
-                return false;
+            // Only the matching name is checked, a directory or a dangling
+            // link must not hide the dictionary in a later directory.
+            auto fullPath = stringutils::joinPath(dir, name);
+            if (!fs::isreg(fullPath)) {
+                return true;
             }
-            return true;
+            path = std::move(fullPath);
+            return false;
         });
     return path;
 }
@@ -24,9 +24,19 @@
 #include "spell-custom-dict.h"
 
 fcitx::SpellCustom::SpellCustom(fcitx::Spell *spell)
-    : fcitx::SpellBackend(spell) {}
+    : fcitx::SpellBackend(spell) {
+    dispatcher_.attach(&spell->instance()->eventLoop());
+    dictWatch_ = spell->instance()->fileWatcher().watch(
+        fcitx::StandardPath::Type::PkgData, "spell",
+        [this]() { reloadDict(); });
+}
 
-fcitx::SpellCustom::~SpellCustom() {}
+fcitx::SpellCustom::~SpellCustom() {
+    if (loadThread_.joinable()) {
+        loadThread_.join();
+    }
+    dispatcher_.detach();
+}
 
 void fcitx::SpellCustom::addWord(const std::string &, const std::string &) {
     // TODO
@@ -51,6 +61,39 @@ bool fcitx::SpellCustom::loadDict(const std::string &language) {
     return false;
 }
 
+void fcitx::SpellCustom::reloadDict() {
+    if (language_.empty()) {
+        return;
+    }
+    if (loadThread_.joinable()) {
+        reloadDictAgain_ = true;
+        return;
+    }
+    // Dictionary is read as a whole, load it in a thread and keep using the
+    // old one until it is done.
+    loadThread_ = std::thread([this, language = language_]() {
+        auto dict = std::make_shared<std::unique_ptr<SpellCustomDict>>();
+        try {
+            dict->reset(SpellCustomDict::requestDict(language));
+        } catch (const std::exception &) {
+        }
+        dispatcher_.schedule([this, language, dict]() {
+            loadThread_.join();
+            if (language_ == language) {
+                dict_ = std::move(*dict);
+                // Try again on next use if it fails.
+                if (!dict_) {
+                    language_.clear();
+                }
+            }
+            if (reloadDictAgain_) {
+                reloadDictAgain_ = false;
+                reloadDict();
+            }
+        });
+    });
+}
+
 std::vector<std::string> fcitx::SpellCustom::hint(const std::string &language,
                                                   const std::string &str,
                                                   size_t limit) {
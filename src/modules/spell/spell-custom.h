@@ -21,7 +21,10 @@
 #ifndef _FCITX_MODULES_SPELL_SPELL_CUSTOM_H_
 #define _FCITX_MODULES_SPELL_SPELL_CUSTOM_H_
 
+#include "fcitx-utils/eventdispatcher.h"
+#include "fcitx-utils/filewatcher.h"
 #include "spell.h"
+#include <thread>
 
 namespace fcitx {
 
@@ -40,8 +43,13 @@ public:
 
 private:
     bool loadDict(const std::string &language);
+    void reloadDict();
     std::unique_ptr<SpellCustomDict> dict_;
     std::string language_;
+    EventDispatcher dispatcher_;
+    std::thread loadThread_;
+    bool reloadDictAgain_ = false;
+    std::unique_ptr<HandlerTableEntry<FileWatchCallback>> dictWatch_;
 };
 } // namespace fcitx
 
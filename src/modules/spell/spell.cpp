@@ -41,7 +41,7 @@ Spell::Spell(Instance *instance) : instance_(instance) {
 
 Spell::~Spell() {}
 
-void Spell::reloadConfig() { readAsIni(config_, "conf/spell.conf"); }
+void Spell::reloadConfig() { reloadAsIni(config_, "conf/spell.conf"); }
 
 Spell::BackendMap::iterator Spell::findBackend(const std::string &language) {
     for (auto backend : config_.providerOrder.value()) {
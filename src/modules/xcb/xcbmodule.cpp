@@ -29,7 +29,7 @@ XCBModule::XCBModule(Instance *instance) : instance_(instance) {
     openConnection("");
 }
 
-void XCBModule::reloadConfig() { readAsIni(config_, "conf/xcb.conf"); }
+void XCBModule::reloadConfig() { reloadAsIni(config_, "conf/xcb.conf"); }
 
 void XCBModule::openConnection(const std::string &name_) {
     std::string name = name_;
@@ -18,6 +18,8 @@
 //
 
 #include "classicui.h"
+#include "fontwarmup.h"
+#include "inputwindow.h"
 #include "fcitx-config/iniparser.h"
 #include "fcitx-utils/standardpath.h"
 #include "fcitx-utils/utf8.h"
@@ -28,7 +30,9 @@
 #include "notificationitem_public.h"
 #include "waylandui.h"
 #include "xcbui.h"
+#include <chrono>
 #include <fcntl.h>
+#include <pango/pangocairo.h>
 
 namespace fcitx {
 namespace classicui {
@@ -36,6 +40,19 @@ namespace classicui {
 ClassicUI::ClassicUI(Instance *instance)
     : UserInterface(), instance_(instance) {
     reloadConfig();
+    dispatcher_.attach(&instance_->eventLoop());
+    renderWorker_ = std::make_unique<RenderWorker>(dispatcher_);
+
+    auto &watcher = instance_->fileWatcher();
+    fileWatches_.push_back(watcher.watch(StandardPath::Type::PkgConfig,
+                                         "conf/classicui.conf",
+                                         [this]() { reloadConfig(); }));
+    // Desktop settings where the default icon theme is read from.
+    for (const char *path : {"kdeglobals", "gtk-3.0/settings.ini"}) {
+        fileWatches_.push_back(watcher.watch(
+            StandardPath::Type::Config, path, [this]() { reloadIconTheme(); }));
+    }
+    theme_.watchIconTheme(watcher);
 
     if (auto xcbAddon = xcb()) {
         xcbCreatedCallback_ =
@@ -71,18 +88,91 @@ ClassicUI::ClassicUI(Instance *instance)
     }
 }
 
-ClassicUI::~ClassicUI() {}
+ClassicUI::~ClassicUI() {
+    renderWorker_.reset();
+    // Render worker is gone, so it is fine to free it on main thread.
+    workerInputWindow_.reset();
+    if (fontWarmUpThread_.joinable()) {
+        fontWarmUpThread_.join();
+    }
+    if (iconThemeThread_.joinable()) {
+        iconThemeThread_.join();
+    }
+    dispatcher_.detach();
+}
 
 void ClassicUI::reloadConfig() {
-    readAsIni(config_, "conf/classicui.conf");
+    // Theme must not change while render worker is painting with it.
+    if (renderWorker_) {
+        renderWorker_->sync();
+    }
+    reloadAsIni(config_, "conf/classicui.conf");
+    // Font may change even if theme doesn't.
+    configGeneration_++;
+
+    // Loading a theme drops every cached image, skip it unless the theme
+    // or any of its files changed.
+    auto themeDir = stringutils::joinPath("themes", *config_.theme);
+    std::vector<FileStamp> themeStamps;
+    StandardPath::global().scanFiles(
+        StandardPath::Type::PkgData, themeDir,
+        [&themeStamps](const std::string &path, const std::string &dir,
+                       bool) {
+            themeStamps.emplace_back();
+            readFileStamp(stringutils::joinPath(dir, path),
+                          themeStamps.back());
+            return true;
+        });
+    if (*config_.theme == themeName_ && themeStamps == themeStamps_) {
+        return;
+    }
 
     auto themeConfigFile = StandardPath::global().open(
         StandardPath::Type::PkgData,
-        stringutils::joinPath("themes", *config_.theme, "theme.conf"),
-        O_RDONLY);
-    RawConfig themeConfig;
-    readFromIni(themeConfig, themeConfigFile.fd());
-    theme_.load(*config_.theme, themeConfig);
+        stringutils::joinPath(themeDir, "theme.conf"), O_RDONLY);
+    theme_.load(*config_.theme, themeConfigFile.fd());
+    if (!themeWatch_ || themeName_ != *config_.theme) {
+        themeWatch_ = instance_->fileWatcher().watch(
+            StandardPath::Type::PkgData, themeDir,
+            [this]() { reloadConfig(); });
+    }
+    themeName_ = *config_.theme;
+    themeStamps_ = std::move(themeStamps);
+}
+
+void ClassicUI::reloadIconTheme() {
+    if (iconThemeThread_.joinable()) {
+        reloadIconThemeAgain_ = true;
+        return;
+    }
+    // Icon theme reads every index.theme it inherits from, build it in a
+    // thread and only swap it in main thread.
+    iconThemeThread_ = std::thread([this]() {
+        auto iconTheme =
+            std::make_shared<IconTheme>(IconTheme::defaultIconThemeName());
+        dispatcher_.schedule([this, iconTheme]() {
+            iconThemeThread_.join();
+            iconTheme->watch(instance_->fileWatcher());
+            if (renderWorker_) {
+                renderWorker_->sync();
+            }
+            theme_.setIconTheme(std::move(*iconTheme));
+            configGeneration_++;
+            if (reloadIconThemeAgain_) {
+                reloadIconThemeAgain_ = false;
+                reloadIconTheme();
+            }
+        });
+    });
+}
+
+InputWindow &ClassicUI::workerInputWindow() {
+    // Create it lazily, so it is created on render worker and uses the font
+    // map of render worker.
+    if (!workerInputWindow_) {
+        workerInputWindow_ = std::make_unique<InputWindow>(this);
+    }
+    return *workerInputWindow_;
 }
 
 AddonInstance *ClassicUI::xcb() {
@@ -134,8 +224,52 @@ UIInterface *ClassicUI::uiForInputContext(InputContext *inputContext) {
     return iter->second.get();
 }
 
+void ClassicUI::warmUpFont() {
+    // Fontconfig initialization and font matching is slow and would otherwise
+    // happen when input window shows up for the first time. Pango keeps a
+    // default font map per thread, and both the main thread (size hint, menu)
+    // and the render worker (paint) lay out text, so both need to be warmed
+    // up. Fontconfig cache is process wide, so this only needs to happen once.
+    if (fontWarmedUp_ || fontWarmUpThread_.joinable()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    renderWorker_->post(
+        [font = *config_.font]() {
+            warmUpFontMap(pango_cairo_font_map_get_default(), font);
+        },
+        [start]() {
+            CLASSICUI_DEBUG()
+                << "Render worker font warm up finished in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count()
+                << "ms";
+        });
+    // Main thread's font map is prepared in a thread with a private font map,
+    // and becomes the default font map of main thread once it is done.
+    fontWarmUpThread_ = std::thread([this, start, font = *config_.font]() {
+        std::shared_ptr<PangoFontMap> fontMap(pango_cairo_font_map_new(),
+                                              &g_object_unref);
+        warmUpFontMap(fontMap.get(), font);
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+
+        dispatcher_.schedule([this, fontMap, duration]() {
+            fontWarmUpThread_.join();
+            fontWarmedUp_ = true;
+            pango_cairo_font_map_set_default(
+                PANGO_CAIRO_FONT_MAP(fontMap.get()));
+            CLASSICUI_DEBUG() << "Font warm up finished in " << duration
+                              << "ms";
+        });
+    });
+}
+
 void ClassicUI::resume() {
     suspended_ = false;
+    warmUpFont();
     for (auto &p : uis_) {
         p.second->resume();
     }
@@ -24,20 +24,27 @@
 #include "fcitx-config/configuration.h"
 #include "fcitx-config/iniparser.h"
 #include "fcitx-utils/event.h"
+#include "fcitx-utils/eventdispatcher.h"
+#include "fcitx-utils/filewatcher.h"
 #include "fcitx-utils/i18n.h"
 #include "fcitx/addonfactory.h"
 #include "fcitx/addoninstance.h"
 #include "fcitx/addonmanager.h"
+#include "fcitx/binarycache_p.h"
 #include "fcitx/focusgroup.h"
 #include "fcitx/instance.h"
 #include "fcitx/userinterface.h"
+#include "renderworker.h"
 #include "theme.h"
 #include "wayland_public.h"
 #include "xcb_public.h"
+#include <thread>
 
 namespace fcitx {
 namespace classicui {
 
+class InputWindow;
+
 class UIInterface {
 public:
     virtual ~UIInterface() {}
@@ -61,6 +68,8 @@ FCITX_CONFIGURATION(
                                        _("Vertical Candidate List"), false};
     Option<bool> perScreenDPI{this, "PerScreenDPI", _("Use Per Screen DPI"),
                               true};
+    Option<bool> useEGL{this, "UseEGL", _("Use EGL to render on Wayland"),
+                        true};
 
     OptionWithAnnotation<std::string, FontAnnotation> font{this, "Font", "Font",
                                                            "Sans 9"};
@@ -78,9 +87,17 @@ public:
     void setConfig(const RawConfig &config) override {
         config_.load(config, true);
         safeSaveAsIni(config_, "conf/classicui.conf");
+        configGeneration_++;
     }
     auto &config() { return config_; }
     Theme &theme() { return theme_; }
+    // Changes whenever config or theme is reloaded, painted frames of older
+    // generation can't be reused.
+    uint64_t configGeneration() const { return configGeneration_; }
+    RenderWorker *renderWorker() { return renderWorker_.get(); }
+    // Input window that paints on render worker, with its own pango context
+    // of render worker's font map. Only usable from render worker.
+    InputWindow &workerInputWindow();
     void suspend() override;
     void resume() override;
     bool suspended() const { return suspended_; }
@@ -94,6 +111,8 @@ private:
 
     UIInterface *uiForEvent(Event &event);
     UIInterface *uiForInputContext(InputContext *inputContext);
+    void warmUpFont();
+    void reloadIconTheme();
 
     std::unique_ptr<HandlerTableEntry<XCBConnectionCreated>>
         xcbCreatedCallback_;
@@ -113,7 +132,22 @@ private:
     Instance *instance_;
     ClassicUIConfig config_;
     Theme theme_;
+    // Theme name and files theme_ is loaded from.
+    std::string themeName_;
+    std::vector<FileStamp> themeStamps_;
+    uint64_t configGeneration_ = 0;
     bool suspended_ = true;
+
+    EventDispatcher dispatcher_;
+    std::thread fontWarmUpThread_;
+    bool fontWarmedUp_ = false;
+    std::thread iconThemeThread_;
+    bool reloadIconThemeAgain_ = false;
+    std::unique_ptr<HandlerTableEntry<FileWatchCallback>> themeWatch_;
+    std::vector<std::unique_ptr<HandlerTableEntry<FileWatchCallback>>>
+        fileWatches_;
+    std::unique_ptr<RenderWorker> renderWorker_;
+    std::unique_ptr<InputWindow> workerInputWindow_;
 };
 } // namespace classicui
 } // namespace fcitx
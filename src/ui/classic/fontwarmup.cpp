@@ -0,0 +1,47 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "fontwarmup.h"
+#include <memory>
+
+namespace fcitx {
+namespace classicui {
+
+void warmUpFontMap(PangoFontMap *fontMap, const std::string &font) {
+    std::unique_ptr<PangoContext, decltype(&g_object_unref)> context(
+        pango_font_map_create_context(fontMap), &g_object_unref);
+    auto fontDesc = pango_font_description_from_string(font.c_str());
+    pango_context_set_font_description(context.get(), fontDesc);
+    pango_font_description_free(fontDesc);
+    auto metrics = pango_context_get_metrics(
+        context.get(), pango_context_get_font_description(context.get()),
+        pango_context_get_language(context.get()));
+    pango_font_metrics_unref(metrics);
+    // Load glyphs of common scripts, so fallback fonts are resolved too.
+    std::unique_ptr<PangoLayout, decltype(&g_object_unref)> layout(
+        pango_layout_new(context.get()), &g_object_unref);
+    const char sample[] = "Aa1 \xe4\xb8\xad\xe6\x96\x87 \xe3\x81\x82\xe3\x82\xa2 "
+                          "\xed\x95\x9c\xea\xb8\x80";
+    pango_layout_set_text(layout.get(), sample, -1);
+    int width, height;
+    pango_layout_get_pixel_size(layout.get(), &width, &height);
+}
+
+} // namespace classicui
+} // namespace fcitx
@@ -0,0 +1,35 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#ifndef _FCITX_UI_CLASSIC_FONTWARMUP_H_
+#define _FCITX_UI_CLASSIC_FONTWARMUP_H_
+
+#include <pango/pango.h>
+#include <string>
+
+namespace fcitx {
+namespace classicui {
+
+// Resolve font and the fallback fonts of common scripts on fontMap, so the
+// first layout done with this font map does not need to do it.
+void warmUpFontMap(PangoFontMap *fontMap, const std::string &font);
+
+} // namespace classicui
+} // namespace fcitx
+
+#endif // _FCITX_UI_CLASSIC_FONTWARMUP_H_
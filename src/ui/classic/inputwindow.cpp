@@ -170,6 +170,7 @@ void InputWindow::update(InputContext *inputContext) {
     auto instance = parent_->instance();
     auto &inputPanel = inputContext->inputPanel();
     inputContext_ = inputContext->watch();
+    contentChanged_ = true;
 
     cursor_ = -1;
     auto preedit = instance->outputFilter(inputContext, inputPanel.preedit());
@@ -236,6 +237,11 @@ void InputWindow::update(InputContext *inputContext) {
 }
 
 std::pair<unsigned int, unsigned int> InputWindow::sizeHint() {
+    // Pick up the font map prepared by ClassicUI::warmUpFont.
+    auto fontMap = pango_cairo_font_map_get_default();
+    if (pango_context_get_font_map(context_.get()) != fontMap) {
+        pango_context_set_font_map(context_.get(), fontMap);
+    }
     auto fontDesc =
         pango_font_description_from_string(parent_->config().font->c_str());
     pango_context_set_font_description(context_.get(), fontDesc);
@@ -278,12 +284,7 @@ std::pair<unsigned int, unsigned int> InputWindow::sizeHint() {
         updateIfLarger(width, w + extraW);
     }
 
-    bool vertical = parent_->config().verticalCandidateList.value();
-    if (layoutHint_ == CandidateLayoutHint::Vertical) {
-        vertical = true;
-    } else if (layoutHint_ == CandidateLayoutHint::Horizontal) {
-        vertical = false;
-    }
+    bool vertical = isVertical();
 
     size_t wholeH = 0, wholeW = 0;
     for (size_t i = 0; i < nCandidates_; i++) {
@@ -395,15 +396,12 @@ void InputWindow::paint(cairo_t *cr, unsigned int width, unsigned int height) {
         currentHeight += h + extraH;
     }
 
-    bool vertical = parent_->config().verticalCandidateList.value();
-    if (layoutHint_ == CandidateLayoutHint::Vertical) {
-        vertical = true;
-    } else if (layoutHint_ == CandidateLayoutHint::Horizontal) {
-        vertical = false;
-    }
+    bool vertical = isVertical();
 
     candidateRegions_.clear();
     candidateRegions_.reserve(nCandidates_);
+    highlightRegions_.clear();
+    highlightRegions_.reserve(nCandidates_);
     size_t wholeW = 0, wholeH = 0;
     for (size_t i = 0; i < nCandidates_; i++) {
         int x, y;
@@ -478,6 +476,15 @@ void InputWindow::paint(cairo_t *cr, unsigned int width, unsigned int height) {
                          *highlightMargin.marginBottom -
                          *clickMargin.marginTop - *clickMargin.marginBottom);
         candidateRegions_.push_back(candidateRegion);
+        Rect highlightRegion;
+        highlightRegion
+            .setPosition(*margin.marginLeft + x - *highlightMargin.marginLeft,
+                         *margin.marginTop + y - *highlightMargin.marginTop)
+            .setSize(highlightWidth + *highlightMargin.marginLeft +
+                         *highlightMargin.marginRight,
+                     vheight + *highlightMargin.marginTop +
+                         *highlightMargin.marginBottom);
+        highlightRegions_.push_back(highlightRegion);
         if (pango_layout_get_character_count(labelLayouts_[i].get())) {
             cairo_move_to(cr, x, y + (vheight - labelH) / 2.0);
             renderLayout(cr, labelLayouts_[i].get());
@@ -490,6 +497,302 @@ void InputWindow::paint(cairo_t *cr, unsigned int width, unsigned int height) {
     cairo_restore(cr);
 }
 
+bool InputWindow::isVertical() const {
+    if (layoutHint_ == CandidateLayoutHint::Vertical) {
+        return true;
+    }
+    if (layoutHint_ == CandidateLayoutHint::Horizontal) {
+        return false;
+    }
+    return parent_->config().verticalCandidateList.value();
+}
+
+using PangoAttrListPtr =
+    std::unique_ptr<PangoAttrList, decltype(&pango_attr_list_unref)>;
+
+struct LayoutSnapshot {
+    LayoutSnapshot(PangoLayout *layout, PangoAttrList *attrs)
+        : text(pango_layout_get_text(layout)),
+          attrs(attrs ? pango_attr_list_copy(attrs) : pango_attr_list_new(),
+                &pango_attr_list_unref) {}
+
+    std::string text;
+    PangoAttrListPtr attrs;
+};
+
+// Plain data copy of everything InputWindow::paint needs, so it can be
+// painted from another thread with a separate pango context.
+struct InputWindowSnapshot {
+    std::unique_ptr<PangoFontDescription,
+                    decltype(&pango_font_description_free)>
+        fontDesc{nullptr, &pango_font_description_free};
+    std::unique_ptr<cairo_font_options_t, decltype(&cairo_font_options_destroy)>
+        fontOptions{nullptr, &cairo_font_options_destroy};
+    double resolution = -1;
+    std::vector<LayoutSnapshot> layouts;
+    std::vector<LayoutSnapshot> labels;
+    std::vector<LayoutSnapshot> candidates;
+    std::vector<PangoAttrListPtr> highlightLabels;
+    std::vector<PangoAttrListPtr> highlightCandidates;
+    int cursor = 0;
+    int candidateIndex = -1;
+    int hoverIndex = -1;
+    size_t candidatesHeight = 0;
+    CandidateLayoutHint layoutHint = CandidateLayoutHint::NotSet;
+};
+
+std::shared_ptr<InputWindowSnapshot> InputWindow::snapshot() const {
+    auto result = std::make_shared<InputWindowSnapshot>();
+    if (auto fontDesc = pango_context_get_font_description(context_.get())) {
+        result->fontDesc.reset(pango_font_description_copy(fontDesc));
+    }
+    if (auto fontOptions =
+            pango_cairo_context_get_font_options(context_.get())) {
+        result->fontOptions.reset(cairo_font_options_copy(fontOptions));
+    }
+    result->resolution = pango_cairo_context_get_resolution(context_.get());
+    for (auto *layout : {upperLayout_.get(), lowerLayout_.get()}) {
+        result->layouts.emplace_back(layout,
+                                     pango_layout_get_attributes(layout));
+    }
+    for (size_t i = 0; i < nCandidates_; i++) {
+        result->labels.emplace_back(labelLayouts_[i].get(),
+                                    labelAttrLists_[i].get());
+        result->candidates.emplace_back(candidateLayouts_[i].get(),
+                                        candidateAttrLists_[i].get());
+        result->highlightLabels.emplace_back(
+            pango_attr_list_copy(highlightLabelAttrLists_[i].get()),
+            &pango_attr_list_unref);
+        result->highlightCandidates.emplace_back(
+            pango_attr_list_copy(highlightCandidateAttrLists_[i].get()),
+            &pango_attr_list_unref);
+    }
+    result->cursor = cursor_;
+    result->candidateIndex = candidateIndex_;
+    result->hoverIndex = hoverIndex_;
+    result->candidatesHeight = candidatesHeight_;
+    // Resolve it here, so config is never touched by render thread.
+    result->layoutHint = isVertical() ? CandidateLayoutHint::Vertical
+                                      : CandidateLayoutHint::Horizontal;
+    return result;
+}
+
+void InputWindow::restore(const InputWindowSnapshot &snapshot) {
+    if (snapshot.fontDesc) {
+        pango_context_set_font_description(context_.get(),
+                                           snapshot.fontDesc.get());
+    }
+    if (snapshot.fontOptions) {
+        pango_cairo_context_set_font_options(context_.get(),
+                                             snapshot.fontOptions.get());
+    }
+    pango_cairo_context_set_resolution(context_.get(), snapshot.resolution);
+    auto restoreLayout = [](PangoLayout *layout,
+                            const LayoutSnapshot &layoutSnapshot) {
+        pango_layout_set_text(layout, layoutSnapshot.text.c_str(),
+                              layoutSnapshot.text.size());
+        pango_layout_set_attributes(layout, layoutSnapshot.attrs.get());
+        pango_layout_set_height(layout, -(2 << 20));
+    };
+    pango_layout_set_single_paragraph_mode(upperLayout_.get(), true);
+    restoreLayout(upperLayout_.get(), snapshot.layouts[0]);
+    restoreLayout(lowerLayout_.get(), snapshot.layouts[1]);
+    resizeCandidates(snapshot.labels.size());
+    for (size_t i = 0; i < nCandidates_; i++) {
+        restoreLayout(labelLayouts_[i].get(), snapshot.labels[i]);
+        restoreLayout(candidateLayouts_[i].get(), snapshot.candidates[i]);
+        labelAttrLists_[i].reset(
+            pango_attr_list_ref(snapshot.labels[i].attrs.get()));
+        candidateAttrLists_[i].reset(
+            pango_attr_list_ref(snapshot.candidates[i].attrs.get()));
+        highlightLabelAttrLists_[i].reset(
+            pango_attr_list_ref(snapshot.highlightLabels[i].get()));
+        highlightCandidateAttrLists_[i].reset(
+            pango_attr_list_ref(snapshot.highlightCandidates[i].get()));
+    }
+    cursor_ = snapshot.cursor;
+    candidateIndex_ = snapshot.candidateIndex;
+    hoverIndex_ = snapshot.hoverIndex;
+    candidatesHeight_ = snapshot.candidatesHeight;
+    layoutHint_ = snapshot.layoutHint;
+}
+
+void InputWindow::copySurface(cairo_surface_t *target,
+                              cairo_surface_t *image) {
+    auto cr = cairo_create(target);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, image, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+}
+
+void InputWindow::paintAsync(
+    unsigned int width, unsigned int height,
+    std::function<void(cairo_surface_t *, cairo_surface_t *, const Rect &)>
+        present) {
+    pendingPaint_.reset(new PaintRequest{width, height, std::move(present)});
+    if (!painting_) {
+        startPaint();
+    }
+}
+
+using CairoSurfacePtr =
+    std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)>;
+
+struct PaintResult {
+    CairoSurfacePtr image{nullptr, &cairo_surface_destroy};
+    // Image that damage is relative to.
+    CairoSurfacePtr base{nullptr, &cairo_surface_destroy};
+    Rect damage;
+    std::vector<Rect> candidateRegions;
+    std::vector<Rect> highlightRegions;
+    int highlight = -1;
+};
+
+namespace {
+
+bool sameSize(cairo_surface_t *image, unsigned int width, unsigned int height) {
+    return image &&
+           cairo_image_surface_get_width(image) == static_cast<int>(width) &&
+           cairo_image_surface_get_height(image) == static_cast<int>(height);
+}
+
+// Fill result with the painted image of renderer. If previous is not null, it
+// is the last frame of same content and size, so only highlight may differ
+// from it.
+void paintFrame(InputWindow &renderer, const PaintResult *previous,
+                PaintResult &result, unsigned int width, unsigned int height,
+                int highlight) {
+    result.highlight = highlight;
+    if (previous && previous->highlight == highlight) {
+        // Nothing changed, e.g. pointer moves within the same candidate.
+        result.image.reset(cairo_surface_reference(previous->image.get()));
+        result.base.reset(cairo_surface_reference(previous->image.get()));
+        result.damage = Rect();
+        result.candidateRegions = previous->candidateRegions;
+        result.highlightRegions = previous->highlightRegions;
+        return;
+    }
+
+    result.image.reset(
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height));
+    auto cr = cairo_create(result.image.get());
+    renderer.paint(cr, width, height);
+    cairo_destroy(cr);
+    cairo_surface_flush(result.image.get());
+    renderer.takeRegions(result.candidateRegions, result.highlightRegions);
+
+    const Rect whole(0, 0, width - 1, height - 1);
+    result.damage = whole;
+    if (!previous ||
+        previous->highlightRegions.size() != result.highlightRegions.size()) {
+        return;
+    }
+    // Layout is the same, so only the old and new highlighted candidates
+    // are repainted.
+    bool hasDamage = false;
+    for (int index : {previous->highlight, highlight}) {
+        if (index < 0 ||
+            static_cast<size_t>(index) >= result.highlightRegions.size()) {
+            continue;
+        }
+        const auto &region = result.highlightRegions[index];
+        if (!hasDamage) {
+            result.damage = region;
+            hasDamage = true;
+            continue;
+        }
+        result.damage =
+            Rect(std::min(result.damage.left(), region.left()),
+                 std::min(result.damage.top(), region.top()),
+                 std::max(result.damage.right(), region.right()),
+                 std::max(result.damage.bottom(), region.bottom()));
+    }
+    if (!hasDamage) {
+        result.damage = whole;
+        return;
+    }
+    result.damage = Rect(std::max(result.damage.left(), whole.left()),
+                         std::max(result.damage.top(), whole.top()),
+                         std::min(result.damage.right(), whole.right()),
+                         std::min(result.damage.bottom(), whole.bottom()));
+    if (result.damage.width() <= 0 || result.damage.height() <= 0) {
+        result.damage = whole;
+        return;
+    }
+    result.base.reset(cairo_surface_reference(previous->image.get()));
+}
+
+} // namespace
+
+void InputWindow::takeRegions(std::vector<Rect> &candidateRegions,
+                              std::vector<Rect> &highlightRegions) {
+    candidateRegions = std::move(candidateRegions_);
+    highlightRegions = std::move(highlightRegions_);
+}
+
+void InputWindow::startPaint() {
+    auto request = std::move(pendingPaint_);
+    auto result = std::make_shared<PaintResult>();
+    auto width = request->width, height = request->height;
+    // Only hover may happen since last paint, which just moves highlight.
+    // Theme, font or frame size change invalidates every pixel.
+    std::shared_ptr<const PaintResult> previous;
+    if (!contentChanged_ && lastPaint_ &&
+        lastPaintGeneration_ == parent_->configGeneration() &&
+        sameSize(lastPaint_->image.get(), width, height)) {
+        previous = lastPaint_;
+    }
+    contentChanged_ = false;
+    lastPaintGeneration_ = parent_->configGeneration();
+    auto highlight = this->highlight();
+
+    auto *worker = parent_->renderWorker();
+    if (!worker) {
+        {
+            auto lock = parent_->theme().lock();
+            paintFrame(*this, previous.get(), *result, width, height,
+                       highlight);
+        }
+        candidateRegions_ = result->candidateRegions;
+        lastPaint_ = result;
+        request->present(result->image.get(), result->base.get(),
+                         result->damage);
+        return;
+    }
+
+    // The default font map is per thread, so the worker input window only
+    // shares theme with main thread. It is reused by every paint, so the
+    // pango context and layouts are kept across paints. Damage is computed
+    // here too, so main thread only needs to upload it.
+    auto job = [parent = parent_, snapshot = this->snapshot(), previous,
+                result, width, height, highlight]() {
+        auto &renderer = parent->workerInputWindow();
+        renderer.restore(*snapshot);
+        auto lock = parent->theme().lock();
+        paintFrame(renderer, previous.get(), *result, width, height,
+                   highlight);
+    };
+
+    painting_ = true;
+    worker->post(std::move(job), [ref = watch(), result,
+                                  present = std::move(request->present)]() {
+        auto that = ref.get();
+        if (!that) {
+            return;
+        }
+        that->painting_ = false;
+        // result is kept as lastPaint_ and read by next paint, copy instead
+        // of move.
+        that->candidateRegions_ = result->candidateRegions;
+        that->lastPaint_ = result;
+        present(result->image.get(), result->base.get(), result->damage);
+        if (that->pendingPaint_) {
+            that->startPaint();
+        }
+    });
+}
+
 void InputWindow::click(int x, int y) {
     auto inputContext = inputContext_.get();
     if (!inputContext) {
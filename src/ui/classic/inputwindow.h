@@ -19,9 +19,12 @@
 #ifndef _FCITX_UI_CLASSIC_INPUTWINDOW_H_
 #define _FCITX_UI_CLASSIC_INPUTWINDOW_H_
 
+#include "fcitx-utils/trackableobject.h"
 #include "fcitx/candidatelist.h"
 #include "fcitx/inputcontext.h"
 #include <cairo/cairo.h>
+#include <functional>
+#include <memory>
 #include <pango/pango.h>
 #include <utility>
 
@@ -29,8 +32,10 @@ namespace fcitx {
 namespace classicui {
 
 class ClassicUI;
+struct InputWindowSnapshot;
+struct PaintResult;
 
-class InputWindow {
+class InputWindow : public TrackableObject<InputWindow> {
 public:
     InputWindow(ClassicUI *parent);
     void update(InputContext *inputContext);
@@ -40,6 +45,9 @@ public:
     bool visible() const { return visible_; }
     void hover(int x, int y);
     void click(int x, int y);
+    // Move out the candidate and highlight regions of last paint.
+    void takeRegions(std::vector<Rect> &candidateRegions,
+                     std::vector<Rect> &highlightRegions);
 
 protected:
     void resizeCandidates(size_t s);
@@ -52,6 +60,19 @@ protected:
         PangoAttrList *highlightAttrList,
         std::initializer_list<std::reference_wrapper<const Text>> texts);
     int highlight() const;
+    bool isVertical() const;
+
+    // Paint current content with the render worker of ClassicUI, present is
+    // called on main thread with the painted image. damage is the part of
+    // image that differs from base, which is a previously painted image or
+    // null if the whole image is new. Requests made while a paint is in
+    // progress are coalesced into one.
+    void paintAsync(unsigned int width, unsigned int height,
+                    std::function<void(cairo_surface_t *image,
+                                       cairo_surface_t *base,
+                                       const Rect &damage)>
+                        present);
+    static void copySurface(cairo_surface_t *target, cairo_surface_t *image);
 
     ClassicUI *parent_;
     std::unique_ptr<PangoContext, decltype(&g_object_unref)> context_;
@@ -74,6 +95,8 @@ protected:
         std::unique_ptr<PangoAttrList, decltype(&pango_attr_list_unref)>>
         highlightCandidateAttrLists_;
     std::vector<Rect> candidateRegions_;
+    // Highlight background of each candidate, in window coordinates.
+    std::vector<Rect> highlightRegions_;
     TrackableObjectReference<InputContext> inputContext_;
     bool visible_ = false;
     int cursor_ = 0;
@@ -83,6 +106,26 @@ protected:
     CandidateLayoutHint layoutHint_ = CandidateLayoutHint::NotSet;
     size_t candidatesHeight_ = 0;
     int hoverIndex_ = -1;
+
+private:
+    struct PaintRequest {
+        unsigned int width;
+        unsigned int height;
+        std::function<void(cairo_surface_t *, cairo_surface_t *, const Rect &)>
+            present;
+    };
+
+    void startPaint();
+    std::shared_ptr<InputWindowSnapshot> snapshot() const;
+    void restore(const InputWindowSnapshot &snapshot);
+
+    std::unique_ptr<PaintRequest> pendingPaint_;
+    bool painting_ = false;
+    // Last painted frame, the next one only differs from it by highlight if
+    // content, size and config are not updated in between.
+    std::shared_ptr<PaintResult> lastPaint_;
+    bool contentChanged_ = true;
+    uint64_t lastPaintGeneration_ = 0;
 };
 } // namespace classicui
 } // namespace fcitx
@@ -0,0 +1,73 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "renderworker.h"
+
+namespace fcitx {
+namespace classicui {
+
+RenderWorker::RenderWorker(EventDispatcher &dispatcher)
+    : dispatcher_(dispatcher), thread_(&RenderWorker::run, this) {}
+
+RenderWorker::~RenderWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void RenderWorker::post(std::function<void()> job,
+                        std::function<void()> done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.emplace(std::move(job), std::move(done));
+    }
+    cond_.notify_all();
+}
+
+void RenderWorker::sync() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return jobs_.empty() && !busy_; });
+}
+
+void RenderWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cond_.wait(lock, [this]() { return quit_ || !jobs_.empty(); });
+        if (quit_) {
+            break;
+        }
+        auto job = std::move(jobs_.front());
+        jobs_.pop();
+        busy_ = true;
+        lock.unlock();
+
+        job.first();
+        dispatcher_.schedule(std::move(job.second));
+
+        lock.lock();
+        busy_ = false;
+        cond_.notify_all();
+    }
+}
+
+} // namespace classicui
+} // namespace fcitx
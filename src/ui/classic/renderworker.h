@@ -0,0 +1,59 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#ifndef _FCITX_UI_CLASSIC_RENDERWORKER_H_
+#define _FCITX_UI_CLASSIC_RENDERWORKER_H_
+
+#include "fcitx-utils/eventdispatcher.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace fcitx {
+namespace classicui {
+
+// A single thread that runs paint jobs off the main event loop. The result is
+// handed back to main thread through EventDispatcher.
+class RenderWorker {
+public:
+    RenderWorker(EventDispatcher &dispatcher);
+    ~RenderWorker();
+
+    // Run job on render thread, and then done on main thread.
+    void post(std::function<void()> job, std::function<void()> done);
+    // Block until all posted jobs are executed.
+    void sync();
+
+private:
+    void run();
+
+    EventDispatcher &dispatcher_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::queue<std::pair<std::function<void()>, std::function<void()>>> jobs_;
+    bool busy_ = false;
+    bool quit_ = false;
+    std::thread thread_;
+};
+
+} // namespace classicui
+} // namespace fcitx
+
+#endif // _FCITX_UI_CLASSIC_RENDERWORKER_H_
@@ -18,11 +18,13 @@
 //
 
 #include "theme.h"
+#include "fcitx-config/iniparser.h"
 #include "fcitx-utils/fs.h"
 #include "fcitx-utils/log.h"
 #include "fcitx-utils/standardpath.h"
 #include "fcitx/misc_p.h"
 #include <cassert>
+#include <cmath>
 #include <fcntl.h>
 #include <fmt/format.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -48,6 +50,33 @@ cairo_status_t readFromFd(void *closure, unsigned char *data,
     return CAIRO_STATUS_SUCCESS;
 }
 
+namespace {
+
+// Same rounding as cairo/gdk use for premultiplication, (c * a) / 255.
+inline uint32_t premultiply(uint32_t c, uint32_t a) {
+    uint32_t t = c * a + 0x80;
+    return ((t >> 8) + t) >> 8;
+}
+
+// Both row converters work on whole native-endian ARGB32 words without any
+// per-pixel branch, so the compiler is able to vectorize the loop.
+void convertRGBRow(const uint8_t *p, uint32_t *q, int width) {
+    for (int i = 0; i < width; i++, p += 3) {
+        q[i] = 0xff000000U | (static_cast<uint32_t>(p[0]) << 16) |
+               (static_cast<uint32_t>(p[1]) << 8) | p[2];
+    }
+}
+
+void convertRGBARow(const uint8_t *p, uint32_t *q, int width) {
+    for (int i = 0; i < width; i++, p += 4) {
+        uint32_t a = p[3];
+        q[i] = (a << 24) | (premultiply(p[0], a) << 16) |
+               (premultiply(p[1], a) << 8) | premultiply(p[2], a);
+    }
+}
+
+} // namespace
+
 cairo_surface_t *pixBufToCairoSurface(GdkPixbuf *image) {
     cairo_format_t format;
     cairo_surface_t *surface;
@@ -60,12 +89,6 @@ cairo_surface_t *pixBufToCairoSurface(GdkPixbuf *image) {
     surface = cairo_image_surface_create(format, gdk_pixbuf_get_width(image),
                                          gdk_pixbuf_get_height(image));
 
-    gint width, height;
-    guchar *gdk_pixels, *cairo_pixels;
-    int gdk_rowstride, cairo_stride;
-    int n_channels;
-    int j;
-
     if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
         cairo_surface_destroy(surface);
         return nullptr;
@@ -73,67 +96,18 @@ cairo_surface_t *pixBufToCairoSurface(GdkPixbuf *image) {
 
     cairo_surface_flush(surface);
 
-    width = gdk_pixbuf_get_width(image);
-    height = gdk_pixbuf_get_height(image);
-    gdk_pixels = gdk_pixbuf_get_pixels(image);
-    gdk_rowstride = gdk_pixbuf_get_rowstride(image);
-    n_channels = gdk_pixbuf_get_n_channels(image);
-    cairo_stride = cairo_image_surface_get_stride(surface);
-    cairo_pixels = cairo_image_surface_get_data(surface);
-
-    for (j = height; j; j--) {
-        guchar *p = gdk_pixels;
-        guchar *q = cairo_pixels;
-
-        if (n_channels == 3) {
-            guchar *end = p + 3 * width;
-
-            while (p < end) {
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-                q[0] = p[2];
-                q[1] = p[1];
-                q[2] = p[0];
-                q[3] = 0xFF;
-#else
-                q[0] = 0xFF;
-                q[1] = p[0];
-                q[2] = p[1];
-                q[3] = p[2];
-#endif
-                p += 3;
-                q += 4;
-            }
-        } else {
-            guchar *end = p + 4 * width;
-            guint t1, t2, t3;
-
-#define MULT(d, c, a, t)                                                       \
-    G_STMT_START {                                                             \
-        t = c * a + 0x80;                                                      \
-        d = ((t >> 8) + t) >> 8;                                               \
-    }                                                                          \
-    G_STMT_END
-
-            while (p < end) {
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-                MULT(q[0], p[2], p[3], t1);
-                MULT(q[1], p[1], p[3], t2);
-                MULT(q[2], p[0], p[3], t3);
-                q[3] = p[3];
-#else
-                q[0] = p[3];
-                MULT(q[1], p[0], p[3], t1);
-                MULT(q[2], p[1], p[3], t2);
-                MULT(q[3], p[2], p[3], t3);
-#endif
-
-                p += 4;
-                q += 4;
-            }
-
-#undef MULT
-        }
-
+    const int width = gdk_pixbuf_get_width(image);
+    const int height = gdk_pixbuf_get_height(image);
+    const guchar *gdk_pixels = gdk_pixbuf_get_pixels(image);
+    const int gdk_rowstride = gdk_pixbuf_get_rowstride(image);
+    const int cairo_stride = cairo_image_surface_get_stride(surface);
+    guchar *cairo_pixels = cairo_image_surface_get_data(surface);
+    auto convertRow = gdk_pixbuf_get_n_channels(image) == 3 ? convertRGBRow
+                                                            : convertRGBARow;
+
+    for (int j = 0; j < height; j++) {
+        convertRow(gdk_pixels, reinterpret_cast<uint32_t *>(cairo_pixels),
+                   width);
         gdk_pixels += gdk_rowstride;
         cairo_pixels += cairo_stride;
     }
@@ -256,26 +230,22 @@ Theme::Theme() : iconTheme_(IconTheme::defaultIconThemeName()) {}
 
 Theme::~Theme() {}
 
-const ThemeImage &Theme::loadBackground(const BackgroundImageConfig &cfg) {
-    if (auto image = findValue(backgroundImageTable_, &cfg)) {
-        return *image;
-    }
-
-    auto result = backgroundImageTable_.emplace(
-        std::piecewise_construct, std::forward_as_tuple(&cfg),
-        std::forward_as_tuple(name_, cfg));
-    assert(result.second);
-    return result.first->second;
+std::shared_ptr<const ThemeImage>
+Theme::loadBackground(const BackgroundImageConfig &cfg) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return backgroundImage(cfg);
 }
 
-const ThemeImage &Theme::loadImage(const std::string &icon,
-                                   const std::string &label, uint32_t size,
-                                   ImagePurpose purpose) {
+std::shared_ptr<const ThemeImage> Theme::loadImage(const std::string &icon,
+                                                   const std::string &label,
+                                                   uint32_t size,
+                                                   ImagePurpose purpose) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     auto &map =
         purpose == ImagePurpose::General ? imageTable_ : trayImageTable_;
     auto name = stringutils::concat("icon:", icon, "label:", label);
     if (auto image = findValue(map, name)) {
-        if (image->size() == size) {
+        if ((*image)->size() == size) {
             return *image;
         }
         map.erase(name);
@@ -287,15 +257,17 @@ const ThemeImage &Theme::loadImage(const std::string &icon,
     }
 
     auto result = map.emplace(
-        std::piecewise_construct, std::forward_as_tuple(name),
-        std::forward_as_tuple(iconPath, label, *config->trayFont, size));
+        name, std::make_shared<ThemeImage>(iconPath, label, *config->trayFont,
+                                           size));
     assert(result.second);
     return result.first->second;
 }
 
-void Theme::paint(cairo_t *c, const BackgroundImageConfig &cfg, int width,
-                  int height) {
-    const ThemeImage &image = loadBackground(cfg);
+namespace {
+
+// Draw the 9-slice background, width and height must be already resolved.
+void paintTile(cairo_t *c, cairo_surface_t *image,
+               const BackgroundImageConfig &cfg, int width, int height) {
     auto marginTop = *cfg.margin->marginTop;
     auto marginBottom = *cfg.margin->marginBottom;
     auto marginLeft = *cfg.margin->marginLeft;
@@ -313,14 +285,6 @@ void Theme::paint(cairo_t *c, const BackgroundImageConfig &cfg, int width,
         resizeWidth = 1;
     }
 
-    if (height < 0) {
-        height = resizeHeight;
-    }
-
-    if (width < 0) {
-        width = resizeWidth;
-    }
-
     cairo_save(c);
 
     /*
@@ -464,11 +428,119 @@ void Theme::paint(cairo_t *c, const BackgroundImageConfig &cfg, int width,
     cairo_restore(c);
 }
 
-void Theme::load(const std::string &name, const RawConfig &rawConfig) {
+} // namespace
+
+cairo_surface_t *ThemeImage::scaledBackground(const BackgroundImageConfig &cfg,
+                                              int width, int height,
+                                              double scaleX, double scaleY) {
+    for (auto iter = scaledImages_.begin(), end = scaledImages_.end();
+         iter != end; ++iter) {
+        if (iter->width == width && iter->height == height &&
+            iter->scaleX == scaleX && iter->scaleY == scaleY) {
+            // Keep the most recently used one at front.
+            scaledImages_.splice(scaledImages_.begin(), scaledImages_, iter);
+            return scaledImages_.front().surface.get();
+        }
+    }
+
+    std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> surface(
+        cairo_image_surface_create(
+            CAIRO_FORMAT_ARGB32, static_cast<int>(std::ceil(width * scaleX)),
+            static_cast<int>(std::ceil(height * scaleY))),
+        &cairo_surface_destroy);
+    if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS) {
+        return nullptr;
+    }
+    cairo_surface_set_device_scale(surface.get(), scaleX, scaleY);
+    auto cr = cairo_create(surface.get());
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    paintTile(cr, image_.get(), cfg, width, height);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface.get());
+
+    if (scaledImages_.size() >= maxScaledImages) {
+        scaledImages_.pop_back();
+    }
+    scaledImages_.push_front(
+        {width, height, scaleX, scaleY, std::move(surface)});
+    return scaledImages_.front().surface.get();
+}
+
+const std::shared_ptr<ThemeImage> &
+Theme::backgroundImage(const BackgroundImageConfig &cfg) {
+    if (auto image = findValue(backgroundImageTable_, &cfg)) {
+        return *image;
+    }
+
+    auto result = backgroundImageTable_.emplace(
+        &cfg, std::make_shared<ThemeImage>(name_, cfg));
+    assert(result.second);
+    return result.first->second;
+}
+
+void Theme::paint(cairo_t *c, const BackgroundImageConfig &cfg, int width,
+                  int height) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    ThemeImage &image = *backgroundImage(cfg);
+    if (height < 0) {
+        height = std::max(image.height() - *cfg.margin->marginTop -
+                              *cfg.margin->marginBottom,
+                          1);
+    }
+
+    if (width < 0) {
+        width = std::max(image.width() - *cfg.margin->marginLeft -
+                             *cfg.margin->marginRight,
+                         1);
+    }
+
+    // Pre-scaled image is only usable if target is not rotated or skewed,
+    // which is never the case for classic ui, but keep the slow path anyway.
+    cairo_matrix_t matrix;
+    cairo_get_matrix(c, &matrix);
+    double deviceScaleX = 1, deviceScaleY = 1;
+    cairo_surface_get_device_scale(cairo_get_target(c), &deviceScaleX,
+                                   &deviceScaleY);
+    double scaleX = matrix.xx * deviceScaleX;
+    double scaleY = matrix.yy * deviceScaleY;
+    cairo_surface_t *scaled = nullptr;
+    if (matrix.xy == 0 && matrix.yx == 0 && scaleX > 0 && scaleY > 0) {
+        scaled = image.scaledBackground(cfg, width, height, scaleX, scaleY);
+    }
+
+    if (!scaled) {
+        paintTile(c, image, cfg, width, height);
+        return;
+    }
+
+    // Scaled image already has the same pixel density as target, so this is
+    // a plain blit.
+    cairo_save(c);
+    cairo_rectangle(c, 0, 0, width, height);
+    cairo_clip(c);
+    cairo_set_source_surface(c, scaled, 0, 0);
+    cairo_paint(c);
+    cairo_restore(c);
+}
+
+void Theme::load(const std::string &name, int fd) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
     imageTable_.clear();
     trayImageTable_.clear();
     backgroundImageTable_.clear();
-    Configuration::load(rawConfig);
+    readFromIni(*this, fd);
     name_ = name;
 }
+
+void Theme::setIconTheme(IconTheme iconTheme) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    imageTable_.clear();
+    trayImageTable_.clear();
+    iconTheme_ = std::move(iconTheme);
+}
+
+void Theme::watchIconTheme(FileWatcher &watcher) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    iconTheme_.watch(watcher);
+}
 } // namespace fcitx
@@ -24,6 +24,9 @@
 #include "fcitx-utils/log.h"
 #include "fcitx/icontheme.h"
 #include <cairo/cairo.h>
+#include <list>
+#include <memory>
+#include <mutex>
 
 namespace fcitx {
 
@@ -140,10 +143,29 @@ public:
 
     auto size() { return size_; }
 
+    // Return the image rendered as 9-slice background of given size and
+    // scale. The result is cached, so painting the same size again is a
+    // plain blit.
+    cairo_surface_t *scaledBackground(const BackgroundImageConfig &cfg,
+                                      int width, int height, double scaleX,
+                                      double scaleY);
+
 private:
+    struct ScaledImage {
+        int width;
+        int height;
+        double scaleX;
+        double scaleY;
+        std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)>
+            surface;
+    };
+    // Input panel size changes with content, keep only a few of them.
+    static constexpr size_t maxScaledImages = 8;
+
     std::string currentText_;
     uint32_t size_ = 0;
     std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> image_;
+    std::list<ScaledImage> scaledImages_;
 };
 
 class Theme : public ThemeConfig {
@@ -151,22 +173,40 @@ public:
     Theme();
     ~Theme();
 
-    void load(const std::string &name, const RawConfig &rawConfig);
-    const ThemeImage &loadImage(const std::string &icon,
-                                const std::string &label, uint32_t size,
-                                ImagePurpose purpose = ImagePurpose::General);
-    const ThemeImage &loadBackground(const BackgroundImageConfig &cfg);
+    // Load theme.conf from fd.
+    void load(const std::string &name, int fd);
+    void setIconTheme(IconTheme iconTheme);
+    void watchIconTheme(FileWatcher &watcher);
+    // Images are shared, so they stay valid even if theme is reloaded while
+    // they are used.
+    std::shared_ptr<const ThemeImage>
+    loadImage(const std::string &icon, const std::string &label,
+              uint32_t size, ImagePurpose purpose = ImagePurpose::General);
+    std::shared_ptr<const ThemeImage>
+    loadBackground(const BackgroundImageConfig &cfg);
 
     void paint(cairo_t *c, const BackgroundImageConfig &cfg, int width,
                int height);
 
+    // Theme is shared between main thread and render worker. Render worker
+    // holds it for a whole paint, since it reads the theme config too.
+    std::unique_lock<std::recursive_mutex> lock() {
+        return std::unique_lock<std::recursive_mutex>(mutex_);
+    }
+
 private:
-    std::unordered_map<const BackgroundImageConfig *, ThemeImage>
+    const std::shared_ptr<ThemeImage> &
+    backgroundImage(const BackgroundImageConfig &cfg);
+
+    std::unordered_map<const BackgroundImageConfig *,
+                       std::shared_ptr<ThemeImage>>
         backgroundImageTable_;
-    std::unordered_map<std::string, ThemeImage> imageTable_;
-    std::unordered_map<std::string, ThemeImage> trayImageTable_;
+    std::unordered_map<std::string, std::shared_ptr<ThemeImage>> imageTable_;
+    std::unordered_map<std::string, std::shared_ptr<ThemeImage>>
+        trayImageTable_;
     IconTheme iconTheme_;
     std::string name_;
+    std::recursive_mutex mutex_;
 };
 
 inline void cairoSetSourceColor(cairo_t *cr, const Color &color) {
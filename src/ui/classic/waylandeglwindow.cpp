@@ -27,9 +27,11 @@
 
 namespace fcitx {
 namespace classicui {
+
 WaylandEGLWindow::WaylandEGLWindow(WaylandUI *ui)
     : WaylandWindow(ui), window_(nullptr, &wl_egl_window_destroy),
-      cairoSurface_(nullptr, &cairo_surface_destroy) {}
+      cairoSurface_(nullptr, &cairo_surface_destroy),
+      lastFrame_(nullptr, &cairo_surface_destroy) {}
 
 WaylandEGLWindow::~WaylandEGLWindow() { destroyWindow(); }
 
@@ -51,12 +53,20 @@ cairo_surface_t *WaylandEGLWindow::prerender() {
     }
     if (window_ && !eglSurface_) {
         eglSurface_ = ui_->createEGLSurface(window_.get(), nullptr);
+        if (eglSurface_) {
+            preserved_ = ui_->preserveEGLSurface(eglSurface_);
+        }
     }
     if (eglSurface_ && !cairoSurface_) {
         cairoSurface_.reset(
             ui_->createEGLCairoSurface(eglSurface_, width_, height_));
+        lastFrame_.reset();
     }
-    if (!cairoSurface_) {
+    if (!cairoSurface_ ||
+        cairo_surface_status(cairoSurface_.get()) != CAIRO_STATUS_SUCCESS) {
+        // Something is wrong with the driver, let the window be replaced by a
+        // shm one.
+        ui_->disableEGL();
         return nullptr;
     }
     int width, height;
@@ -82,8 +92,54 @@ void WaylandEGLWindow::render() {
     callback_->done().connect([this](uint32_t) { callback_.reset(); });
 }
 
+bool WaylandEGLWindow::present(cairo_surface_t *image, cairo_surface_t *base,
+                               const Rect &frameDamage) {
+    auto surface = prerender();
+    if (!surface) {
+        return false;
+    }
+
+    const int width = cairo_image_surface_get_width(image);
+    const int height = cairo_image_surface_get_height(image);
+    Rect damage(0, 0, width - 1, height - 1);
+    // Damage is computed by render worker, and only valid if back buffer
+    // still has the frame it is relative to.
+    if (preserved_ && lastFrame_ &&
+        cairo_image_surface_get_width(lastFrame_.get()) == width &&
+        cairo_image_surface_get_height(lastFrame_.get()) == height) {
+        if (image == lastFrame_.get()) {
+            // Nothing changed, e.g. the hovered candidate stays the same.
+            return true;
+        }
+        if (base == lastFrame_.get()) {
+            damage = frameDamage;
+        }
+    }
+
+    // Only the damaged part of the image is uploaded as texture.
+    auto cr = cairo_create(surface);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_rectangle(cr, damage.left(), damage.top(), damage.width(),
+                    damage.height());
+    cairo_clip(cr);
+    cairo_set_source_surface(cr, image, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+    lastFrame_.reset(cairo_surface_reference(image));
+
+    if (!ui_->swapEGLBuffers(eglSurface_, damage, height)) {
+        lastFrame_.reset();
+        cairo_gl_surface_swapbuffers(surface);
+    }
+    callback_.reset(surface_->frame());
+    callback_->done().connect([this](uint32_t) { callback_.reset(); });
+    return true;
+}
+
 void WaylandEGLWindow::hide() {
     cairoSurface_.reset();
+    lastFrame_.reset();
     if (eglSurface_) {
         ui_->destroyEGLSurface(eglSurface_);
         eglSurface_ = nullptr;
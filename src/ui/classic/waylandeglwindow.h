@@ -42,12 +42,22 @@ public:
     cairo_surface_t *prerender() override;
     void render() override;
     void hide() override;
+    bool isEGL() const override { return true; }
+    bool present(cairo_surface_t *image, cairo_surface_t *base,
+                 const Rect &damage) override;
 
 private:
     std::unique_ptr<wl_egl_window, decltype(&wl_egl_window_destroy)> window_;
     EGLSurface eglSurface_ = nullptr;
+    // Whether the back buffer keeps its content after swap, which is required
+    // to only upload the damaged part of a frame.
+    bool preserved_ = false;
     std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)>
         cairoSurface_;
+    // Last image uploaded, damage of next frame can only be used if it is
+    // relative to this one.
+    std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)>
+        lastFrame_;
     std::unique_ptr<wayland::WlCallback> callback_;
 };
 } // namespace classicui
@@ -23,8 +23,14 @@
 #include <linux/input-event-codes.h>
 
 fcitx::classicui::WaylandInputWindow::WaylandInputWindow(WaylandUI *ui)
-    : fcitx::classicui::InputWindow(ui->parent()), ui_(ui),
-      window_(ui->newWindow()) {
+    : fcitx::classicui::InputWindow(ui->parent()), ui_(ui) {
+    resetWindow();
+}
+
+void fcitx::classicui::WaylandInputWindow::resetWindow() {
+    // Panel surface is bound to the old wl_surface.
+    resetPanel();
+    window_ = ui_->newWindow();
     window_->createWindow();
     window_->repaint().connect([this]() {
         if (auto ic = repaintIC_.get()) {
@@ -72,6 +78,11 @@ void fcitx::classicui::WaylandInputWindow::update(fcitx::InputContext *ic) {
         window_->hide();
         return;
     }
+    // Config changed, or EGL doesn't work.
+    if (window_->isEGL() != ui_->useEGL()) {
+        window_->hide();
+        resetWindow();
+    }
     auto pair = sizeHint();
     int width = pair.first, height = pair.second;
 
@@ -79,22 +90,31 @@ void fcitx::classicui::WaylandInputWindow::update(fcitx::InputContext *ic) {
         window_->resize(width, height);
     }
 
-    if (auto surface = window_->prerender()) {
-        cairo_t *c = cairo_create(surface);
-        paint(c, width, height);
-        cairo_destroy(c);
-        window_->render();
-    } else {
-        repaintIC_ = ic->watch();
-    }
+    paintAsync(width, height,
+               [this, ref = ic->watch()](cairo_surface_t *image,
+                                         cairo_surface_t *base,
+                                         const Rect &damage) {
+                   if (!visible() || window_->present(image, base, damage)) {
+                       return;
+                   }
+                   // Paint again once a buffer is released.
+                   repaintIC_ = ref;
+                   // Or right now, if EGL just failed and shm can be used.
+                   if (window_->isEGL() != ui_->useEGL()) {
+                       if (auto ic = ref.get()) {
+                           update(ic);
+                       }
+                   }
+               });
 }
 
 void fcitx::classicui::WaylandInputWindow::repaint() {
-
-    if (auto surface = window_->prerender()) {
-        cairo_t *c = cairo_create(surface);
-        paint(c, window_->width(), window_->height());
-        cairo_destroy(c);
-        window_->render();
-    }
+    paintAsync(window_->width(), window_->height(),
+               [this](cairo_surface_t *image, cairo_surface_t *base,
+                      const Rect &damage) {
+                   if (!visible()) {
+                       return;
+                   }
+                   window_->present(image, base, damage);
+               });
 }
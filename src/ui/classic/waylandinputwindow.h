@@ -38,6 +38,8 @@ public:
     void repaint();
 
 private:
+    void resetWindow();
+
     WaylandUI *ui_;
     std::unique_ptr<wayland::ZwpInputPanelSurfaceV1> panelSurface_;
     std::unique_ptr<WaylandWindow> window_;
@@ -181,6 +181,22 @@ bool WaylandUI::initEGL() {
         return false;
     }
 
+    EGLint surfaceType = 0;
+    if (eglGetConfigAttrib(eglDisplay_, argbConfig_, EGL_SURFACE_TYPE,
+                           &surfaceType)) {
+        canPreserve_ = (surfaceType & EGL_SWAP_BEHAVIOR_PRESERVED_BIT);
+    }
+    if (checkEGLExtension(eglDisplay_, "EGL_KHR_swap_buffers_with_damage")) {
+        swapBuffersWithDamage_ =
+            (PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC)eglGetProcAddress(
+                "eglSwapBuffersWithDamageKHR");
+    } else if (checkEGLExtension(eglDisplay_,
+                                 "EGL_EXT_swap_buffers_with_damage")) {
+        swapBuffersWithDamage_ =
+            (PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC)eglGetProcAddress(
+                "eglSwapBuffersWithDamageEXT");
+    }
+
     return true;
 }
 
@@ -221,7 +237,47 @@ cairo_surface_t *WaylandUI::createEGLCairoSurface(EGLSurface surface, int width,
                                                   int height) {
     return cairo_gl_surface_create_for_egl(argbDevice_, surface, width, height);
 }
+
+bool WaylandUI::preserveEGLSurface(EGLSurface surface) {
+    if (!canPreserve_) {
+        return false;
+    }
+    return eglSurfaceAttrib(eglDisplay_, surface, EGL_SWAP_BEHAVIOR,
+                            EGL_BUFFER_PRESERVED) == EGL_TRUE;
+}
+
+bool WaylandUI::swapEGLBuffers(EGLSurface surface, const Rect &damage,
+                               int height) {
+    if (!swapBuffersWithDamage_) {
+        return false;
+    }
+    // cairo may have released the context after drawing.
+    if (!eglMakeCurrent(eglDisplay_, surface, surface, argbCtx_)) {
+        return false;
+    }
+    // EGL rectangles have their origin at the bottom left corner.
+    EGLint rect[] = {damage.left(), height - damage.bottom() - 1,
+                     damage.width(), damage.height()};
+    return swapBuffersWithDamage_(eglDisplay_, surface, rect, 1) == EGL_TRUE;
+}
+#endif
+
+bool WaylandUI::useEGL() const {
+#ifdef CAIRO_EGL_FOUND
+    return hasEgl_ && *parent_->config().useEGL;
+#else
+    return false;
+#endif
+}
+
+void WaylandUI::disableEGL() {
+#ifdef CAIRO_EGL_FOUND
+    if (hasEgl_) {
+        CLASSICUI_DEBUG() << "EGL failed, fallback to shm.";
+        hasEgl_ = false;
+    }
 #endif
+}
 
 void WaylandUI::update(UserInterfaceComponent component,
                        InputContext *inputContext) {
@@ -241,7 +297,7 @@ void WaylandUI::resume() {
 
 std::unique_ptr<WaylandWindow> WaylandUI::newWindow() {
 #ifdef CAIRO_EGL_FOUND
-    if (hasEgl_) {
+    if (useEGL()) {
         return std::make_unique<WaylandEGLWindow>(this);
     } else
 #endif
@@ -22,6 +22,7 @@
 #include "classicui.h"
 #include "config.h"
 #include "display.h"
+#include "fcitx-utils/rect.h"
 #include "waylandpointer.h"
 #include "wl_pointer.h"
 #include <cairo/cairo.h>
@@ -29,6 +30,7 @@
 #ifdef CAIRO_EGL_FOUND
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <wayland-egl.h>
 
 #endif
@@ -55,7 +57,15 @@ public:
 
     cairo_surface_t *createEGLCairoSurface(EGLSurface surface, int width,
                                            int height);
+    // Ask for the back buffer to be preserved across swaps.
+    bool preserveEGLSurface(EGLSurface surface);
+    // Swap buffers, only damaging the given region if supported.
+    bool swapEGLBuffers(EGLSurface surface, const Rect &damage, int height);
 #endif
+    // Whether new windows should be backed by EGL.
+    bool useEGL() const;
+    // EGL doesn't work at runtime, use shm for all windows from now on.
+    void disableEGL();
 
     ClassicUI *parent() const { return parent_; }
     const std::string &name() const { return name_; }
@@ -84,6 +94,8 @@ private:
     EGLConfig argbConfig_ = nullptr;
     EGLContext argbCtx_ = nullptr;
     cairo_device_t *argbDevice_ = nullptr;
+    bool canPreserve_ = false;
+    PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC swapBuffersWithDamage_ = nullptr;
 #endif
 };
 } // namespace classicui
@@ -49,6 +49,21 @@ void WaylandWindow::createWindow() {
 
 void WaylandWindow::destroyWindow() { surface_.reset(); }
 
+bool WaylandWindow::present(cairo_surface_t *image, cairo_surface_t *,
+                            const Rect &) {
+    auto surface = prerender();
+    if (!surface) {
+        return false;
+    }
+    auto cr = cairo_create(surface);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, image, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    render();
+    return true;
+}
+
 void bufferToSurfaceSize(enum wl_output_transform buffer_transform,
                          int32_t buffer_scale, int32_t *width,
                          int32_t *height) {
@@ -36,6 +36,13 @@ public:
     virtual void createWindow();
     virtual void destroyWindow();
     virtual void hide() = 0;
+    virtual bool isEGL() const { return false; }
+    // Put a fully painted image on screen. damage is the part of image that
+    // differs from base, the previously painted image. base is null if the
+    // whole image is new. Return false if there is no buffer available right
+    // now.
+    virtual bool present(cairo_surface_t *image, cairo_surface_t *base,
+                         const Rect &damage);
 
     void setScale(int32_t scale) { scale_ = scale; }
     void setTransform(wl_output_transform transform) { transform_ = transform; }
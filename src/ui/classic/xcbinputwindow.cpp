@@ -188,15 +188,12 @@ void XCBInputWindow::update(InputContext *inputContext) {
         resize(width, height);
     }
 
-    cairo_t *c = cairo_create(prerender());
     updatePosition(inputContext);
     if (!oldVisible) {
         xcb_map_window(ui_->connection(), wid_);
         xcb_flush(ui_->connection());
     }
-    paint(c, width, height);
-    cairo_destroy(c);
-    render();
+    repaint();
 }
 
 bool XCBInputWindow::filterEvent(xcb_generic_event_t *event) {
@@ -253,12 +250,16 @@ void XCBInputWindow::repaint() {
     if (!visible()) {
         return;
     }
-    if (auto surface = prerender()) {
-        cairo_t *c = cairo_create(surface);
-        paint(c, width(), height());
-        cairo_destroy(c);
-        render();
-    }
+    paintAsync(width(), height(), [this](cairo_surface_t *image,
+                                         cairo_surface_t *, const Rect &) {
+        if (!visible()) {
+            return;
+        }
+        if (auto surface = prerender()) {
+            copySurface(surface, image);
+            render();
+        }
+    });
 }
 
 } // namespace classicui
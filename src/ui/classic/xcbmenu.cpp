@@ -342,9 +342,9 @@ void XCBMenu::update() {
 
     const auto &textMargin = *theme.menu->textMargin;
     int i = 0;
-    auto &separator = theme.loadBackground(*theme.menu->separator);
-    auto &checkBox = theme.loadBackground(*theme.menu->checkBox);
-    auto &subMenu = theme.loadBackground(*theme.menu->subMenu);
+    auto separator = theme.loadBackground(*theme.menu->separator);
+    auto checkBox = theme.loadBackground(*theme.menu->checkBox);
+    auto subMenu = theme.loadBackground(*theme.menu->subMenu);
     const auto &highlightMargin = *theme.menu->highlight->margin;
     size_t maxItemWidth = 0;
     size_t maxItemHeight = 0;
@@ -376,14 +376,14 @@ void XCBMenu::update() {
         size_t itemWidth = 0;
         size_t itemHeight = 0;
         if (hasCheckable) {
-            itemWidth += checkBox.width();
-            updateIfLarger(itemHeight, checkBox.height());
+            itemWidth += checkBox->width();
+            updateIfLarger(itemHeight, checkBox->height());
         }
         item.isChecked_ = action->isChecked(ic);
         itemWidth += item.textWidth_;
         updateIfLarger(itemHeight, item.textHeight_);
-        itemWidth += subMenu.width();
-        updateIfLarger(itemHeight, subMenu.height());
+        itemWidth += subMenu->width();
+        updateIfLarger(itemHeight, subMenu->height());
 
         updateIfLarger(maxItemWidth, itemWidth);
         updateIfLarger(maxItemHeight, itemHeight);
@@ -396,7 +396,7 @@ void XCBMenu::update() {
         if (item.isSeparator_) {
             item.layoutX_ = width;
             item.layoutY_ = height;
-            height += separator.height();
+            height += separator->height();
             prevIsSeparator = true;
             continue;
         }
@@ -414,15 +414,15 @@ void XCBMenu::update() {
                      maxItemHeight + *highlightMargin.marginTop +
                          *highlightMargin.marginTop);
         item.layoutX_ = width + *textMargin.marginLeft +
-                        (hasCheckable ? checkBox.width() : 0);
+                        (hasCheckable ? checkBox->width() : 0);
         item.layoutY_ = height + *textMargin.marginTop +
                         (maxItemHeight - item.textHeight_) / 2.0;
         item.checkBoxX_ = width + *textMargin.marginLeft;
         item.checkBoxY_ = height + *textMargin.marginTop +
-                          (maxItemHeight - checkBox.height()) / 2.0;
-        item.subMenuX_ = width + maxItemWidth - subMenu.width();
+                          (maxItemHeight - checkBox->height()) / 2.0;
+        item.subMenuX_ = width + maxItemWidth - subMenu->width();
         item.subMenuY_ = height + *textMargin.marginTop +
-                         (maxItemHeight - subMenu.height()) / 2.0;
+                         (maxItemHeight - subMenu->height()) / 2.0;
         ;
 
         height +=
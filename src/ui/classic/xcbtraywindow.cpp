@@ -305,24 +305,25 @@ void XCBTrayWindow::paint(cairo_t *c) {
         label = entry->label();
     }
 
-    auto &image = theme.loadImage(icon, label, std::min(height(), width()),
-                                  ImagePurpose::Tray);
+    auto image = theme.loadImage(icon, label, std::min(height(), width()),
+                                 ImagePurpose::Tray);
     cairo_save(c);
     cairo_set_operator(c, CAIRO_OPERATOR_SOURCE);
     double scaleW = 1.0, scaleH = 1.0;
-    if (image.width() != width() || image.height() != height()) {
-        scaleW = static_cast<double>(width()) / image.width();
-        scaleH = static_cast<double>(height()) / image.height();
+    if (image->width() != width() || image->height() != height()) {
+        scaleW = static_cast<double>(width()) / image->width();
+        scaleH = static_cast<double>(height()) / image->height();
         if (scaleW > scaleH)
             scaleH = scaleW;
         else
             scaleW = scaleH;
     }
-    int aw = scaleW * image.width();
-    int ah = scaleH * image.height();
+    int aw = scaleW * image->width();
+    int ah = scaleH * image->height();
 
     cairo_scale(c, scaleW, scaleH);
-    cairo_set_source_surface(c, image, (width() - aw) / 2, (height() - ah) / 2);
+    cairo_set_source_surface(c, *image, (width() - aw) / 2,
+                             (height() - ah) / 2);
     cairo_paint(c);
     cairo_restore(c);
 }
@@ -150,6 +150,7 @@ std::string Kimpanel::actionToStatus(Action *action, InputContext *ic) {
 }
 
 void Kimpanel::resume() {
+    lookupTableSent_ = false;
     proxy_ = std::make_unique<KimpanelProxy>(this, bus_);
     bus_->addObjectVTable("/kimpanel", "org.kde.kimpanel.inputmethod", *proxy_);
     bus_->requestName(
@@ -242,25 +243,28 @@ void Kimpanel::updateInputPanel(InputContext *inputContext) {
         proxy_->showPreedit(false);
     }
 
+    updateLookupTable(inputContext);
+    bus_->flush();
+}
+
+void Kimpanel::updateLookupTable(InputContext *inputContext) {
+    auto instance = this->instance();
+    auto &inputPanel = inputContext->inputPanel();
     auto auxDown = instance->outputFilter(inputContext, inputPanel.auxDown());
     auto auxDownString = auxDown.toString();
     auto candidateList = inputPanel.candidateList();
 
-    auto msg = bus_->createMethodCall("org.kde.impanel", "/org/kde/impanel",
-                                      "org.kde.impanel2", "SetLookupTable");
-    auto visible =
+    bool hasAuxDown = !auxDownString.empty();
+    auto &table = lookupTable_;
+    table.clear();
+    table.visible_ =
         auxDownString.size() || (candidateList && candidateList->size());
-    if (visible) {
-        std::vector<std::string> labels;
-        std::vector<std::string> texts;
-        std::vector<std::string> attrs;
-        bool hasPrev = false, hasNext = false;
-        int pos = -1;
-        int layout = static_cast<int>(CandidateLayoutHint::NotSet);
-        if (auxDownString.size()) {
-            labels.emplace_back("");
-            texts.push_back(auxDownString);
-            attrs.emplace_back("");
+    if (table.visible_) {
+        table.layout_ = static_cast<int>(CandidateLayoutHint::NotSet);
+        if (hasAuxDown) {
+            table.labels_.emplace_back("");
+            table.texts_.push_back(std::move(auxDownString));
+            table.attrs_.emplace_back("");
         }
         if (candidateList) {
             for (int i = 0, e = candidateList->size(); i < e; i++) {
@@ -273,35 +277,43 @@ void Kimpanel::updateInputPanel(InputContext *inputContext) {
                                      : candidateList->label(i);
 
                 labelText = instance->outputFilter(inputContext, labelText);
-                labels.push_back(labelText.toString());
+                table.labels_.push_back(labelText.toString());
                 auto candidateText =
                     instance->outputFilter(inputContext, candidate.text());
-                texts.push_back(candidateText.toString());
-                attrs.emplace_back("");
+                table.texts_.push_back(candidateText.toString());
+                table.attrs_.emplace_back("");
             }
             if (auto pageable = candidateList->toPageable()) {
-                hasPrev = pageable->hasPrev();
-                hasNext = pageable->hasNext();
+                table.hasPrev_ = pageable->hasPrev();
+                table.hasNext_ = pageable->hasNext();
             }
-            pos = candidateList->cursorIndex();
-            if (pos >= 0) {
-                pos += (auxDownString.empty() ? 0 : 1);
+            table.pos_ = candidateList->cursorIndex();
+            if (table.pos_ >= 0) {
+                table.pos_ += (hasAuxDown ? 1 : 0);
             }
-            layout = static_cast<int>(candidateList->layoutHint());
+            table.layout_ = static_cast<int>(candidateList->layoutHint());
         }
+    }
 
-        msg << labels << texts << attrs;
-        msg << hasPrev << hasNext << pos << layout;
-    } else {
-        std::vector<std::string> labels;
-        std::vector<std::string> texts;
-        std::vector<std::string> attrs;
-        msg << labels << texts << attrs;
-        msg << false << false << -1 << 0;
+    if (lookupTableSent_ && table.sameContent(lastLookupTable_)) {
+        // Only moving the cursor is very common, e.g. with arrow keys.
+        if (table.pos_ != lastLookupTable_.pos_) {
+            proxy_->updateLookupTableCursor(table.pos_);
+            lastLookupTable_.pos_ = table.pos_;
+        }
+        return;
     }
+
+    auto msg = bus_->createMethodCall("org.kde.impanel", "/org/kde/impanel",
+                                      "org.kde.impanel2", "SetLookupTable");
+    msg << table.labels_ << table.texts_ << table.attrs_;
+    msg << table.hasPrev_ << table.hasNext_ << table.pos_ << table.layout_;
     msg.send();
-    proxy_->showLookupTable(visible);
-    bus_->flush();
+    if (!lookupTableSent_ || table.visible_ != lastLookupTable_.visible_) {
+        proxy_->showLookupTable(table.visible_);
+    }
+    std::swap(lookupTable_, lastLookupTable_);
+    lookupTableSent_ = true;
 }
 
 std::string Kimpanel::inputMethodStatus(InputContext *ic) {
@@ -441,6 +453,8 @@ void Kimpanel::msgV1Handler(dbus::Message &msg) {
         if (!available_) {
             setAvailable(true);
         }
+        // New panel knows nothing about the lookup table.
+        lookupTableSent_ = false;
         registerAllProperties();
     }
 }
@@ -450,6 +464,7 @@ void Kimpanel::msgV2Handler(dbus::Message &msg) {
         if (!available_) {
             setAvailable(true);
         }
+        lookupTableSent_ = false;
         registerAllProperties();
     }
 }
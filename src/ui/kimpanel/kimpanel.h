@@ -56,7 +56,36 @@ public:
     std::string actionToStatus(Action *action, InputContext *ic);
 
 private:
+    // What the panel currently shows as lookup table.
+    struct LookupTableState {
+        bool sameContent(const LookupTableState &other) const {
+            return visible_ == other.visible_ && labels_ == other.labels_ &&
+                   texts_ == other.texts_ && attrs_ == other.attrs_ &&
+                   hasPrev_ == other.hasPrev_ && hasNext_ == other.hasNext_ &&
+                   layout_ == other.layout_;
+        }
+        void clear() {
+            visible_ = false;
+            labels_.clear();
+            texts_.clear();
+            attrs_.clear();
+            hasPrev_ = hasNext_ = false;
+            pos_ = -1;
+            layout_ = 0;
+        }
+
+        bool visible_ = false;
+        std::vector<std::string> labels_;
+        std::vector<std::string> texts_;
+        std::vector<std::string> attrs_;
+        bool hasPrev_ = false;
+        bool hasNext_ = false;
+        int pos_ = -1;
+        int layout_ = 0;
+    };
+
     void setAvailable(bool available);
+    void updateLookupTable(InputContext *inputContext);
     Instance *instance_;
     dbus::Bus *bus_;
     dbus::ServiceWatcher watcher_;
@@ -66,6 +95,11 @@ private:
         eventHandlers_;
     TrackableObjectReference<InputContext> lastInputContext_;
     std::unique_ptr<EventSourceTime> timeEvent_;
+    // Buffers are swapped between the two, so they are reused on every
+    // update.
+    LookupTableState lookupTable_;
+    LookupTableState lastLookupTable_;
+    bool lookupTableSent_ = false;
     bool available_ = false;
 };
 } // namespace fcitx
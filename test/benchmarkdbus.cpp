@@ -0,0 +1,239 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "fcitx-utils/dbus/bus.h"
+#include "fcitx-utils/dbus/variant.h"
+#include "fcitx-utils/event.h"
+#include "fcitx-utils/log.h"
+#include "fcitx-utils/stringutils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+using namespace fcitx::dbus;
+using namespace fcitx;
+
+#ifndef FCITX_DBUS_BACKEND
+#define FCITX_DBUS_BACKEND "unknown"
+#endif
+
+#define BENCHMARK_SERVICE "org.fcitx.Fcitx.BenchmarkDBus"
+#define BENCHMARK_INTERFACE "org.fcitx.Fcitx.BenchmarkDBus.Interface"
+
+namespace {
+
+// Same layout as the text sent by the IBus frontend.
+using IBusText = FCITX_STRING_TO_DBUS_TYPE("(sa{sv}sv)");
+using IBusAttrList = FCITX_STRING_TO_DBUS_TYPE("(sa{sv}av)");
+using IBusAttribute = FCITX_STRING_TO_DBUS_TYPE("(sa{sv}uuuu)");
+
+void registerTypes() {
+    VariantTypeRegistry::defaultRegistry().registerType<IBusText>();
+    VariantTypeRegistry::defaultRegistry().registerType<IBusAttribute>();
+    VariantTypeRegistry::defaultRegistry().registerType<IBusAttrList>();
+}
+
+IBusText makeText(const std::string &str, size_t attrs) {
+    IBusAttrList attrList;
+    std::get<0>(attrList) = "IBusAttrList";
+    for (size_t i = 0; i < attrs; i++) {
+        IBusAttribute attr;
+        std::get<0>(attr) = "IBusAttribute";
+        std::get<2>(attr) = 1;
+        std::get<3>(attr) = 1;
+        std::get<4>(attr) = i;
+        std::get<5>(attr) = i + 1;
+        std::get<2>(attrList).emplace_back(std::move(attr));
+    }
+    IBusText text;
+    std::get<0>(text) = "IBusText";
+    std::get<2>(text) = str;
+    std::get<3>(text).setData(std::move(attrList));
+    return text;
+}
+
+class BenchmarkObject : public ObjectVTable<BenchmarkObject> {
+public:
+    BenchmarkObject(EventLoop *loop) : loop_(loop) {}
+
+private:
+    void ping() {}
+    bool processKeyEvent(uint32_t keyval, uint32_t keycode, uint32_t state) {
+        return (keyval + keycode + state) % 2;
+    }
+    Variant echoText(const Variant &text) { return text; }
+    void emitSignals(uint32_t count, const std::string &arg0) {
+        for (uint32_t i = 0; i < count; i++) {
+            tick(arg0, i);
+        }
+    }
+    void quit() { loop_->quit(); }
+
+    EventLoop *loop_;
+    FCITX_OBJECT_VTABLE_METHOD(ping, "Ping", "", "");
+    FCITX_OBJECT_VTABLE_METHOD(processKeyEvent, "ProcessKeyEvent", "uuu", "b");
+    FCITX_OBJECT_VTABLE_METHOD(echoText, "EchoText", "v", "v");
+    FCITX_OBJECT_VTABLE_METHOD(emitSignals, "EmitSignals", "us", "");
+    FCITX_OBJECT_VTABLE_METHOD(quit, "Quit", "", "");
+    FCITX_OBJECT_VTABLE_SIGNAL(tick, "Tick", "su");
+};
+
+class Timer {
+public:
+    Timer() : start_(std::chrono::steady_clock::now()) {}
+
+    void report(const char *name, size_t iterations) const {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start_)
+                           .count();
+        FCITX_INFO() << "[" FCITX_DBUS_BACKEND "] " << name << ": "
+                     << iterations << " iterations, "
+                     << elapsed / 1000 / iterations << " us/op";
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+Message call(Bus &bus, const char *method) {
+    return bus.createMethodCall(BENCHMARK_SERVICE, "/benchmark",
+                                BENCHMARK_INTERFACE, method);
+}
+
+void benchmarkPing(Bus &bus, size_t iterations) {
+    Timer timer;
+    for (size_t i = 0; i < iterations; i++) {
+        auto msg = call(bus, "Ping");
+        auto reply = msg.call(0);
+        FCITX_ASSERT(reply.type() == MessageType::Reply);
+    }
+    timer.report("method call round trip", iterations);
+}
+
+void benchmarkProcessKeyEvent(Bus &bus, size_t iterations) {
+    Timer timer;
+    for (size_t i = 0; i < iterations; i++) {
+        auto msg = call(bus, "ProcessKeyEvent");
+        msg << static_cast<uint32_t>(i) << 38u << 0u;
+        auto reply = msg.call(0);
+        bool result = false;
+        reply >> result;
+        FCITX_ASSERT(reply);
+        FCITX_ASSERT(result == (i + 38) % 2);
+    }
+    timer.report("object vtable dispatch (uuu -> b)", iterations);
+}
+
+void benchmarkVariant(Bus &bus, size_t iterations) {
+    Variant text(makeText("candidate text for benchmark", 8));
+    Timer timer;
+    for (size_t i = 0; i < iterations; i++) {
+        auto msg = call(bus, "EchoText");
+        msg << text;
+        auto reply = msg.call(0);
+        Variant result;
+        reply >> result;
+        FCITX_ASSERT(reply);
+        FCITX_ASSERT(result.signature() == "(sa{sv}sv)");
+    }
+    timer.report("IBusText variant round trip", iterations);
+}
+
+void benchmarkSignal(Bus &bus, size_t iterations, size_t rules) {
+    EventLoop loop;
+    bus.attachEventLoop(&loop);
+    size_t received = 0;
+    bool replied = false;
+    auto checkDone = [&]() {
+        if (replied && received == iterations) {
+            loop.quit();
+        }
+    };
+    // One rule per argument, like service watchers. Only the last one
+    // matches.
+    std::vector<std::unique_ptr<Slot>> slots;
+    for (size_t i = 0; i < rules; i++) {
+        slots.emplace_back(bus.addMatch(
+            MatchRule(BENCHMARK_SERVICE, "/benchmark", BENCHMARK_INTERFACE,
+                      "Tick", {std::to_string(i)}),
+            [&](Message &) {
+                ++received;
+                checkDone();
+                return false;
+            }));
+        FCITX_ASSERT(slots.back());
+    }
+
+    Timer timer;
+    auto msg = call(bus, "EmitSignals");
+    msg << static_cast<uint32_t>(iterations) << std::to_string(rules - 1);
+    auto slot = msg.callAsync(0, [&](Message &reply) {
+        FCITX_ASSERT(reply.type() == MessageType::Reply);
+        replied = true;
+        checkDone();
+        return true;
+    });
+    loop.exec();
+    timer.report(
+        stringutils::concat("signal dispatch with ", rules, " match rules")
+            .data(),
+        iterations);
+    FCITX_ASSERT(received == iterations);
+    bus.detachEventLoop();
+}
+
+void client(size_t iterations) {
+    Bus bus(BusType::Session);
+    benchmarkPing(bus, iterations);
+    benchmarkProcessKeyEvent(bus, iterations);
+    benchmarkVariant(bus, iterations);
+    benchmarkSignal(bus, iterations, 1);
+    benchmarkSignal(bus, iterations, 256);
+    call(bus, "Quit").call(0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t iterations = 1000;
+    if (argc > 1) {
+        iterations = std::max(1, atoi(argv[1]));
+    }
+    registerTypes();
+
+    Bus bus(BusType::Session);
+    if (!bus.isOpen()) {
+        return 1;
+    }
+    EventLoop loop;
+    bus.attachEventLoop(&loop);
+    if (!bus.requestName(BENCHMARK_SERVICE,
+                         {RequestNameFlag::AllowReplacement,
+                          RequestNameFlag::ReplaceExisting})) {
+        return 1;
+    }
+    BenchmarkObject obj(&loop);
+    FCITX_ASSERT(bus.addObjectVTable("/benchmark", BENCHMARK_INTERFACE, obj));
+
+    std::thread thread(client, iterations);
+    loop.exec();
+    thread.join();
+    return 0;
+}
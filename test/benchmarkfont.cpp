@@ -0,0 +1,101 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "fcitx-utils/log.h"
+#include "fontwarmup.h"
+#include <algorithm>
+#include <cairo.h>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <pango/pangocairo.h>
+
+using namespace fcitx;
+
+namespace {
+
+constexpr char font[] = "Sans 10";
+
+// Candidate like text, with CJK so fallback fonts are involved.
+constexpr char candidate[] = "1. \xe4\xb8\xad\xe6\x96\x87 2. \xe6\xb5\x8b"
+                             "\xe8\xaf\x95 3. candidate";
+
+int64_t elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// Time of the first paint on a new font map, which is what the first paint
+// of an input window pays. Time of warm up itself is added to warmUpTime.
+int64_t firstPaint(bool warmUp, int64_t &warmUpTime) {
+    std::unique_ptr<PangoFontMap, decltype(&g_object_unref)> fontMap(
+        pango_cairo_font_map_new(), &g_object_unref);
+    if (warmUp) {
+        auto start = std::chrono::steady_clock::now();
+        classicui::warmUpFontMap(fontMap.get(), font);
+        warmUpTime += elapsed(start);
+    }
+    std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> surface(
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 400, 100),
+        &cairo_surface_destroy);
+    std::unique_ptr<cairo_t, decltype(&cairo_destroy)> cr(
+        cairo_create(surface.get()), &cairo_destroy);
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<PangoContext, decltype(&g_object_unref)> context(
+        pango_font_map_create_context(fontMap.get()), &g_object_unref);
+    pango_cairo_update_context(cr.get(), context.get());
+    auto fontDesc = pango_font_description_from_string(font);
+    pango_context_set_font_description(context.get(), fontDesc);
+    pango_font_description_free(fontDesc);
+    std::unique_ptr<PangoLayout, decltype(&g_object_unref)> layout(
+        pango_layout_new(context.get()), &g_object_unref);
+    pango_layout_set_text(layout.get(), candidate, -1);
+    pango_cairo_show_layout(cr.get(), layout.get());
+    cairo_surface_flush(surface.get());
+    return elapsed(start);
+}
+
+void report(const char *name, bool warmUp, size_t iterations) {
+    int64_t total = 0;
+    int64_t warmUpTime = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        total += firstPaint(warmUp, warmUpTime);
+    }
+    auto count = static_cast<int64_t>(iterations);
+    FCITX_INFO() << name << ": " << iterations << " iterations, "
+                 << total / count << " us/first paint, " << warmUpTime / count
+                 << " us/warm up";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t iterations = 10;
+    if (argc > 1) {
+        iterations = std::max(1, atoi(argv[1]));
+    }
+    // The very first one also pays for fontconfig initialization, which is
+    // process wide and not what warm up is about.
+    report("cold process", false, 1);
+    report("new font map", false, iterations);
+    report("new font map, warmed up", true, iterations);
+    return 0;
+}
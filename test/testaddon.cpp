@@ -18,31 +18,73 @@
 //
 
 #include "addon/dummyaddon_public.h"
+#include "fcitx-utils/fs.h"
 #include "fcitx-utils/log.h"
 #include "fcitx-utils/metastring.h"
+#include "fcitx/addonfactory.h"
 #include "fcitx/addoninstance.h"
 #include "fcitx/addonmanager.h"
 #include "testdir.h"
+#include <unistd.h>
+#include <vector>
 
 double f(int) { return 0; }
 
+std::vector<std::string> loadOrder;
+
+class OrderAddon : public fcitx::AddonInstance {};
+
+class OrderAddonFactory : public fcitx::AddonFactory {
+public:
+    OrderAddonFactory(std::string name) : name_(std::move(name)) {}
+    fcitx::AddonInstance *create(fcitx::AddonManager *) override {
+        loadOrder.push_back(name_);
+        return new OrderAddon;
+    }
+
+private:
+    std::string name_;
+};
+
 int main() {
     setenv("XDG_DATA_DIRS", FCITX5_SOURCE_DIR "/test/addon2", 1);
     setenv("FCITX_ADDON_DIRS", FCITX5_BINARY_DIR "/test/addon", 1);
-    fcitx::AddonManager manager;
-    manager.registerDefaultLoader(nullptr);
-    manager.load();
-    auto addon = manager.addon("dummyaddon");
-    FCITX_ASSERT(addon);
-    FCITX_ASSERT(6 ==
-                 addon->callWithSignature<int(int)>("DummyAddon::addOne", 5));
-    FCITX_ASSERT(6 ==
-                 addon->callWithSignature<int(int)>("DummyAddon::addOne", 5.3));
-    auto result =
-        7 ==
-        addon->callWithMetaString<fcitxMakeMetaString("DummyAddon::addOne")>(6);
-    FCITX_ASSERT(result);
-    auto result2 = 8 == addon->call<fcitx::IDummyAddon::addOne>(7);
-    FCITX_ASSERT(result2);
+    OrderAddonFactory order1("staticorder1"), order2("staticorder2"),
+        order3("staticorder3"), order4("staticorder4");
+    fcitx::StaticAddonRegistry registry = {{"staticorder1", &order1},
+                                           {"staticorder2", &order2},
+                                           {"staticorder3", &order3},
+                                           {"staticorder4", &order4}};
+    // Second round loads the addon information from the cache written by the
+    // first one.
+    setenv("XDG_CACHE_HOME", FCITX5_BINARY_DIR "/test/cache", 1);
+    unlink(FCITX5_BINARY_DIR "/test/cache/fcitx5/addon.cache");
+    for (int i = 0; i < 2; i++) {
+        loadOrder.clear();
+        fcitx::AddonManager manager;
+        manager.registerDefaultLoader(&registry);
+        manager.load();
+        // 3 is on demand but required by 2, 1 waits for its optional
+        // dependency 2, and 4 requires a missing addon.
+        FCITX_ASSERT(loadOrder ==
+                     std::vector<std::string>(
+                         {"staticorder3", "staticorder2", "staticorder1"}));
+        FCITX_ASSERT(!manager.addon("staticorder4", true));
+
+        auto addon = manager.addon("dummyaddon");
+        FCITX_ASSERT(addon);
+        FCITX_ASSERT(6 == addon->callWithSignature<int(int)>(
+                              "DummyAddon::addOne", 5));
+        FCITX_ASSERT(6 == addon->callWithSignature<int(int)>(
+                              "DummyAddon::addOne", 5.3));
+        auto result =
+            7 == addon->callWithMetaString<fcitxMakeMetaString(
+                     "DummyAddon::addOne")>(6);
+        FCITX_ASSERT(result);
+        auto result2 = 8 == addon->call<fcitx::IDummyAddon::addOne>(7);
+        FCITX_ASSERT(result2);
+        FCITX_ASSERT(fcitx::fs::isreg(FCITX5_BINARY_DIR
+                                      "/test/cache/fcitx5/addon.cache"));
+    }
     return 0;
 }
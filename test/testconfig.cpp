@@ -22,8 +22,105 @@
 #include <fcitx-config/configuration.h>
 #include <fcitx-config/enum.h>
 #include <fcitx-config/iniparser.h>
+#include <fcitx-utils/fs.h>
+#include <fcitx-utils/standardpath.h>
+#include <fcitx-utils/stringutils.h>
+#include <fcitx-utils/unixfd.h>
+#include <unistd.h>
 #include <vector>
 
+void testReload() {
+    char tmpl[] = "/tmp/fcitx_config_XXXXXX";
+    const char *tmp = mkdtemp(tmpl);
+    FCITX_ASSERT(tmp);
+    FCITX_ASSERT(setenv("XDG_CONFIG_HOME", tmp, 1) == 0);
+
+    TestConfig config;
+    config.intValue.setValue(3);
+    FCITX_ASSERT(fcitx::safeSaveAsIni(config, "conf/test.conf"));
+
+    TestConfig reloaded;
+    // Everything is reported the first time.
+    auto changed = fcitx::reloadAsIni(reloaded, "conf/test.conf");
+    FCITX_ASSERT(changed.size() > 1);
+    FCITX_ASSERT(reloaded.intValue.value() == 3);
+    // Unchanged file is not read again.
+    FCITX_ASSERT(fcitx::reloadAsIni(reloaded, "conf/test.conf").empty());
+
+    config.stringValue.setValue("Changed");
+    FCITX_ASSERT(fcitx::safeSaveAsIni(config, "conf/test.conf"));
+    changed = fcitx::reloadAsIni(reloaded, "conf/test.conf");
+    FCITX_ASSERT(changed == std::vector<std::string>{"StringOption"});
+    FCITX_ASSERT(reloaded.stringValue.value() == "Changed");
+
+    // Any other load makes the next reload report everything again.
+    fcitx::RawConfig raw;
+    reloaded.load(raw, true);
+    FCITX_ASSERT(fcitx::reloadAsIni(reloaded, "conf/test.conf").size() > 1);
+
+    auto file = fcitx::StandardPath::global().locate(
+        fcitx::StandardPath::Type::PkgConfig, "conf/test.conf");
+    FCITX_ASSERT(!file.empty());
+    unlink(file.c_str());
+    changed = fcitx::reloadAsIni(reloaded, "conf/test.conf");
+    FCITX_ASSERT(changed.size() == 2);
+    FCITX_ASSERT(reloaded.intValue.value() == 0);
+    rmdir(fcitx::stringutils::joinPath(tmp, "fcitx5/conf").c_str());
+    rmdir(fcitx::stringutils::joinPath(tmp, "fcitx5").c_str());
+    rmdir(tmp);
+}
+
+void testReadFromIni() {
+    char tmpl[] = "/tmp/fcitx_config_XXXXXX";
+    fcitx::UnixFD fd = fcitx::UnixFD::own(mkstemp(tmpl));
+    FCITX_ASSERT(fd.isValid());
+    unlink(tmpl);
+    std::string_view ini = "IntOption=20\n"
+                           "BoolOption=False\n"
+                           "StringOption=\"A B\"\n"
+                           "EnumOption=EnumB\n"
+                           "I18NString=ABCD\n"
+                           "I18NString[zh_CN]=A\n"
+                           "[EnumVectorOption]\n"
+                           "0=EnumC\n"
+                           "[SubConfigOption]\n"
+                           "IntOption=5\n"
+                           "[SubConfigOption/SubSubConfig/0]\n"
+                           "IntOption=7\n";
+    FCITX_ASSERT(fcitx::fs::safeWrite(fd.fd(), ini.data(), ini.size()) ==
+                 static_cast<ssize_t>(ini.size()));
+
+    TestConfig expect, config;
+    expect.stringVectorValue.setValue(std::vector<std::string>{"A"});
+    config.stringVectorValue.setValue(std::vector<std::string>{"A"});
+    fcitx::RawConfig raw;
+    lseek(fd.fd(), 0, SEEK_SET);
+    fcitx::readFromIni(raw, fd.fd());
+    expect.load(raw);
+    lseek(fd.fd(), 0, SEEK_SET);
+    fcitx::readFromIni(config, fd.fd());
+
+    // Same result as going through RawConfig.
+    FCITX_ASSERT(config == expect);
+    FCITX_ASSERT(config.intValue.value() == 0);
+    FCITX_ASSERT(!config.boolValue.value());
+    FCITX_ASSERT(config.stringValue.value() == "A B");
+    FCITX_ASSERT(config.enumValue.value() == TestEnum::EnumB);
+    FCITX_ASSERT(config.enumVectorValue.value() ==
+                 std::vector<my::TestEnum>{my::TestEnum::EnumC});
+    FCITX_ASSERT(config.stringVectorValue.value() ==
+                 std::vector<std::string>({"ABC", "CDE"}));
+    FCITX_ASSERT(config.i18nStringValue.value().match("zh_CN") == "A");
+    FCITX_ASSERT(config.subConfigValue->intValue.value() == 5);
+    const auto &subSubConfigs = *config.subConfigValue->subSubVectorConfigValue;
+    FCITX_ASSERT(subSubConfigs[0].intValue.value() == 7);
+    FCITX_ASSERT(config.colorValue.isValueOption());
+    FCITX_ASSERT(config.enumValue.isValueOption());
+    FCITX_ASSERT(!config.enumVectorValue.isValueOption());
+    FCITX_ASSERT(!config.i18nStringValue.isValueOption());
+    FCITX_ASSERT(!config.subConfigValue.isValueOption());
+}
+
 int main() {
     TestConfig config;
 
@@ -75,5 +172,30 @@ int main() {
     FCITX_ASSERT(!rawConfig.get("IntOption"));
     FCITX_ASSERT(!intOption->parent());
 
+    // Sub items keep the insertion order regardless of lookup.
+    {
+        fcitx::RawConfig orderConfig;
+        orderConfig.setValueByPath("c", "1");
+        orderConfig.setValueByPath("a/b", "2");
+        orderConfig.setValueByPath("b", "3");
+        FCITX_ASSERT(orderConfig.subItems() ==
+                     std::vector<std::string>({"c", "a", "b"}));
+        FCITX_ASSERT(*orderConfig.valueByPath("a/b") == "2");
+        FCITX_ASSERT(orderConfig.remove("c"));
+        FCITX_ASSERT(!orderConfig.remove("c"));
+        FCITX_ASSERT(!orderConfig.remove("x/y"));
+        orderConfig.setValueByPath("c", "4");
+        FCITX_ASSERT(orderConfig.subItems() ==
+                     std::vector<std::string>({"a", "b", "c"}));
+        FCITX_ASSERT(*orderConfig.valueByPath("b") == "3");
+        FCITX_ASSERT(*orderConfig.valueByPath("c") == "4");
+        fcitx::RawConfig copy(orderConfig);
+        FCITX_ASSERT(copy == orderConfig);
+        FCITX_ASSERT(copy.subItems() == orderConfig.subItems());
+    }
+
+    testReload();
+    testReadFromIni();
+
     return 0;
 }
@@ -54,6 +54,18 @@ class TestObject : public ObjectVTable<TestObject> {
         }
         return Variant();
     }
+    int32_t testDelay(int32_t i) {
+        delayed_ = std::make_unique<Message>(delayReply());
+        delayedValue_ = i;
+        return 0;
+    }
+    void testFinish() {
+        FCITX_ASSERT(delayed_);
+        auto reply = delayed_->createReply();
+        reply << delayedValue_ * 2;
+        reply.send();
+        delayed_.reset();
+    }
     std::string
     test5(const std::vector<DictEntry<std::string, std::string>> &entries) {
         for (auto &entry : entries) {
@@ -66,12 +78,16 @@ class TestObject : public ObjectVTable<TestObject> {
 
 private:
     int prop2 = 1;
+    std::unique_ptr<Message> delayed_;
+    int32_t delayedValue_ = 0;
     FCITX_OBJECT_VTABLE_METHOD(test1, "test1", "", "");
     FCITX_OBJECT_VTABLE_METHOD(test2, "test2", "i", "s");
     FCITX_OBJECT_VTABLE_METHOD(test3, "test3", "i", "iu");
     FCITX_OBJECT_VTABLE_METHOD(test4, "test4", "v", "v");
     FCITX_OBJECT_VTABLE_METHOD(test5, "test5", "a{ss}", "s");
     FCITX_OBJECT_VTABLE_METHOD(testError, "testError", "", "b");
+    FCITX_OBJECT_VTABLE_METHOD(testDelay, "testDelay", "i", "i");
+    FCITX_OBJECT_VTABLE_METHOD(testFinish, "testFinish", "", "");
     FCITX_OBJECT_VTABLE_SIGNAL(testSignal, "testSignal", "a(si)");
     FCITX_OBJECT_VTABLE_PROPERTY(testProperty, "testProperty", "i",
                                  []() { return 5; });
@@ -80,6 +96,24 @@ private:
         [this](int32_t v) { prop2 = v; });
 };
 
+// Hands the delayed call over and gets destroyed before the method returns,
+// like an input context that is destroyed while handling a key.
+class DelayedObject : public ObjectVTable<DelayedObject> {
+public:
+    DelayedObject(std::function<void(Message, int32_t)> callback)
+        : callback_(std::move(callback)) {}
+
+    int32_t testDelayDestroy(int32_t i) {
+        auto callback = callback_;
+        callback(delayReply(), i);
+        return 0;
+    }
+
+private:
+    std::function<void(Message, int32_t)> callback_;
+    FCITX_OBJECT_VTABLE_METHOD(testDelayDestroy, "testDelayDestroy", "i", "i");
+};
+
 #define TEST_SERVICE "org.fcitx.Fcitx.TestDBus"
 #define TEST_INTERFACE "org.fcitx.Fcitx.TestDBus.Interface"
 
@@ -87,10 +121,19 @@ void client() {
     Bus clientBus(BusType::Session);
     EventLoop loop;
     clientBus.attachEventLoop(&loop);
+    // Rules with different fields set must still be called in order.
+    bool pathMatched = false;
+    std::unique_ptr<Slot> pathSlot(clientBus.addMatch(
+        MatchRule(TEST_SERVICE, "/test"), [&pathMatched](dbus::Message &) {
+            pathMatched = true;
+            return false;
+        }));
+    FCITX_ASSERT(pathSlot);
     std::unique_ptr<Slot> slot(clientBus.addMatch(
         MatchRule(TEST_SERVICE, "", TEST_INTERFACE, "testSignal"),
-        [&loop](dbus::Message &message) {
+        [&loop, &pathMatched](dbus::Message &message) {
             FCITX_INFO() << "testSignal";
+            FCITX_ASSERT(pathMatched);
             std::vector<DBusStruct<std::string, int>> data;
             message >> data;
             FCITX_ASSERT(data.size() == 1);
@@ -176,6 +219,44 @@ void client() {
             FCITX_ASSERT(s == "defg");
             return false;
         }));
+    // The reply comes from testFinish, not when testDelay returns.
+    bool delayedReplied = false;
+    std::unique_ptr<Slot> delaySlot;
+    std::unique_ptr<EventSourceTime> sDelay(loop.addTimeEvent(
+        CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + 450000, 0,
+        [&clientBus, &delaySlot, &delayedReplied](EventSource *, uint64_t) {
+            auto msg = clientBus.createMethodCall(TEST_SERVICE, "/test",
+                                                  TEST_INTERFACE, "testDelay");
+            msg << 21;
+            delaySlot = msg.callAsync(0, [&delayedReplied](Message &reply) {
+                FCITX_ASSERT(reply.type() == MessageType::Reply);
+                int32_t ret = 0;
+                reply >> ret;
+                FCITX_ASSERT(ret == 42);
+                delayedReplied = true;
+                return true;
+            });
+            auto finish = clientBus.createMethodCall(
+                TEST_SERVICE, "/test", TEST_INTERFACE, "testFinish");
+            auto reply = finish.call(0);
+            FCITX_ASSERT(reply.type() == MessageType::Reply);
+            FCITX_ASSERT(!delayedReplied);
+            return false;
+        }));
+    // Only the deferred handler replies, although the object is gone.
+    std::unique_ptr<EventSourceTime> sDelayDestroy(loop.addTimeEvent(
+        CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + 460000, 0,
+        [&clientBus](EventSource *, uint64_t) {
+            auto msg = clientBus.createMethodCall(
+                TEST_SERVICE, "/delayed", TEST_INTERFACE, "testDelayDestroy");
+            msg << 7;
+            auto reply = msg.call(0);
+            FCITX_ASSERT(reply.type() == MessageType::Reply);
+            int32_t ret = 0;
+            reply >> ret;
+            FCITX_ASSERT(ret == 14);
+            return false;
+        }));
     std::unique_ptr<EventSourceTime> s6(loop.addTimeEvent(
         CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + 500000, 0,
         [&clientBus](EventSource *, uint64_t) {
@@ -211,6 +292,7 @@ void client() {
                               return false;
                           }));
     loop.exec();
+    FCITX_ASSERT(delayedReplied);
 }
 
 int main() {
@@ -226,6 +308,21 @@ int main() {
     }
     TestObject obj;
     FCITX_ASSERT(bus.addObjectVTable("/test", TEST_INTERFACE, obj));
+    std::unique_ptr<DelayedObject> delayedObj;
+    std::unique_ptr<EventSource> delayedReply;
+    delayedObj = std::make_unique<DelayedObject>(
+        [&loop, &delayedObj, &delayedReply](Message call, int32_t i) {
+            delayedObj.reset();
+            auto pending = std::make_shared<Message>(std::move(call));
+            delayedReply = loop.addDeferEvent([pending, i](EventSource *) {
+                auto reply = pending->createReply();
+                reply << i * 2;
+                reply.send();
+                return true;
+            });
+        });
+    FCITX_ASSERT(
+        bus.addObjectVTable("/delayed", TEST_INTERFACE, *delayedObj));
     std::unique_ptr<EventSourceTime> s(loop.addTimeEvent(
         CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + 1000000, 0,
         [&bus, &loop](EventSource *, uint64_t) {
@@ -0,0 +1,141 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the  file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#include "fcitx-utils/dbus/bus.h"
+#include "fcitx-utils/event.h"
+#include "fcitx-utils/eventdispatcher.h"
+#include "fcitx-utils/log.h"
+#include "fcitx/instance.h"
+#include "testdir.h"
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace fcitx::dbus;
+using namespace fcitx;
+
+namespace {
+
+// Send two keys at once, the first one is deferred by the engine.
+void client(Instance *instance, EventDispatcher *dispatcher) {
+    Bus bus(BusType::Session);
+    EventLoop loop;
+    bus.attachEventLoop(&loop);
+
+    auto create = bus.createMethodCall(
+        "org.fcitx.Fcitx5", "/org/freedesktop/portal/inputmethod",
+        "org.fcitx.Fcitx.InputMethod1", "CreateInputContext");
+    create << std::vector<DBusStruct<std::string, std::string>>{
+        {"program", "testdbusfrontend"}};
+    auto created = create.call(0);
+    FCITX_ASSERT(created.type() == MessageType::Reply);
+    ObjectPath path;
+    created >> path;
+
+    std::vector<std::pair<KeySym, bool>> replies;
+    std::vector<std::unique_ptr<Slot>> calls;
+    for (auto sym : {FcitxKey_a, FcitxKey_b}) {
+        auto msg = bus.createMethodCall("org.fcitx.Fcitx5", path.path().c_str(),
+                                        "org.fcitx.Fcitx.InputContext1",
+                                        "ProcessKeyEvent");
+        msg << static_cast<uint32_t>(sym) << 0u << 0u << false << 0u;
+        calls.push_back(
+            msg.callAsync(0, [&loop, &replies, sym](Message &reply) {
+                FCITX_ASSERT(reply.type() == MessageType::Reply);
+                bool accepted = false;
+                reply >> accepted;
+                replies.emplace_back(sym, accepted);
+                if (replies.size() == 2) {
+                    loop.quit();
+                }
+                return true;
+            }));
+    }
+    loop.exec();
+    // Replies keep the order of keys, the deferred one is answered with the
+    // result passed to its callback.
+    FCITX_ASSERT(replies.size() == 2);
+    FCITX_ASSERT(replies[0].first == FcitxKey_a && replies[0].second);
+    FCITX_ASSERT(replies[1].first == FcitxKey_b && replies[1].second);
+    dispatcher->schedule([instance]() { instance->exit(); });
+}
+
+} // namespace
+
+int main() {
+    setenv("XDG_DATA_DIRS", FCITX5_SOURCE_DIR "/test/dbusfrontend", 1);
+    setenv("FCITX_ADDON_DIRS",
+           FCITX5_BINARY_DIR "/src/modules/dbus:" FCITX5_BINARY_DIR
+                             "/src/frontend/dbusfrontend",
+           1);
+    // Keep the configuration of user untouched.
+    setenv("XDG_CONFIG_HOME", FCITX5_BINARY_DIR "/test/dbusfrontend-home", 1);
+    setenv("XDG_DATA_HOME", FCITX5_BINARY_DIR "/test/dbusfrontend-home", 1);
+
+    char arg0[] = "testdbusfrontend";
+    char *argv[] = {arg0};
+    Instance instance(FCITX_ARRAY_SIZE(argv), argv);
+    EventDispatcher dispatcher;
+    dispatcher.attach(&instance.eventLoop());
+
+    std::vector<KeySym> handled;
+    KeyEventCallback deferred;
+    bool deferredCalled = false;
+    std::unique_ptr<EventSourceTime> finish;
+    auto handler = instance.watchEvent(
+        EventType::InputContextKeyEvent, EventWatcherPhase::InputMethod,
+        [&](Event &event) {
+            auto &keyEvent = static_cast<KeyEvent &>(event);
+            if (keyEvent.isRelease()) {
+                return;
+            }
+            handled.push_back(keyEvent.key().sym());
+            if (keyEvent.key().sym() != FcitxKey_a) {
+                // Not before the deferred key is done.
+                FCITX_ASSERT(deferredCalled);
+                keyEvent.filterAndAccept();
+                return;
+            }
+            deferred = keyEvent.defer();
+            FCITX_ASSERT(deferred);
+            FCITX_ASSERT(keyEvent.deferred());
+            keyEvent.filterAndAccept();
+            finish = instance.eventLoop().addTimeEvent(
+                CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + 100000, 0,
+                [&](EventSourceTime *, uint64_t) {
+                    FCITX_ASSERT(handled.size() == 1);
+                    deferredCalled = true;
+                    auto callback = std::exchange(deferred, nullptr);
+                    callback(true);
+                    // The queued key is processed right after.
+                    FCITX_ASSERT(handled.size() == 2);
+                    return true;
+                });
+        });
+
+    std::thread thread;
+    auto start = instance.eventLoop().addDeferEvent([&](EventSource *) {
+        thread = std::thread(client, &instance, &dispatcher);
+        return true;
+    });
+    instance.exec();
+    thread.join();
+    FCITX_ASSERT(deferredCalled);
+    FCITX_ASSERT(handled.size() == 2);
+    return 0;
+}
@@ -119,6 +119,76 @@ int main() {
         dbus::Variant var;
         var.setData("abcd");
         dbus::Variant var2(var);
+        FCITX_ASSERT(var2.signature() == "s");
+        FCITX_ASSERT(var2.dataAs<std::string>() == "abcd");
+        var.setData(1);
+        FCITX_ASSERT(var.dataAs<int32_t>() == 1);
+        FCITX_ASSERT(var2.dataAs<std::string>() == "abcd");
+        // Scalars are stored inline.
+        dbus::Variant var3(var);
+        var.setData(static_cast<uint64_t>(1) << 40);
+        FCITX_ASSERT(var3.signature() == "i");
+        FCITX_ASSERT(var3.dataAs<int32_t>() == 1);
+        FCITX_ASSERT(var.signature() == "t");
+        FCITX_ASSERT(var.dataAs<uint64_t>() == static_cast<uint64_t>(1) << 40);
+        var3 = var2;
+        FCITX_ASSERT(var3.dataAs<std::string>() == "abcd");
+        var2.setData(true);
+        FCITX_ASSERT(var2.dataAs<bool>());
+        FCITX_ASSERT(var3.dataAs<std::string>() == "abcd");
+    }
+
+    // Test type interning
+    {
+        auto &registry = dbus::VariantTypeRegistry::defaultRegistry();
+        FCITX_ASSERT(!registry.lookupType("(xyz)"));
+        FCITX_ASSERT(registry.lookupType("a{sv}"));
+
+        // Setting a value registers its type, variants of the same type share
+        // the signature.
+        FCITX_ASSERT(!registry.lookupType("(is)"));
+        dbus::Variant var(dbus::DBusStruct<int32_t, std::string>(1, "a"));
+        FCITX_ASSERT(registry.lookupType("(is)"));
+        dbus::Variant var2(dbus::DBusStruct<int32_t, std::string>(2, "b"));
+        FCITX_ASSERT(&var.signature() == &var2.signature());
+    }
+
+    // Types that are not pure can be set, but don't replace the pure one.
+    {
+        auto &registry = dbus::VariantTypeRegistry::defaultRegistry();
+        dbus::Variant var(std::tuple<int32_t>(5));
+        FCITX_ASSERT(var.signature() == "i");
+        FCITX_ASSERT(std::get<0>(var.dataAs<std::tuple<int32_t>>()) == 5);
+        FCITX_ASSERT(std::dynamic_pointer_cast<VariantHelper<int32_t>>(
+            registry.lookupType("i")));
+    }
+
+    // Deprecated raw data setter.
+    {
+        auto &registry = dbus::VariantTypeRegistry::defaultRegistry();
+        dbus::Variant var;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        var.setRawData(std::make_shared<std::string>("raw"),
+                       registry.lookupType("s"));
+        FCITX_ASSERT(var.signature() == "s");
+        FCITX_ASSERT(var.dataAs<std::string>() == "raw");
+        var.setRawData(std::make_shared<int32_t>(7), registry.lookupType("i"));
+        FCITX_ASSERT(var.signature() == "i");
+        FCITX_ASSERT(var.dataAs<int32_t>() == 7);
+        dbus::Variant copy(var);
+        FCITX_ASSERT(copy.dataAs<int32_t>() == 7);
+        // Unknown type is registered.
+        FCITX_ASSERT(!registry.lookupType("(ii)"));
+        var.setRawData(std::make_shared<DBusStruct<int32_t, int32_t>>(1, 2),
+                       std::make_shared<
+                           VariantHelper<DBusStruct<int32_t, int32_t>>>());
+#pragma GCC diagnostic pop
+        FCITX_ASSERT(var.signature() == "(ii)");
+        FCITX_ASSERT(std::get<1>(
+                         var.dataAs<DBusStruct<int32_t, int32_t>>().data()) ==
+                     2);
+        FCITX_ASSERT(registry.lookupType("(ii)"));
     }
 
 #if 0
@@ -0,0 +1,105 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+#include "fcitx-utils/dbus/bus.h"
+#include "fcitx-utils/event.h"
+#include "fcitx-utils/log.h"
+#include "fcitx-utils/stringutils.h"
+#include <thread>
+#include <unistd.h>
+
+using namespace fcitx::dbus;
+using namespace fcitx;
+
+#define TEST_INTERFACE "org.fcitx.Fcitx.TestDBusServer"
+
+class TestObject : public ObjectVTable<TestObject> {
+    std::string echo(const std::string &s) {
+        // Peer connections carry no sender.
+        FCITX_ASSERT(currentMessage()->sender().empty());
+        return s;
+    }
+
+private:
+    FCITX_OBJECT_VTABLE_METHOD(echo, "echo", "s", "s");
+};
+
+void client(const std::string &address) {
+    // Connecting as a bus client sends Hello to the server.
+    Bus bus(address);
+    FCITX_ASSERT(bus.isOpen());
+    FCITX_ASSERT(bus.uniqueName() == ":1.1") << bus.uniqueName();
+
+    auto msg = bus.createMethodCall("org.freedesktop.DBus",
+                                    "/org/freedesktop/DBus",
+                                    "org.freedesktop.DBus", "GetNameOwner");
+    msg << "org.freedesktop.IBus";
+    auto reply = msg.call(0);
+    std::string owner;
+    reply >> owner;
+    FCITX_ASSERT(owner == "org.freedesktop.IBus");
+
+    msg = bus.createMethodCall("org.fcitx.Fcitx.TestDBusServer", "/test",
+                               TEST_INTERFACE, "echo");
+    msg << "hello";
+    reply = msg.call(0);
+    std::string echo;
+    reply >> echo;
+    FCITX_ASSERT(echo == "hello");
+}
+
+int main() {
+    char tmpdir[] = "/tmp/testdbusserverXXXXXX";
+    FCITX_ASSERT(mkdtemp(tmpdir));
+    auto path = stringutils::joinPath(tmpdir, "bus");
+
+    EventLoop loop;
+    Server server(path);
+    FCITX_ASSERT(server.isOpen());
+    FCITX_ASSERT(stringutils::startsWith(server.address(), "unix:path="));
+    server.attachEventLoop(&loop);
+    server.setSenderName("org.fcitx.Fcitx.TestDBusServer");
+
+    TestObject obj;
+    std::unique_ptr<Bus> peer;
+    std::unique_ptr<Slot> disconnected;
+    server.setNewConnectionCallback([&](std::unique_ptr<Bus> bus) {
+        FCITX_ASSERT(!peer);
+        peer = std::move(bus);
+        FCITX_ASSERT(peer->addObjectVTable("/test", TEST_INTERFACE, obj));
+        auto signal = peer->createSignal("/test", TEST_INTERFACE, "test");
+        FCITX_ASSERT(signal.sender() == "org.fcitx.Fcitx.TestDBusServer");
+        disconnected = peer->addMatch(
+            MatchRule("", "/org/freedesktop/DBus/Local",
+                      "org.freedesktop.DBus.Local", "Disconnected"),
+            [&loop](Message &) {
+                loop.quit();
+                return true;
+            });
+        FCITX_ASSERT(disconnected);
+    });
+
+    std::thread thread(client, server.address());
+    loop.exec();
+    thread.join();
+
+    FCITX_ASSERT(peer);
+    unlink(path.c_str());
+    rmdir(tmpdir);
+    return 0;
+}
@@ -0,0 +1,129 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "fcitx-utils/event.h"
+#include "fcitx-utils/filewatcher.h"
+#include "fcitx-utils/fs.h"
+#include "fcitx-utils/log.h"
+#include "fcitx-utils/stringutils.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace fcitx;
+
+void writeFile(const std::string &path, const char *content) {
+    auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    FCITX_ASSERT(fd >= 0);
+    // Write in pieces, so there are multiple events for one change.
+    for (const char *p = content; *p; p++) {
+        FCITX_ASSERT(fs::safeWrite(fd, p, 1) == 1);
+    }
+    close(fd);
+}
+
+int main() {
+    char tmpl[] = "/tmp/fcitx_filewatcher_XXXXXX";
+    const char *tmp = mkdtemp(tmpl);
+    FCITX_ASSERT(tmp);
+    auto dir = stringutils::joinPath(tmp, "a/b");
+    auto file = stringutils::joinPath(dir, "file");
+    auto other = stringutils::joinPath(dir, "other");
+    auto watchedDir = stringutils::joinPath(tmp, "dir");
+    FCITX_ASSERT(fs::makePath(watchedDir));
+
+    EventLoop loop;
+    FileWatcher watcher(&loop, 20000);
+    int fileChanged = 0;
+    int dirChanged = 0;
+    // Neither the file nor its directory exist yet.
+    auto fileWatch = watcher.watch(file, [&fileChanged]() { fileChanged++; });
+    auto dirWatch =
+        watcher.watch(watchedDir, [&dirChanged]() { dirChanged++; });
+
+    // Each step checks the result of the previous one, and then changes some
+    // files.
+    std::vector<std::function<void()>> steps{
+        [&]() {
+            FCITX_ASSERT(fs::makePath(dir));
+            writeFile(file, "abc");
+            writeFile(file, "abcd");
+        },
+        [&]() {
+            FCITX_ASSERT(fileChanged == 1) << fileChanged;
+            FCITX_ASSERT(dirChanged == 0);
+            writeFile(other, "abc");
+        },
+        [&]() {
+            FCITX_ASSERT(fileChanged == 1) << fileChanged;
+            // Replace the file like safeSave does.
+            auto temp = file + ".tmp";
+            writeFile(temp, "def");
+            FCITX_ASSERT(rename(temp.c_str(), file.c_str()) == 0);
+        },
+        [&]() {
+            FCITX_ASSERT(fileChanged == 2) << fileChanged;
+            writeFile(stringutils::joinPath(watchedDir, "1"), "1");
+            writeFile(stringutils::joinPath(watchedDir, "2"), "2");
+        },
+        [&]() {
+            FCITX_ASSERT(dirChanged == 1) << dirChanged;
+            FCITX_ASSERT(fileChanged == 2) << fileChanged;
+            // Remove the whole directory and create it again.
+            unlink(file.c_str());
+            unlink(other.c_str());
+            rmdir(dir.c_str());
+        },
+        [&]() {
+            FCITX_ASSERT(fileChanged == 3) << fileChanged;
+            FCITX_ASSERT(fs::makePath(dir));
+            writeFile(file, "ghi");
+        },
+        [&]() {
+            FCITX_ASSERT(fileChanged == 4) << fileChanged;
+            fileWatch.reset();
+            writeFile(file, "jkl");
+        },
+        [&]() {
+            FCITX_ASSERT(fileChanged == 4) << fileChanged;
+            loop.quit();
+        },
+    };
+    size_t step = 0;
+    auto timeEvent = loop.addTimeEvent(
+        CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + 100000, 0,
+        [&steps, &step](EventSourceTime *event, uint64_t) {
+            steps[step++]();
+            event->setNextInterval(100000);
+            event->setOneShot();
+            return true;
+        });
+    loop.exec();
+    FCITX_ASSERT(step == steps.size());
+
+    unlink(file.c_str());
+    unlink(stringutils::joinPath(watchedDir, "1").c_str());
+    unlink(stringutils::joinPath(watchedDir, "2").c_str());
+    rmdir(dir.c_str());
+    rmdir(fs::dirName(dir).c_str());
+    rmdir(watchedDir.c_str());
+    rmdir(tmp);
+    return 0;
+}
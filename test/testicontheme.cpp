@@ -16,11 +16,110 @@
 // License along with this library; see the file COPYING. If not,
 // see <http://www.gnu.org/licenses/>.
 //
+#include "fcitx-utils/event.h"
+#include "fcitx-utils/filewatcher.h"
+#include "fcitx-utils/fs.h"
 #include "fcitx-utils/log.h"
 #include "fcitx/icontheme.h"
+#include <fstream>
+#include <unistd.h>
+#include <vector>
 
 using namespace fcitx;
 
+void testCacheInvalidation() {
+    char tmpl[] = "/tmp/fcitx_icontheme_XXXXXX";
+    const char *tmp = mkdtemp(tmpl);
+    FCITX_ASSERT(tmp);
+    FCITX_ASSERT(setenv("XDG_DATA_DIRS", tmp, 1) == 0);
+    StandardPath standardPath(true);
+
+    auto themeDir = stringutils::joinPath(tmp, "icons/fcitx-test");
+    auto appsDir = stringutils::joinPath(themeDir, "32x32/apps");
+    auto indexFile = stringutils::joinPath(themeDir, "index.theme");
+    auto iconFile = stringutils::joinPath(appsDir, "fcitx-test-icon.png");
+    auto largeAppsDir = stringutils::joinPath(themeDir, "48x48/apps");
+    auto largeIconFile =
+        stringutils::joinPath(largeAppsDir, "fcitx-test-large.png");
+    FCITX_ASSERT(fs::makePath(appsDir));
+    {
+        std::ofstream fout(indexFile);
+        fout << "[Icon Theme]\nName=Test\nDirectories=32x32/apps\n\n"
+                "[32x32/apps]\nSize=32\nType=Fixed\n";
+    }
+
+    EventLoop loop;
+    FileWatcher watcher(&loop, 20000);
+    IconTheme theme("fcitx-test", standardPath);
+    IconTheme unwatched("fcitx-test", standardPath);
+    theme.watch(watcher);
+
+    // Each step checks the result of the previous one, and then changes some
+    // files.
+    std::vector<std::function<void()>> steps{
+        [&]() {
+            FCITX_ASSERT(theme.findIcon("fcitx-test-icon", 32, 1).empty());
+            FCITX_ASSERT(unwatched.findIcon("fcitx-test-icon", 32, 1).empty());
+            { std::ofstream fout(iconFile); }
+            // Negative result is cached until watcher reports the change.
+            if (watcher.isValid()) {
+                FCITX_ASSERT(theme.findIcon("fcitx-test-icon", 32, 1).empty());
+            }
+            // Without watcher, nothing is cached.
+            FCITX_ASSERT(unwatched.findIcon("fcitx-test-icon", 32, 1) ==
+                         iconFile);
+        },
+        [&]() {
+            FCITX_ASSERT(theme.findIcon("fcitx-test-icon", 32, 1) == iconFile);
+            FCITX_ASSERT(theme.findIcon("fcitx-test-icon", 32, 1) == iconFile);
+            FCITX_ASSERT(unlink(iconFile.c_str()) == 0);
+        },
+        [&]() {
+            FCITX_ASSERT(theme.findIcon("fcitx-test-icon", 32, 1).empty());
+            FCITX_ASSERT(unwatched.findIcon("fcitx-test-icon", 32, 1).empty());
+            FCITX_ASSERT(fs::makePath(largeAppsDir));
+            { std::ofstream fout(largeIconFile); }
+            // Not listed in index.theme yet.
+            FCITX_ASSERT(theme.findIcon("fcitx-test-large", 48, 1).empty());
+            std::ofstream fout(indexFile);
+            fout << "[Icon Theme]\nName=Test\n"
+                    "Directories=32x32/apps,48x48/apps\n\n"
+                    "[32x32/apps]\nSize=32\nType=Fixed\n\n"
+                    "[48x48/apps]\nSize=48\nType=Fixed\n";
+        },
+        [&]() {
+            // Changed index.theme is parsed again.
+            if (watcher.isValid()) {
+                FCITX_ASSERT(theme.findIcon("fcitx-test-large", 48, 1) ==
+                             largeIconFile);
+                FCITX_ASSERT(theme.directories().size() == 2);
+            }
+            loop.quit();
+        },
+    };
+    size_t step = 0;
+    auto timeEvent = loop.addTimeEvent(
+        CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + 100000, 0,
+        [&steps, &step](EventSourceTime *event, uint64_t) {
+            steps[step++]();
+            event->setNextInterval(100000);
+            event->setOneShot();
+            return true;
+        });
+    loop.exec();
+    FCITX_ASSERT(step == steps.size());
+
+    unlink(indexFile.c_str());
+    unlink(largeIconFile.c_str());
+    rmdir(largeAppsDir.c_str());
+    rmdir(fs::dirName(largeAppsDir).c_str());
+    rmdir(appsDir.c_str());
+    rmdir(fs::dirName(appsDir).c_str());
+    rmdir(themeDir.c_str());
+    rmdir(fs::dirName(themeDir).c_str());
+    rmdir(tmp);
+}
+
 int main() {
     IconTheme theme("breeze");
     FCITX_INFO() << theme.name().match();
@@ -44,5 +143,7 @@ int main() {
 
     FCITX_INFO() << theme.findIcon("fcitx-pinyin", 32, 1);
 
+    testCacheInvalidation();
+
     return 0;
 }
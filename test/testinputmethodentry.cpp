@@ -0,0 +1,62 @@
+//
+// Copyright (C) 2020~2020 by CSSlayer
+// wengxt@gmail.com
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; see the file COPYING. If not,
+// see <http://www.gnu.org/licenses/>.
+//
+
+#include "fcitx-utils/log.h"
+#include "fcitx/inputmethodentry.h"
+#include <cstdlib>
+
+using namespace fcitx;
+
+int main() {
+    unsetenv("LANGUAGE");
+    {
+        InputMethodEntry entry("test", "Test", "en", "test");
+        FCITX_ASSERT(entry.hasName());
+        FCITX_ASSERT(entry.name() == "Test");
+        InputMethodEntry empty("empty", "", "en", "test");
+        FCITX_ASSERT(!empty.hasName());
+    }
+    {
+        int resolved = 0;
+        InputMethodEntry entry("test", "", "en", "test");
+        entry.setNameResolver([&resolved]() {
+            resolved++;
+            const char *language = getenv("LANGUAGE");
+            return std::string("Test ") + (language ? language : "");
+        });
+        // Registering the entry only checks for a name.
+        FCITX_ASSERT(entry.hasName());
+        FCITX_ASSERT(resolved == 0);
+        FCITX_ASSERT(entry.name() == "Test ");
+        FCITX_ASSERT(entry.name() == "Test ");
+        FCITX_ASSERT(resolved == 1);
+
+        // The name is kept until it is reset explicitly.
+        setenv("LANGUAGE", "de", 1);
+        FCITX_ASSERT(entry.name() == "Test ");
+        FCITX_ASSERT(resolved == 1);
+        entry.resetResolvedName();
+        FCITX_ASSERT(resolved == 1);
+        FCITX_ASSERT(entry.name() == "Test de");
+        FCITX_ASSERT(entry.name() == "Test de");
+        FCITX_ASSERT(resolved == 2);
+        unsetenv("LANGUAGE");
+    }
+    return 0;
+}
@@ -17,10 +17,17 @@
 // see <http://www.gnu.org/licenses/>.
 //
 
+#include "fcitx-utils/fs.h"
 #include "fcitx-utils/library.h"
 #include "fcitx-utils/log.h"
+#include "fcitx-utils/unixfd.h"
 #include "fcitxutils_export.h"
+#include <elf.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 #define DATA "AAAAAAAAA"
 #define MAGIC "MAGIC_TEST_DATA"
@@ -35,7 +42,57 @@ int func() { return 0; }
 
 void parser(const char *data) { FCITX_ASSERT(strcmp(data, DATA) == 0); }
 
+// Copy of this executable whose dynamic symbol table claims to be far larger
+// than the file.
+void testCorruptElf() {
+    auto exe = fcitx::UnixFD::own(open("/proc/self/exe", O_RDONLY));
+    struct stat stat;
+    FCITX_ASSERT(exe.isValid() && fstat(exe.fd(), &stat) == 0);
+    std::vector<char> buffer(stat.st_size);
+    FCITX_ASSERT(fcitx::fs::safeRead(exe.fd(), buffer.data(), buffer.size()) ==
+                 static_cast<ssize_t>(buffer.size()));
+    if (buffer[EI_CLASS] != ELFCLASS64) {
+        return;
+    }
+    Elf64_Ehdr ehdr;
+    memcpy(&ehdr, buffer.data(), sizeof(ehdr));
+    bool patched = false;
+    for (size_t i = 0; i < ehdr.e_shnum; i++) {
+        auto offset = ehdr.e_shoff + i * sizeof(Elf64_Shdr);
+        Elf64_Shdr shdr;
+        memcpy(&shdr, buffer.data() + offset, sizeof(shdr));
+        if (shdr.sh_type == SHT_DYNSYM) {
+            shdr.sh_size = sizeof(Elf64_Sym) << 40;
+            memcpy(buffer.data() + offset, &shdr, sizeof(shdr));
+            patched = true;
+        }
+    }
+    FCITX_ASSERT(patched);
+
+    char path[] = "/tmp/testlibraryXXXXXX";
+    auto file = fcitx::UnixFD::own(mkstemp(path));
+    FCITX_ASSERT(file.isValid());
+    FCITX_ASSERT(fcitx::fs::safeWrite(file.fd(), buffer.data(),
+                                      buffer.size()) ==
+                 static_cast<ssize_t>(buffer.size()));
+    fcitx::Library corrupt(path);
+    FCITX_ASSERT(
+        !corrupt.findData("magic_test", MAGIC, strlen(MAGIC), parser));
+    unlink(path);
+}
+
 int main() {
+    {
+        // Not loaded, data is read from the ELF file.
+        fcitx::Library exe("/proc/self/exe");
+        FCITX_ASSERT(exe.prefetch());
+        FCITX_ASSERT(exe.findData("magic_test", MAGIC, strlen(MAGIC), parser));
+        FCITX_ASSERT(!exe.findData("magic_test", DATA, strlen(DATA), parser));
+        FCITX_ASSERT(!exe.findData("magic_none", MAGIC, strlen(MAGIC), parser));
+        FCITX_ASSERT(!exe.loaded());
+    }
+    testCorruptElf();
+
     fcitx::Library lib("");
     FCITX_ASSERT(lib.load(fcitx::LibraryLoadHint::DefaultHint));
     FCITX_ASSERT(func == lib.resolve("func"));
@@ -21,14 +21,137 @@
 #include "fcitx-utils/log.h"
 #include "fcitx-utils/standardpath.h"
 #include "testdir.h"
+#include <cstdarg>
+#include <dirent.h>
+#include <dlfcn.h>
 #include <fcntl.h>
 #include <set>
+#include <sys/stat.h>
 #include <unistd.h>
 
 using namespace fcitx;
 
 #define TEST_ADDON_DIR FCITX5_SOURCE_DIR "/test/addon"
 
+// Count the file system calls made by StandardPath. Depending on libc
+// version, _FORTIFY_SOURCE and _FILE_OFFSET_BITS, open and stat may go
+// through any of the symbols below.
+static int syscalls = 0;
+
+#define REAL_FUNCTION(NAME, TYPE)                                              \
+    static auto real = reinterpret_cast<TYPE>(dlsym(RTLD_NEXT, #NAME));        \
+    syscalls++
+
+extern "C" {
+
+DIR *opendir(const char *name) {
+    REAL_FUNCTION(opendir, DIR * (*)(const char *));
+    return real(name);
+}
+
+int open(const char *path, int flags, ...) {
+    REAL_FUNCTION(open, int (*)(const char *, int, ...));
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = (flags & O_CREAT) ? va_arg(args, mode_t) : 0;
+    va_end(args);
+    return real(path, flags, mode);
+}
+
+int __open_2(const char *path, int flags) {
+    REAL_FUNCTION(__open_2, int (*)(const char *, int));
+    return real(path, flags);
+}
+
+int stat(const char *path, struct stat *buf) {
+    REAL_FUNCTION(stat, int (*)(const char *, struct stat *));
+    return real(path, buf);
+}
+
+#if defined(__GLIBC__) && !defined(__USE_FILE_OFFSET64)
+// With _FILE_OFFSET_BITS=64 the functions above already are these.
+int open64(const char *path, int flags, ...) {
+    REAL_FUNCTION(open64, int (*)(const char *, int, ...));
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = (flags & O_CREAT) ? va_arg(args, mode_t) : 0;
+    va_end(args);
+    return real(path, flags, mode);
+}
+
+int __open64_2(const char *path, int flags) {
+    REAL_FUNCTION(__open64_2, int (*)(const char *, int));
+    return real(path, flags);
+}
+
+int stat64(const char *path, struct stat64 *buf) {
+    REAL_FUNCTION(stat64, int (*)(const char *, struct stat64 *));
+    return real(path, buf);
+}
+#endif
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 33)
+int __xstat(int ver, const char *path, struct stat *buf) {
+    REAL_FUNCTION(__xstat, int (*)(int, const char *, struct stat *));
+    return real(ver, path, buf);
+}
+
+#if !defined(__USE_FILE_OFFSET64)
+int __xstat64(int ver, const char *path, struct stat64 *buf) {
+    REAL_FUNCTION(__xstat64, int (*)(int, const char *, struct stat64 *));
+    return real(ver, path, buf);
+}
+#endif
+#endif
+}
+
+void testCache() {
+    FCITX_ASSERT(setenv("FCITX_DATA_HOME", "/TEST/PATH", 1) == 0);
+    // Like a usual system, most of the data directories do not have the
+    // files.
+    FCITX_ASSERT(setenv("XDG_DATA_DIRS",
+                        "/TEST/PATH1:/TEST/PATH2:" TEST_ADDON_DIR
+                        ":/TEST/PATH3",
+                        1) == 0);
+    StandardPath standardPath(true);
+    auto run = [&standardPath]() {
+        auto before = syscalls;
+        for (int i = 0; i < 10; i++) {
+            FCITX_ASSERT(!standardPath
+                              .locate(StandardPath::Type::PkgData,
+                                      "addon/testim.conf")
+                              .empty());
+            FCITX_ASSERT(standardPath
+                             .locate(StandardPath::Type::PkgData,
+                                     "addon/nonexist.conf")
+                             .empty());
+            auto file = standardPath.open(StandardPath::Type::PkgData,
+                                          "addon/nonexist.conf", O_RDONLY);
+            FCITX_ASSERT(file.fd() < 0);
+            auto files =
+                standardPath.multiOpen(StandardPath::Type::PkgData, "addon",
+                                       O_RDONLY, filter::Suffix(".conf"));
+            FCITX_ASSERT(files.size() == 2);
+        }
+        return syscalls - before;
+    };
+
+    auto uncached = run();
+    standardPath.setCacheEnabled(true);
+    auto generation = standardPath.cacheGeneration();
+    auto cached = run();
+    FCITX_INFO() << "File system calls without cache: " << uncached
+                 << ", with cache: " << cached;
+    // Only user directory and opening the matched files are left.
+    FCITX_ASSERT(cached * 3 < uncached);
+
+    // Directories are read again once after invalidation, same as the first
+    // run with cache.
+    standardPath.invalidateCache();
+    FCITX_ASSERT(standardPath.cacheGeneration() > generation);
+    FCITX_ASSERT(run() == cached);
+}
+
 int main() {
     FCITX_ASSERT(setenv("XDG_CONFIG_HOME", "/TEST/PATH", 1) == 0);
     FCITX_ASSERT(setenv("XDG_CONFIG_DIRS", "/TEST/PATH1:/TEST/PATH2", 1) == 0);
@@ -76,5 +199,7 @@ int main() {
                                    "fcitx5/addon/testim2.conf", O_RDONLY);
     FCITX_ASSERT(file2.fd() == -1);
 
+    testCache();
+
     return 0;
 }
@@ -18,11 +18,35 @@
 //
 
 #include "config.h"
+#include "fcitx-utils/log.h"
+#include "fcitx/binarycache_p.h"
 #include "im/keyboard/xkbrules.h"
 
 int main() {
     fcitx::XkbRules xkbRules;
     xkbRules.read(XKEYBOARDCONFIG_XKBBASE "/rules/" DEFAULT_XKB_RULES ".xml");
     xkbRules.dump();
+
+    fcitx::BinaryCacheWriter writer;
+    xkbRules.writeLayouts(writer);
+    const auto &buffer = writer.buffer();
+    fcitx::BinaryCacheReader reader(buffer.data(), buffer.size());
+    fcitx::XkbRules cachedRules;
+    FCITX_ASSERT(cachedRules.readLayouts(reader));
+    FCITX_ASSERT(reader.atEnd());
+    FCITX_ASSERT(cachedRules.layoutInfos().size() ==
+                 xkbRules.layoutInfos().size());
+    for (const auto &p : xkbRules.layoutInfos()) {
+        const auto *layoutInfo = cachedRules.findByName(p.first);
+        FCITX_ASSERT(layoutInfo);
+        FCITX_ASSERT(layoutInfo->description == p.second.description);
+        FCITX_ASSERT(layoutInfo->languages == p.second.languages);
+        FCITX_ASSERT(layoutInfo->variantInfos.size() ==
+                     p.second.variantInfos.size());
+    }
+
+    fcitx::BinaryCacheReader truncated(buffer.data(), buffer.size() / 2);
+    FCITX_ASSERT(!cachedRules.readLayouts(truncated));
+    FCITX_ASSERT(cachedRules.layoutInfos().empty());
     return 0;
 }